@@ -0,0 +1,47 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Invoked by 'bench' target. Generates synthetic recycle bin of
+# every version if not done yet, then parses each of them with
+# every output format.
+#
+
+include(${CMAKE_CURRENT_LIST_DIR}/corpus.cmake)
+
+string(REPLACE "|" ";" FORMATS "${FORMATS}")
+file(MAKE_DIRECTORY ${CORPUS_DIR})
+
+set(types win95 nt4 win98 me xp vista win10)
+
+message("Records per recycle bin: ${RECORDS}")
+message("")
+string(CONCAT heading
+    "Program / version / format   "
+    "   records/s       MB/s   RSS(KiB)   time (s)")
+message("${heading}")
+
+foreach(type ${types})
+    ensure_corpus(${type} ${RECORDS} input)
+    corpus_program(${type} prog extra)
+    get_filename_component(progname ${prog} NAME_WE)
+
+    foreach(fmt ${FORMATS})
+        set(out_args)
+        if(fmt STREQUAL "sqlite")
+            set(out_args -o ${CORPUS_DIR}/bench.db)
+        endif()
+        execute_process(
+            COMMAND ${BENCH_RUN} -n ${RECORDS} -i ${input}
+                -l "${progname} ${type} ${fmt}"
+                -c ${CORPUS_DIR}/bench.db
+                -- ${prog} -f ${fmt} ${extra} ${out_args} ${input}
+            RESULT_VARIABLE ret)
+        if(NOT ret EQUAL 0)
+            message(FATAL_ERROR "Benchmark failed: ${progname} ${type} ${fmt}")
+        endif()
+    endforeach()
+endforeach()
+
+file(REMOVE ${CORPUS_DIR}/bench.db)
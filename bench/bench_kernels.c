@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Microbenchmark of per-record string kernels, namely path
+ * conversion and various escaping routines. Each kernel runs over
+ * a set of generated inputs repeatedly, and the median, minimum
+ * and spread of time spent per input byte are reported.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "utils-conv.h"
+
+// Shortest time of each sample, so that timer resolution
+// doesn't matter much
+#define DEFAULT_SAMPLE_MSEC     20
+
+// Approximate size of each generated UTF-16 path in chars
+#define UNICODE_PATH_CHARS      200
+
+// Legacy paths must be shorter than this in bytes
+#define LEGACY_PATH_BYTES       (WIN_PATH_MAX - 20)
+
+typedef enum
+{
+    INPUT_UTF16,
+    INPUT_LEGACY,
+    INPUT_UTF8,
+} input_type;
+
+typedef struct _bench_input {
+    char        *name;
+    input_type   type;
+    char        *enc;       // only for legacy input
+    GString     *data;
+} bench_input;
+
+typedef struct _bench_kernel {
+    const char  *name;
+    input_type   type;
+    void       (*run)     (const bench_input *input,
+                           GString           *dest);
+} bench_kernel;
+
+// Results of kernels without string output are kept here,
+// so that calls are not optimized away
+static volatile size_t sink;
+
+static gint       samples     = 15;
+static gint       sample_msec = DEFAULT_SAMPLE_MSEC;
+static char      *filter      = NULL;
+
+static const GOptionEntry options[] = {
+    { "samples", 'r', 0, G_OPTION_ARG_INT, &samples,
+      "Number of timed samples per kernel and input [15]", "N" },
+    { "time", 't', 0, G_OPTION_ARG_INT, &sample_msec,
+      "Minimum duration of each sample in milliseconds [20]", "MSEC" },
+    { "filter", 'f', 0, G_OPTION_ARG_STRING, &filter,
+      "Only run kernels or inputs with names containing TEXT", "TEXT" },
+    { 0 }
+};
+
+/*
+ * Sample path components, one for each kind of input. Legacy
+ * samples only contain characters representable in the code page.
+ */
+static const struct {
+    const char *name;
+    const char *text;
+} unicode_samples[] = {
+    { "ascii", "Documents and Settings\\Administrator\\My Documents\\" },
+    { "bmp-cjk", "我的文件\\マイ ドキュメント\\내 문서\\年度報告書\\" },
+    { "astral", "\xF0\x9F\x98\x80\xF0\x9F\x93\x81\xF0\xA0\x80\x80"
+                "\xF0\xA0\x80\x81\xF0\x9F\x8E\x89\\emoji\\" },
+};
+
+static const struct {
+    const char *enc;
+    const char *text;
+} legacy_samples[] = {
+    { "CP874",  "เอกสารของฉัน\\รายงานประจำปี\\" },
+    { "CP932",  "マイ ドキュメント\\報告書_日本語\\" },
+    { "CP936",  "我的文档\\年度报告_中文\\" },
+    { "CP949",  "내 문서\\연간 보고서\\" },
+    { "CP950",  "我的文件\\年度報告_中文\\" },
+    { "CP1250", "Dokumenty\\Łódź_Žluťoučký_kůň\\" },
+    { "CP1251", "Мои документы\\Отчёт_за_квартал\\" },
+    { "CP1252", "Eigene Dateien\\Übersicht_Präsentation_çà\\" },
+    { "CP1253", "Τα έγγραφά μου\\Αναφορά_Ελλάδα\\" },
+    { "CP1254", "Belgelerim\\Şirket_Güzel_İstanbul_ı\\" },
+    { "CP1255", "המסמכים שלי\\דוח_שנתי\\" },
+    { "CP1256", "مستنداتي\\تقرير_سنوي\\" },
+    { "CP1257", "Mani dokumenti\\Ąžuolas_Ėglė_Šiauliai\\" },
+    { "CP1258", "Tài liêu\\Báo cáo_Đông\\" },
+};
+
+
+static bench_input *
+_new_input   (const char   *name,
+              input_type    type,
+              const char   *enc,
+              GString      *data)
+{
+    bench_input *input = g_new0 (bench_input, 1);
+
+    input->name = g_strdup (name);
+    input->type = type;
+    input->enc  = g_strdup (enc);
+    input->data = data;
+    return input;
+}
+
+
+static void
+_free_input   (gpointer   data)
+{
+    bench_input *input = data;
+
+    g_free (input->name);
+    g_free (input->enc);
+    g_string_free (input->data, TRUE);
+    g_free (input);
+}
+
+
+/**
+ * @brief Generate Windows unicode path by repeating UTF-8 sample
+ * @return UTF-16LE string, with terminating NUL pair not counted
+ * in length
+ */
+static GString *
+_gen_utf16_path   (const char   *text)
+{
+    GString    *s = g_string_new_len ("C\0:\0\\\0", 6);
+    gunichar2  *u;
+    glong       len;
+
+    u = g_utf8_to_utf16 (text, -1, NULL, &len, NULL);
+    while (s->len / 2 + len <= UNICODE_PATH_CHARS)
+        for (glong i = 0; i < len; i++)
+        {
+            guint16 c = GUINT16_TO_LE (u[i]);
+            g_string_append_len (s, (const char *) &c, 2);
+        }
+    g_free (u);
+
+    // Leave NUL pair beyond end of string
+    g_string_append_len (s, "\0\0", 2);
+    g_string_truncate (s, s->len - 2);
+    return s;
+}
+
+
+/**
+ * @brief Generate broken unicode path, which has lone surrogates
+ * sprinkled throughout otherwise ASCII path
+ */
+static GString *
+_gen_broken_utf16_path   (void)
+{
+    GString *s = _gen_utf16_path (unicode_samples[0].text);
+    guint16 *p = (guint16 *) s->str;
+
+    for (gsize i = 8; i < s->len / 2; i += 16)
+        p[i] = GUINT16_TO_LE ((i / 16) % 2 ? 0xD800 : 0xDC00);
+    return s;
+}
+
+
+/**
+ * @brief Generate legacy path by repeating sample
+ * @return Path encoded in `enc`, or `NULL` if encoding is
+ * not supported by iconv
+ */
+static GString *
+_gen_legacy_path   (const char   *enc,
+                    const char   *text)
+{
+    GString  *s;
+    char     *str;
+    gsize     len;
+
+    if (! enc_is_ascii_compatible (enc, NULL))
+        return NULL;
+    if (NULL == (str = g_convert (text, -1, enc, "UTF-8",
+        NULL, &len, NULL)))
+        return NULL;
+
+    s = g_string_new ("C:\\");
+    while (s->len + len < LEGACY_PATH_BYTES)
+        g_string_append_len (s, str, len);
+    g_free (str);
+    return s;
+}
+
+
+static GPtrArray *
+_gen_inputs   (void)
+{
+    GPtrArray *inputs = g_ptr_array_new_with_free_func (_free_input);
+
+    for (gsize i = 0; i < G_N_ELEMENTS (unicode_samples); i++)
+    {
+        GString *s = _gen_utf16_path (unicode_samples[i].text);
+        GString *u = g_string_new (NULL);
+
+        g_ptr_array_add (inputs, _new_input (unicode_samples[i].name,
+            INPUT_UTF16, NULL, s));
+
+        // Same path already converted to UTF-8, for kernels
+        // working on output of path conversion
+        conv_path_to_utf8_with_tmpl (s, NULL, FORMAT_TEXT, NULL, u, NULL);
+        g_ptr_array_add (inputs, _new_input (unicode_samples[i].name,
+            INPUT_UTF8, NULL, u));
+    }
+
+    g_ptr_array_add (inputs, _new_input ("broken-utf16",
+        INPUT_UTF16, NULL, _gen_broken_utf16_path ()));
+
+    // Characters needing escape in all output formats
+    {
+        GString *s = g_string_new ("C:\\");
+        while (s->len < UNICODE_PATH_CHARS)
+            g_string_append (s, "tab\there \"quoted\"\x01\x7F\\");
+        g_ptr_array_add (inputs, _new_input ("escapes",
+            INPUT_UTF8, NULL, s));
+    }
+
+    for (gsize i = 0; i < G_N_ELEMENTS (legacy_samples); i++)
+    {
+        GString *s = _gen_legacy_path (legacy_samples[i].enc,
+            legacy_samples[i].text);
+
+        if (s == NULL)
+        {
+            g_printerr ("%s not supported, skipped\n", legacy_samples[i].enc);
+            continue;
+        }
+        g_ptr_array_add (inputs, _new_input (legacy_samples[i].enc,
+            INPUT_LEGACY, legacy_samples[i].enc, s));
+    }
+
+    return inputs;
+}
+
+
+static void
+_run_ucs2_bytelen   (const bench_input   *input,
+                     GString             *dest)
+{
+    (void) dest;
+    sink = ucs2_bytelen (input->data->str, input->data->len);
+}
+
+
+static void
+_run_conv_path   (const bench_input   *input,
+                  GString             *dest)
+{
+    g_string_truncate (dest, 0);
+    conv_path_to_utf8_with_tmpl (input->data, input->enc,
+        FORMAT_TEXT, NULL, dest, NULL);
+}
+
+
+static void
+_run_conv_path_json   (const bench_input   *input,
+                       GString             *dest)
+{
+    g_string_truncate (dest, 0);
+    conv_path_to_utf8_with_tmpl (input->data, input->enc,
+        FORMAT_JSON, json_escape, dest, NULL);
+}
+
+
+static void
+_run_filter_printable   (const bench_input   *input,
+                         GString             *dest)
+{
+    g_string_truncate (dest, 0);
+    filter_printable_char (dest, input->data->str, FORMAT_TEXT);
+}
+
+
+static void
+_run_json_escape   (const bench_input   *input,
+                    GString             *dest)
+{
+    g_string_truncate (dest, 0);
+    json_escape (dest, input->data->str);
+}
+
+
+static void
+_run_filter_escapes   (const bench_input   *input,
+                       GString             *dest)
+{
+    char *result = filter_escapes (input->data->str);
+
+    g_string_assign (dest, result);
+    g_free (result);
+}
+
+
+static const bench_kernel kernels[] = {
+    { "ucs2_bytelen",          INPUT_UTF16,  _run_ucs2_bytelen      },
+    { "conv_path",             INPUT_UTF16,  _run_conv_path         },
+    { "conv_path_json",        INPUT_UTF16,  _run_conv_path_json    },
+    { "conv_path",             INPUT_LEGACY, _run_conv_path         },
+    { "conv_path_json",        INPUT_LEGACY, _run_conv_path_json    },
+    { "filter_printable_char", INPUT_UTF8,   _run_filter_printable  },
+    { "json_escape",           INPUT_UTF8,   _run_json_escape       },
+    { "filter_escapes",        INPUT_UTF8,   _run_filter_escapes    },
+};
+
+
+static int
+_cmp_double   (const void   *a,
+               const void   *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Find number of iterations taking at least `sample_msec`
+ */
+static guint
+_calibrate   (const bench_kernel   *kernel,
+              const bench_input    *input,
+              GString              *dest)
+{
+    guint n = 1;
+
+    while (n < G_MAXUINT / 2)
+    {
+        gint64 start = g_get_monotonic_time ();
+
+        for (guint i = 0; i < n; i++)
+            kernel->run (input, dest);
+        if (g_get_monotonic_time () - start >= sample_msec * 1000)
+            break;
+        n *= 2;
+    }
+    return n;
+}
+
+
+/**
+ * @brief Time kernel over one input and print statistics
+ * @note Spread is median absolute deviation relative to median,
+ * which is less affected by occasional outliers than stddev
+ */
+static void
+_bench_one   (const bench_kernel   *kernel,
+              const bench_input    *input)
+{
+    GString *dest = g_string_sized_new (WIN_PATH_MAX * 8);
+    double  *ns = g_new (double, samples);
+    double  *dev = g_new (double, samples);
+    double   median, mad;
+    gsize    bytes = input->data->len;
+    guint    n = _calibrate (kernel, input, dest);
+
+    for (int s = 0; s < samples; s++)
+    {
+        gint64 start = g_get_monotonic_time ();
+
+        for (guint i = 0; i < n; i++)
+            kernel->run (input, dest);
+        ns[s] = (double) (g_get_monotonic_time () - start) * 1000 /
+            n / bytes;
+    }
+
+    qsort (ns, samples, sizeof (double), _cmp_double);
+    median = ns[samples / 2];
+    for (int s = 0; s < samples; s++)
+        dev[s] = ABS (ns[s] - median);
+    qsort (dev, samples, sizeof (double), _cmp_double);
+    mad = dev[samples / 2];
+
+    g_print ("%-22s %-14s %6zu %10.3f %10.3f %7.1f%%\n",
+        kernel->name, input->name, bytes, median, ns[0],
+        median > 0 ? mad * 100 / median : 0.0);
+
+    g_free (ns);
+    g_free (dev);
+    g_string_free (dest, TRUE);
+}
+
+
+static bool
+_is_selected   (const bench_kernel   *kernel,
+                const bench_input    *input)
+{
+    return (filter == NULL ||
+        strstr (kernel->name, filter) || strstr (input->name, filter));
+}
+
+
+int main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError         *error = NULL;
+    GPtrArray      *inputs;
+    char          **args = g_strdupv (argv);
+    bool            ret;
+
+    (void) argc;
+
+    context = g_option_context_new (NULL);
+    g_option_context_set_summary (context,
+        "Measure time spent per byte in string conversion kernels.");
+    g_option_context_add_main_entries (context, options, NULL);
+    ret = g_option_context_parse_strv (context, &args, &error);
+    g_option_context_free (context);
+    g_strfreev (args);
+
+    if (! ret || samples < 1 || sample_msec < 1)
+    {
+        g_printerr ("%s\n", error ? error->message :
+            "Number of samples and duration must be positive");
+        g_clear_error (&error);
+        return 1;
+    }
+
+    inputs = _gen_inputs ();
+
+    g_print ("%-22s %-14s %6s %10s %10s %8s\n",
+        "KERNEL", "INPUT", "BYTES", "MEDIAN", "MIN", "SPREAD");
+    for (gsize k = 0; k < G_N_ELEMENTS (kernels); k++)
+        for (guint i = 0; i < inputs->len; i++)
+        {
+            const bench_input *input = g_ptr_array_index (inputs, i);
+
+            if (input->type == kernels[k].type &&
+                _is_selected (&kernels[k], input))
+                _bench_one (&kernels[k], input);
+        }
+
+    g_ptr_array_free (inputs, TRUE);
+    free_conv_cache ();
+    g_free (filter);
+    return 0;
+}
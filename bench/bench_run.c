@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Runs a program repeatedly with output discarded, then reports
+ * throughput of fastest run and peak memory usage of all runs.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+static gint64     n_records   = 0;
+static char      *input       = NULL;
+static char      *label       = NULL;
+static char      *clean_path  = NULL;
+static gint       repeat      = 3;
+static char     **command     = NULL;
+
+static const GOptionEntry options[] = {
+    { "records", 'n', 0, G_OPTION_ARG_INT64, &n_records,
+      "Number of records in input", "N" },
+    { "input", 'i', 0, G_OPTION_ARG_FILENAME, &input,
+      "Input file or folder, for measuring data size", "PATH" },
+    { "label", 'l', 0, G_OPTION_ARG_STRING, &label,
+      "Label of result line", "TEXT" },
+    { "clean", 'c', 0, G_OPTION_ARG_FILENAME, &clean_path,
+      "Remove FILE before each run, such as output file", "FILE" },
+    { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+      "Number of runs [3]", "N" },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &command,
+      NULL, NULL },
+    { 0 }
+};
+
+
+/**
+ * @brief Size of input file, or total size of files directly
+ * under input folder
+ */
+static guint64
+_input_size   (const char   *path)
+{
+    GStatBuf     st;
+    GDir        *dir;
+    const char  *name;
+    guint64      total = 0;
+
+    if (g_stat (path, &st) != 0)
+        return 0;
+    if (! S_ISDIR (st.st_mode))
+        return st.st_size;
+
+    if (NULL == (dir = g_dir_open (path, 0, NULL)))
+        return 0;
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        char *p = g_build_filename (path, name, NULL);
+        if (g_stat (p, &st) == 0 && S_ISREG (st.st_mode))
+            total += st.st_size;
+        g_free (p);
+    }
+    g_dir_close (dir);
+    return total;
+}
+
+
+/**
+ * @brief Run command once
+ * @param elapsed Location to store wall clock time in microseconds
+ * @param maxrss Location to store peak resident memory in KiB
+ * @return Exit code of command, or -1 if it can't be run
+ */
+static int
+_run_once   (gint64   *elapsed,
+             long     *maxrss)
+{
+    struct rusage  ru;
+    gint64         start;
+    int            status;
+    pid_t          pid;
+
+    if (clean_path)
+        g_unlink (clean_path);
+
+    start = g_get_monotonic_time ();
+    if (0 > (pid = fork ()))
+        return -1;
+
+    if (pid == 0)
+    {
+        int fd = open ("/dev/null", O_WRONLY);
+        dup2 (fd, STDOUT_FILENO);
+        close (fd);
+        execvp (command[0], command);
+        _exit (127);
+    }
+
+    while (wait4 (pid, &status, 0, &ru) < 0)
+        if (errno != EINTR)
+            return -1;
+
+    *elapsed = g_get_monotonic_time () - start;
+#ifdef __APPLE__
+    *maxrss = ru.ru_maxrss / 1024;  // bytes on macOS
+#else
+    *maxrss = ru.ru_maxrss;
+#endif
+    return WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+}
+
+
+int main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError         *error = NULL;
+    char          **args = g_strdupv (argv);
+    gint64          best = G_MAXINT64;
+    long            peak = 0;
+    double          secs;
+    guint64         size;
+    bool            ret;
+
+    (void) argc;
+
+    context = g_option_context_new ("-- PROGRAM [ARG…]");
+    g_option_context_set_summary (context,
+        "Run program and report throughput and peak memory usage.");
+    g_option_context_add_main_entries (context, options, NULL);
+    ret = g_option_context_parse_strv (context, &args, &error);
+    g_option_context_free (context);
+    g_strfreev (args);
+
+    if (! ret || command == NULL || input == NULL || repeat < 1)
+    {
+        g_printerr ("%s\n", error ? error->message :
+            "Need input and command to run");
+        g_clear_error (&error);
+        return 1;
+    }
+
+    for (int i = 0; i < repeat; i++)
+    {
+        gint64 elapsed;
+        long   rss;
+        int    code = _run_once (&elapsed, &rss);
+
+        if (code != 0)
+        {
+            g_printerr ("%s: exit code %d\n", command[0], code);
+            return 1;
+        }
+        best = MIN (best, elapsed);
+        peak = MAX (peak, rss);
+    }
+
+    size = _input_size (input);
+    secs = (double) MAX (best, 1) / G_USEC_PER_SEC;
+
+    g_print ("%-28s %12.0f %10.1f %10ld %10.3f\n",
+        label ? label : command[0],
+        (double) n_records / secs,
+        (double) size / secs / (1024 * 1024),
+        peak, secs);
+
+    g_strfreev (command);
+    g_free (input);
+    g_free (label);
+    g_free (clean_path);
+    return 0;
+}
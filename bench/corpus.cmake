@@ -0,0 +1,63 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Shared by cmake scripts using synthetic recycle bins. Corpus is
+# kept in CORPUS_DIR and reused, since large $Recycle.bin folders
+# take a while to create. GEN_CORPUS, RIFIUTI and RIFIUTI_VISTA
+# must be defined by caller.
+#
+
+# Legacy paths of generated INFO2 are in Latin-1
+set(legacy_types win95 win98 me)
+
+
+#
+# Generates synthetic recycle bin of specified type if not
+# done yet, and store its path in out_var
+#
+function(ensure_corpus type records out_var)
+    if(type STREQUAL "vista" OR type STREQUAL "win10")
+        set(input ${CORPUS_DIR}/dir-${type}-${records})
+        set(gen_args --with-trash)
+    else()
+        set(input ${CORPUS_DIR}/INFO2-${type}-${records})
+        set(gen_args)
+    endif()
+
+    if(NOT EXISTS ${input})
+        file(MAKE_DIRECTORY ${CORPUS_DIR})
+        execute_process(
+            COMMAND ${GEN_CORPUS} -t ${type} -n ${records} ${gen_args}
+                ${input}.tmp
+            RESULT_VARIABLE ret)
+        if(NOT ret EQUAL 0)
+            message(FATAL_ERROR "Failed to generate ${input}")
+        endif()
+        file(RENAME ${input}.tmp ${input})
+    endif()
+
+    set(${out_var} ${input} PARENT_SCOPE)
+endfunction()
+
+
+#
+# Store program parsing recycle bin of specified type in prog_var,
+# and extra arguments needed in args_var
+#
+function(corpus_program type prog_var args_var)
+    set(args)
+    if(type STREQUAL "vista" OR type STREQUAL "win10")
+        set(prog ${RIFIUTI_VISTA})
+    else()
+        set(prog ${RIFIUTI})
+        list(FIND legacy_types ${type} pos)
+        if(NOT pos EQUAL -1)
+            set(args -l CP1252)
+        endif()
+    endif()
+
+    set(${prog_var} ${prog} PARENT_SCOPE)
+    set(${args_var} ${args} PARENT_SCOPE)
+endfunction()
@@ -0,0 +1,641 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Generates synthetic recycle bin of arbitrary size, for measuring
+ * performance. Paths are composed of random folder and file names,
+ * with configurable portion containing non-ASCII characters.
+ * Output is deterministic for the same seed and options.
+ *
+ * Hostile recycle bins can be generated too, whose paths are made
+ * entirely of characters driving path conversion into its slow
+ * paths, for checking that parsing time and memory usage stay
+ * linear regardless.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+/* Layout of INFO2, see rifiuti.h */
+#define INFO2_HEADER_SIZE        20
+#define INFO2_LEGACY_SIZE        280
+#define INFO2_UNICODE_SIZE       800
+#define WIN_PATH_MAX             260
+
+/* Layout of $Recycle.bin index, see rifiuti-vista.h */
+#define INDEX_V1_PATH_OFFSET     0x18
+#define INDEX_V2_PATH_OFFSET     0x1C
+
+/* Longest path generated for Windows 10 index files */
+#define INDEX_V2_PATH_MAX        1024
+
+/* Windows FILETIME of 2003-01-01 and 2015-01-01 */
+#define FILETIME_2003            126877536000000000LL
+#define FILETIME_2015            130645440000000000LL
+#define FILETIME_PER_SEC         10000000LL
+
+/* Deletion time of all records spread over about 10 years */
+#define DELTIME_SPAN_SECS        (10 * 365 * 86400LL)
+
+typedef enum
+{
+    HOSTILE_NONE,
+    HOSTILE_BROKEN,
+    HOSTILE_CONTROL,
+    HOSTILE_CJK,
+} hostile_kind;
+
+typedef struct
+{
+    const char  *name;
+    bool         is_info2;
+    uint32_t     version;
+    uint32_t     recordsize;  /* INFO2 only */
+} corpus_type;
+
+static const corpus_type types[] = {
+    { "win95", true,  0, INFO2_LEGACY_SIZE  },
+    { "nt4",   true,  2, INFO2_UNICODE_SIZE },
+    { "win98", true,  4, INFO2_LEGACY_SIZE  },
+    { "me",    true,  5, INFO2_LEGACY_SIZE  },
+    { "xp",    true,  5, INFO2_UNICODE_SIZE },
+    { "vista", false, 1, 0 },
+    { "win10", false, 2, 0 },
+};
+
+static const char *hostile_kinds[] = {
+    [HOSTILE_BROKEN]  = "broken",
+    [HOSTILE_CONTROL] = "control",
+    [HOSTILE_CJK]     = "cjk",
+};
+
+/*
+ * Bytes which are not valid in CP932 by themselves, and a double
+ * byte character (U+65E5) in CP932. Legacy paths of hostile INFO2
+ * are meant to be read with CP932 encoding.
+ */
+static const guint8 cp932_broken[] = { 0x80, 0xA0, 0xFD, 0xFE, 0xFF };
+static const guint8 cp932_kanji[]  = { 0x93, 0xFA };
+
+static const char *syllables[] = {
+    "ka", "ro", "mi", "ten", "port", "data", "log", "back", "up", "new",
+    "file", "doc", "img", "work", "ver", "final", "draft", "note", "sum",
+    "a", "e", "o", "2", "01", "_", "-", " ",
+};
+
+static const char *roots[] = {
+    "Documents and Settings\\user\\My Documents",
+    "Documents and Settings\\user\\Desktop",
+    "Users\\user\\Documents",
+    "Users\\user\\Downloads",
+    "Users\\user\\Desktop",
+    "Users\\user\\AppData\\Local\\Temp",
+    "Program Files",
+    "Windows\\Temp",
+    "Projects",
+};
+
+static const char *legacy_roots[] = {
+    "My Documents",
+    "WINDOWS\\Desktop",
+    "WINDOWS\\TEMP",
+    "Program Files",
+    "DATA",
+};
+
+static const char *extensions[] = {
+    "txt", "doc", "docx", "xls", "pdf", "jpg", "png", "mp3", "zip",
+    "exe", "dll", "tmp", "log", "ini", "htm", "lnk",
+};
+
+/* Characters used for non-ASCII names, grouped by script */
+static const char *scripts[] = {
+    "àáâäçèéêëìíîïñòóôöùúûüÿßÆØÅ",
+    "абвгдежзиклмнопрстуфхцчшщыэюя",
+    "αβγδεζηθικλμνξοπρστυφχψω",
+    "資料文件報告写真新建夾日本語中文檔案照片音楽",
+    "가나다라마바사아자차카타파하문서사진",
+};
+
+static char      *type_name   = NULL;
+static gint64     n_records   = 1000;
+static gint       seed        = 1;
+static gint       non_ascii   = 20;
+static gint       gone_pct    = 10;
+static gboolean   with_trash  = FALSE;
+static char      *hostile_name = NULL;
+static gint       path_len    = WIN_PATH_MAX - 1;
+static gboolean   huge_len    = FALSE;
+static char     **fileargs    = NULL;
+
+static hostile_kind hostile   = HOSTILE_NONE;
+
+static const GOptionEntry options[] = {
+    { "type", 't', 0, G_OPTION_ARG_STRING, &type_name,
+      "'win95', 'nt4', 'win98', 'me', 'xp' (INFO2), "
+      "'vista' or 'win10' ($Recycle.bin)", "TYPE" },
+    { "records", 'n', 0, G_OPTION_ARG_INT64, &n_records,
+      "Number of records [1000]", "N" },
+    { "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+      "Seed of random generator [1]", "N" },
+    { "non-ascii", 'u', 0, G_OPTION_ARG_INT, &non_ascii,
+      "Percentage of paths containing non-ASCII characters [20]", "PCT" },
+    { "gone", 'g', 0, G_OPTION_ARG_INT, &gone_pct,
+      "Percentage of records whose trashed file is gone [10]", "PCT" },
+    { "with-trash", 'r', 0, G_OPTION_ARG_NONE, &with_trash,
+      "Create empty $R files besides $Recycle.bin index files", NULL },
+    { "hostile", 'p', 0, G_OPTION_ARG_STRING, &hostile_name,
+      "Fill all paths with 'broken' (undecodable), 'control' "
+      "(non-printable) or 'cjk' characters", "KIND" },
+    { "path-length", 'L', 0, G_OPTION_ARG_INT, &path_len,
+      "Number of characters in hostile paths; only 'win10' type "
+      "allows more than 259 [259]", "N" },
+    { "huge-length", 'H', 0, G_OPTION_ARG_NONE, &huge_len,
+      "Claim path length of 4G characters in 'win10' index files", NULL },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &fileargs,
+      NULL, NULL },
+    { 0 }
+};
+
+
+static const char *
+_pick   (GRand         *r,
+         const char   **list,
+         gsize          len)
+{
+    return list[g_rand_int_range (r, 0, (gint32) len)];
+}
+
+
+/**
+ * @brief Append random character of script to path
+ * @param legacy_only Only use Latin-1 characters, which can be
+ * represented in ANSI code page of Western European systems
+ */
+static void
+_append_script_char   (GRand     *r,
+                       GString   *s,
+                       bool       legacy_only)
+{
+    const char *chars = scripts[legacy_only ? 0 :
+        g_rand_int_range (r, 0, G_N_ELEMENTS (scripts))];
+    glong       pos = g_rand_int_range (r, 0,
+        (gint32) g_utf8_strlen (chars, -1));
+    const char *c = g_utf8_offset_to_pointer (chars, pos);
+
+    g_string_append_len (s, c, g_utf8_next_char (c) - c);
+}
+
+
+static void
+_append_name   (GRand     *r,
+                GString   *s,
+                bool       use_script,
+                bool       legacy_only)
+{
+    int n = g_rand_int_range (r, 1, 5);
+
+    for (int i = 0; i < n; i++)
+    {
+        if (use_script && g_rand_boolean (r))
+        {
+            int m = g_rand_int_range (r, 1, 5);
+            for (int j = 0; j < m; j++)
+                _append_script_char (r, s, legacy_only);
+        }
+        else
+            g_string_append (s, _pick (r, syllables,
+                G_N_ELEMENTS (syllables)));
+    }
+}
+
+
+/**
+ * @brief Generate random path of trashed file in UTF-8
+ * @param max_chars Maximum length of path in characters
+ * @return Extension of file name, for naming `$Recycle.bin`
+ * index file
+ */
+static const char *
+_gen_path   (GRand     *r,
+             GString   *s,
+             bool       legacy_only,
+             glong      max_chars)
+{
+    bool        use_script = g_rand_int_range (r, 0, 100) < non_ascii;
+    int         depth = g_rand_int_range (r, 0, 6);
+    const char *ext = _pick (r, extensions, G_N_ELEMENTS (extensions));
+    int         d = g_rand_int_range (r, 0, 100);
+
+    // Occasionally very deep path
+    if (max_chars > WIN_PATH_MAX && g_rand_int_range (r, 0, 100) < 5)
+        depth += g_rand_int_range (r, 10, 40);
+
+    do
+    {
+        g_string_truncate (s, 0);
+        g_string_append_c (s, (d < 80) ? 'C' : (d < 95) ? 'D' :
+            'E' + g_rand_int_range (r, 0, 20));
+        g_string_append (s, ":\\");
+        g_string_append (s, legacy_only ?
+            _pick (r, legacy_roots, G_N_ELEMENTS (legacy_roots)) :
+            _pick (r, roots, G_N_ELEMENTS (roots)));
+
+        for (int i = 0; i < depth; i++)
+        {
+            g_string_append_c (s, '\\');
+            _append_name (r, s, use_script, legacy_only);
+        }
+        g_string_append_c (s, '\\');
+        _append_name (r, s, use_script, legacy_only);
+        g_string_append_printf (s, ".%s", ext);
+    }
+    while (g_utf8_strlen (s->str, -1) >= max_chars && depth-- > 0);
+
+    // Shortest possible path never exceeds limit
+    g_assert (g_utf8_strlen (s->str, -1) < max_chars);
+    return ext;
+}
+
+
+/**
+ * @brief Convert path to ANSI code page, like Windows does for
+ * legacy path field in `INFO2`
+ * @note Characters outside Latin-1 become '?', as it happens when
+ * they can't be represented in code page of system
+ */
+static void
+_to_legacy   (const char   *path,
+              char         *dest)
+{
+    gsize i = 0;
+
+    for (const char *p = path; *p && i < WIN_PATH_MAX - 1;
+        p = g_utf8_next_char (p))
+    {
+        gunichar c = g_utf8_get_char (p);
+        dest[i++] = (c < 0x100) ? (char) c : '?';
+    }
+}
+
+
+/**
+ * @brief Generate hostile unicode path in UTF-16LE
+ * @param chars Length of path in UTF-16 units
+ * @param len Location to store number of UTF-16 units in path
+ * @note Broken paths consist of lone low surrogates, which are
+ * rejected one by one during conversion
+ */
+static gunichar2 *
+_gen_hostile_utf16   (glong    chars,
+                      glong   *len)
+{
+    gunichar2 *u = g_new0 (gunichar2, chars + 1);
+
+    u[0] = 'C'; u[1] = ':'; u[2] = '\\';
+    for (glong i = 3; i < chars; i++)
+    {
+        switch (hostile)
+        {
+            case HOSTILE_BROKEN:  u[i] = 0xDC00 + i % 0x400; break;
+            case HOSTILE_CONTROL: u[i] = 0x01 + i % 0x1F;    break;
+            default:              u[i] = 0x4E00 + i % 0x5000; break;
+        }
+        u[i] = GUINT16_TO_LE (u[i]);
+    }
+    *len = chars;
+    return u;
+}
+
+
+/**
+ * @brief Generate hostile legacy path in CP932
+ * @param bytes Length of path in bytes, capped by `WIN_PATH_MAX`
+ * @param dest Buffer of at least `WIN_PATH_MAX` bytes
+ */
+static void
+_gen_hostile_legacy   (glong   bytes,
+                       char   *dest)
+{
+    glong i, end = MIN (bytes, WIN_PATH_MAX - 1);
+
+    // Don't split double byte character
+    if (hostile == HOSTILE_CJK && (end - 3) % 2)
+        end--;
+
+    memcpy (dest, "C:\\", 3);
+    for (i = 3; i < end; i++)
+    {
+        switch (hostile)
+        {
+            case HOSTILE_BROKEN:
+                dest[i] = (char) cp932_broken[i % sizeof (cp932_broken)];
+                break;
+            case HOSTILE_CONTROL:
+                dest[i] = (char) (0x01 + i % 0x1F);
+                break;
+            default:
+                dest[i] = (char) cp932_kanji[(i - 3) % 2];
+                break;
+        }
+    }
+    dest[i] = '\0';
+}
+
+
+static void
+_put_uint32   (guint8     *buf,
+               uint32_t    val)
+{
+    val = GUINT32_TO_LE (val);
+    memcpy (buf, &val, sizeof (val));
+}
+
+
+static void
+_put_uint64   (guint8     *buf,
+               uint64_t    val)
+{
+    val = GUINT64_TO_LE (val);
+    memcpy (buf, &val, sizeof (val));
+}
+
+
+/**
+ * @brief Random time between deletion of consecutive records
+ */
+static int64_t
+_gen_interval   (GRand   *r)
+{
+    gint32 max = (gint32) MAX (2, DELTIME_SPAN_SECS * 2 / MAX (n_records, 1));
+
+    return g_rand_int_range (r, 1, max) * FILETIME_PER_SEC;
+}
+
+
+static uint64_t
+_gen_filesize   (GRand   *r)
+{
+    // Roughly log-uniform, from bytes to gigabytes
+    return (uint64_t) g_rand_int_range (r, 1, 1024) <<
+        g_rand_int_range (r, 0, 22);
+}
+
+
+static bool
+_gen_info2   (const corpus_type   *t,
+              const char          *path,
+              GError             **error)
+{
+    FILE    *fp;
+    GRand   *r = g_rand_new_with_seed ((guint32) seed);
+    GString *s = g_string_new (NULL);
+    guint8   header[INFO2_HEADER_SIZE] = { 0 };
+    guint8  *rec = g_malloc (t->recordsize);
+    int64_t  filetime = FILETIME_2003;
+    bool     ret = true;
+
+    if (NULL == (fp = g_fopen (path, "wb")))
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+            "Can not create '%s': %s", path, g_strerror (errno));
+        ret = false;
+        goto gen_done;
+    }
+
+    _put_uint32 (header, t->version);
+    // Total entry count, only meaningful for Windows 95 and NT4
+    _put_uint32 (header + 8, (uint32_t) n_records);
+    _put_uint32 (header + 12, t->recordsize);
+    fwrite (header, 1, sizeof (header), fp);
+
+    for (gint64 i = 0; i < n_records; i++)
+    {
+        bool legacy_only = (t->recordsize == INFO2_LEGACY_SIZE);
+
+        memset (rec, 0, t->recordsize);
+        if (hostile)
+        {
+            _gen_hostile_legacy (path_len, (char *) rec);
+            g_string_assign (s, "C:\\");
+        }
+        else
+        {
+            _gen_path (r, s, legacy_only, WIN_PATH_MAX);
+            _to_legacy (s->str, (char *) rec);
+        }
+
+        // Drive letter is removed when trashed file is gone
+        if (g_rand_int_range (r, 0, 100) < gone_pct)
+            rec[0] = '\0';
+
+        filetime += _gen_interval (r);
+        _put_uint32 (rec + WIN_PATH_MAX, (uint32_t) i + 1);
+        _put_uint32 (rec + WIN_PATH_MAX + 4, s->str[0] - 'A');
+        _put_uint64 (rec + WIN_PATH_MAX + 8, filetime);
+        _put_uint32 (rec + WIN_PATH_MAX + 16,
+            (uint32_t) MIN (_gen_filesize (r), G_MAXUINT32));
+
+        if (! legacy_only)
+        {
+            glong       len;
+            gunichar2  *u = hostile ?
+                _gen_hostile_utf16 (MIN (path_len, WIN_PATH_MAX - 1), &len) :
+                g_utf8_to_utf16 (s->str, -1, NULL, &len, NULL);
+            memcpy (rec + INFO2_LEGACY_SIZE, u, len * sizeof (gunichar2));
+            g_free (u);
+        }
+
+        if (fwrite (rec, 1, t->recordsize, fp) != t->recordsize)
+            break;
+    }
+
+    if (ferror (fp) || fclose (fp) != 0)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+            "Can not write '%s': %s", path, g_strerror (errno));
+        ret = false;
+    }
+
+    gen_done:
+
+    g_free (rec);
+    g_string_free (s, TRUE);
+    g_rand_free (r);
+    return ret;
+}
+
+
+/**
+ * @brief Derive unique index file name from record number
+ * @note Multiplying by number coprime to 36^6 is a bijection
+ * within 36^6, which shuffles names without collision
+ */
+static void
+_index_name   (gint64        i,
+               const char   *ext,
+               char          type,
+               GString      *name)
+{
+    const char  digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    uint64_t    n = ((uint64_t) i * 1000003) % 2176782336ULL;
+
+    g_string_printf (name, "$%c", type);
+    for (int j = 0; j < 6; j++, n /= 36)
+        g_string_append_c (name, digits[n % 36]);
+    g_string_append_printf (name, ".%s", ext);
+}
+
+
+static bool
+_gen_rbin_dir   (const corpus_type   *t,
+                 const char          *dir,
+                 GError             **error)
+{
+    GRand   *r = g_rand_new_with_seed ((guint32) seed);
+    GString *s = g_string_new (NULL);
+    GString *name = g_string_new (NULL);
+    GString *buf = g_string_new (NULL);
+    int64_t  filetime = FILETIME_2015;
+    bool     ret = true;
+
+    if (0 != g_mkdir_with_parents (dir, 0755))
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+            "Can not create '%s': %s", dir, g_strerror (errno));
+        ret = false;
+        goto gen_done;
+    }
+
+    for (gint64 i = 0; i < n_records && ret; i++)
+    {
+        const char *ext;
+        char       *path;
+        glong       len;
+        gunichar2  *u;
+        gsize       path_off;
+
+        if (hostile)
+        {
+            ext = "txt";
+            u = _gen_hostile_utf16 ((t->version == 1) ?
+                MIN (path_len, WIN_PATH_MAX - 1) : path_len, &len);
+        }
+        else
+        {
+            ext = _gen_path (r, s, false,
+                (t->version == 1) ? WIN_PATH_MAX : INDEX_V2_PATH_MAX);
+            u = g_utf8_to_utf16 (s->str, -1, NULL, &len, NULL);
+        }
+        filetime += _gen_interval (r);
+
+        path_off = (t->version == 1) ?
+            INDEX_V1_PATH_OFFSET : INDEX_V2_PATH_OFFSET;
+        g_string_set_size (buf, path_off + ((t->version == 1) ?
+            WIN_PATH_MAX : (gsize) len + 1) * sizeof (gunichar2));
+        memset (buf->str, 0, buf->len);
+        _put_uint64 ((guint8 *) buf->str, t->version);
+        _put_uint64 ((guint8 *) buf->str + 8, _gen_filesize (r));
+        _put_uint64 ((guint8 *) buf->str + 16, filetime);
+        if (t->version == 2)
+            _put_uint32 ((guint8 *) buf->str + 24,
+                huge_len ? G_MAXUINT32 : (uint32_t) len + 1);
+        memcpy (buf->str + path_off, u, len * sizeof (gunichar2));
+        g_free (u);
+
+        _index_name (i, ext, 'I', name);
+        path = g_build_filename (dir, name->str, NULL);
+        ret = g_file_set_contents (path, buf->str, buf->len, error);
+        g_free (path);
+
+        if (ret && with_trash && g_rand_int_range (r, 0, 100) >= gone_pct)
+        {
+            _index_name (i, ext, 'R', name);
+            path = g_build_filename (dir, name->str, NULL);
+            ret = g_file_set_contents (path, "", 0, error);
+            g_free (path);
+        }
+    }
+
+    gen_done:
+
+    g_string_free (buf, TRUE);
+    g_string_free (name, TRUE);
+    g_string_free (s, TRUE);
+    g_rand_free (r);
+    return ret;
+}
+
+
+int main (int argc, char **argv)
+{
+    GOptionContext    *context;
+    GError            *error = NULL;
+    const corpus_type *t = NULL;
+    char             **args = g_strdupv (argv);
+    bool               ret;
+
+    (void) argc;
+
+    context = g_option_context_new ("OUTPUT");
+    g_option_context_set_summary (context,
+        "Generate synthetic INFO2 file or $Recycle.bin folder.");
+    g_option_context_add_main_entries (context, options, NULL);
+    ret = g_option_context_parse_strv (context, &args, &error);
+    g_option_context_free (context);
+    g_strfreev (args);
+
+    if (ret)
+    {
+        for (gsize i = 0; i < G_N_ELEMENTS (types); i++)
+            if (g_strcmp0 (type_name, types[i].name) == 0)
+                t = &types[i];
+
+        if (t == NULL || fileargs == NULL || g_strv_length (fileargs) != 1 ||
+            n_records < 0 || n_records > G_MAXUINT32)
+        {
+            g_set_error_literal (&error, G_OPTION_ERROR,
+                G_OPTION_ERROR_BAD_VALUE,
+                "Need valid type, record count and one output path");
+            ret = false;
+        }
+    }
+
+    if (ret && hostile_name)
+    {
+        for (gsize i = 0; i < G_N_ELEMENTS (hostile_kinds); i++)
+            if (g_strcmp0 (hostile_name, hostile_kinds[i]) == 0)
+                hostile = (hostile_kind) i;
+
+        if (hostile == HOSTILE_NONE || path_len < 4)
+        {
+            g_set_error_literal (&error, G_OPTION_ERROR,
+                G_OPTION_ERROR_BAD_VALUE,
+                "Need valid kind of hostile path and its length");
+            ret = false;
+        }
+    }
+
+    if (ret)
+        ret = t->is_info2 ?
+            _gen_info2 (t, fileargs[0], &error) :
+            _gen_rbin_dir (t, fileargs[0], &error);
+
+    if (! ret)
+    {
+        g_printerr ("%s\n", error->message);
+        g_error_free (error);
+    }
+
+    g_strfreev (fileargs);
+    g_free (type_name);
+    g_free (hostile_name);
+    return ret ? 0 : 1;
+}
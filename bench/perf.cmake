@@ -0,0 +1,91 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Invoked by 'perf' labelled tests, each one parsing synthetic
+# recycle bin of one version with one output format, as denoted
+# by KEYS (like "xp/json"). Throughput and peak memory usage are
+# compared with BASELINE, failing if any of them is worse than
+# baseline by more than tolerance percentage, which can be set
+# globally or for each entry.
+#
+# When UPDATE is defined, nothing is compared; a new baseline with
+# measured numbers is written to UPDATE instead, keeping tolerance
+# of existing entries.
+#
+
+cmake_minimum_required(VERSION 3.19)  # string(JSON)
+
+include(${CMAKE_CURRENT_LIST_DIR}/corpus.cmake)
+
+file(READ ${BASELINE} json)
+string(JSON records GET "${json}" records)
+string(JSON tolerance GET "${json}" tolerance_pct)
+string(REPLACE "|" ";" KEYS "${KEYS}")
+
+set(failed)
+
+foreach(key ${KEYS})
+    string(REPLACE "/" ";" parts ${key})
+    list(GET parts 0 type)
+    list(GET parts 1 fmt)
+
+    ensure_corpus(${type} ${records} input)
+    corpus_program(${type} prog extra)
+
+    execute_process(
+        COMMAND ${BENCH_RUN} -n ${records} -i ${input} -l ${key} -r 5
+            -- ${prog} -f ${fmt} ${extra} ${input}
+        RESULT_VARIABLE ret
+        OUTPUT_VARIABLE out
+        OUTPUT_STRIP_TRAILING_WHITESPACE)
+    if(NOT ret EQUAL 0 OR
+        NOT out MATCHES "([0-9]+) +[0-9.]+ +([0-9]+) +[0-9.]+$")
+        message(FATAL_ERROR "Benchmark failed: ${key}")
+    endif()
+    set(rate ${CMAKE_MATCH_1})
+    set(rss ${CMAKE_MATCH_2})
+
+    if(DEFINED UPDATE)
+        message("${key}: ${rate} records/s, ${rss} KiB")
+        string(JSON json SET "${json}" baseline ${key} records_per_sec ${rate})
+        string(JSON json SET "${json}" baseline ${key} peak_rss_kib ${rss})
+        continue()
+    endif()
+
+    string(JSON base_rate ERROR_VARIABLE err
+        GET "${json}" baseline ${key} records_per_sec)
+    if(err)
+        message(FATAL_ERROR "No baseline for ${key}")
+    endif()
+    string(JSON base_rss GET "${json}" baseline ${key} peak_rss_kib)
+
+    # Per entry tolerance, such as when disk access is involved
+    string(JSON tol ERROR_VARIABLE err
+        GET "${json}" baseline ${key} tolerance_pct)
+    if(err)
+        set(tol ${tolerance})
+    endif()
+
+    math(EXPR min_rate "${base_rate} * (100 - ${tol}) / 100")
+    math(EXPR max_rss "${base_rss} * (100 + ${tol}) / 100")
+    message("${key}: ${rate} records/s (baseline ${base_rate}, "
+        "minimum ${min_rate}), ${rss} KiB (baseline ${base_rss}, "
+        "maximum ${max_rss})")
+
+    if(rate LESS min_rate)
+        list(APPEND failed "${key} throughput")
+    endif()
+    if(rss GREATER max_rss)
+        list(APPEND failed "${key} memory usage")
+    endif()
+endforeach()
+
+if(DEFINED UPDATE)
+    file(WRITE ${UPDATE} "${json}\n")
+    message("New baseline written to ${UPDATE}")
+elseif(failed)
+    string(REPLACE ";" ", " failed "${failed}")
+    message(FATAL_ERROR "Performance regression: ${failed}")
+endif()
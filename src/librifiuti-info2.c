@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2003, Keith J. Jones.
+ * Copyright (C) 2007-2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include "utils-debug.h"
+#include "utils-error.h"
+#include "utils-conv.h"
+#include "utils.h"
+#include "rifiuti.h"
+#include "librifiuti-private.h"
+
+
+/* 1995-01-01 in Unix time, before any INFO2 could be created */
+#define INFO2_EARLIEST_TIME   788918400LL
+
+/* 0-25 => A-Z, 26 => '\', 27 or above is erraneous */
+const unsigned char driveletters[28] =
+{
+    'A', 'B', 'C', 'D', 'E', 'F', 'G',
+    'H', 'I', 'J', 'K', 'L', 'M', 'N',
+    'O', 'P', 'Q', 'R', 'S', 'T', 'U',
+    'V', 'W', 'X', 'Y', 'Z', '\\', '?'
+};
+
+
+/**
+ * @brief Check if `INFO2` header is sensible
+ * @param buf Buffer holding start of `INFO2` file
+ * @param bufsize Size of buffer
+ * @param version Location to store `INFO2` version
+ * @param recordsize Location to store size of each record
+ * @param error Location to store error upon failure
+ * @return `true` if header is valid, `false` otherwise
+ */
+bool
+r2_info2_check_header   (const void   *buf,
+                         gsize         bufsize,
+                         uint32_t     *version,
+                         uint32_t     *recordsize,
+                         GError      **error)
+{
+    uint32_t ver, size;
+
+    if (bufsize < RECORD_START_OFFSET)
+    {
+        g_set_error_literal (error, R2_FATAL_ERROR,
+            R2_FATAL_ERROR_ILLEGAL_DATA,
+            _("File is not an INFO2 index."));
+        return false;
+    }
+
+    copy_field (ver, buf, VERSION_OFFSET, KEPT_ENTRY_OFFSET);
+    ver = GUINT32_FROM_LE (ver);
+    copy_field (size, buf, RECORD_SIZE_OFFSET, FILESIZE_SUM_OFFSET);
+    size = GUINT32_FROM_LE (size);
+
+    switch (size)
+    {
+        case LEGACY_RECORD_SIZE:
+            // ME -> 280 byte record
+            if (ver != VERSION_ME_03 && ver != VERSION_WIN98 &&
+                ver != VERSION_WIN95)
+                goto bad_version;
+            break;
+
+        case UNICODE_RECORD_SIZE:
+            if (ver != VERSION_ME_03 && ver != VERSION_NT4)
+                goto bad_version;
+            break;
+
+        default:
+            g_set_error (error, R2_FATAL_ERROR, R2_FATAL_ERROR_ILLEGAL_DATA,
+                "Illegal INFO2 of record size %" PRIu32, size);
+            return false;
+    }
+
+    *version = ver;
+    *recordsize = size;
+    return true;
+
+    bad_version:
+
+    g_set_error (error, R2_FATAL_ERROR, R2_FATAL_ERROR_ILLEGAL_DATA,
+        "Illegal INFO2 version %" PRIu32, ver);
+    return false;
+}
+
+
+/**
+ * @brief Decode and validate single `INFO2` record
+ * @param dec The decoder
+ * @param rec The record view to be filled
+ * @param buf Start of record
+ * @param avail Number of readable bytes from `buf`
+ * @param recordsize Record size from `r2_info2_check_header()`
+ * @param version `INFO2` version from `r2_info2_check_header()`
+ * @return `false` if data is too short to be a record
+ * @note Last unicode record may be truncated, in which case only
+ * part of its unicode path is available. Record problems are
+ * stored in `rec->error`, first problem found wins.
+ */
+bool
+r2_info2_decode   (r2_decoder     *dec,
+                   r2_record      *rec,
+                   const guint8   *buf,
+                   gsize           avail,
+                   uint32_t        recordsize,
+                   uint32_t        version)
+{
+    uint32_t   drivenum, size;
+
+    // Unicode records accept partial path truncation,
+    // but no fault tolerance for Legacy records
+    if (avail < recordsize &&
+        (recordsize == LEGACY_RECORD_SIZE || avail <= LEGACY_RECORD_SIZE))
+        return false;
+
+    avail = MIN (avail, recordsize);
+    g_clear_error (&rec->error);
+
+    copy_field (rec->index, buf, RECORD_INDEX_OFFSET, DRIVE_LETTER_OFFSET);
+    rec->index = GUINT32_FROM_LE (rec->index);
+    r2_debug ("index=%u", rec->index);
+
+    /* Number representing drive letter, 'A:' = 0, etc */
+    copy_field (drivenum, buf, DRIVE_LETTER_OFFSET, FILETIME_OFFSET);
+    drivenum = GUINT32_FROM_LE (drivenum);
+    r2_debug ("drive=%u", drivenum);
+    if (drivenum >= sizeof (driveletters) - 1)
+        g_set_error (&rec->error, R2_REC_ERROR, R2_REC_ERROR_DRIVE_LETTER,
+            _("Drive number %" PRIu32 "does not represent "
+            "a valid drive"), drivenum);
+    rec->drive = driveletters[MIN (drivenum, sizeof (driveletters) - 1)];
+
+    copy_field (rec->filetime, buf, FILETIME_OFFSET, FILESIZE_OFFSET);
+    rec->filetime = GINT64_FROM_LE (rec->filetime);
+    if (rec->error == NULL &&
+        r2_filetime_is_dubious (rec->filetime, INFO2_EARLIEST_TIME))
+        g_set_error_literal (&rec->error, R2_REC_ERROR,
+            R2_REC_ERROR_DUBIOUS_TIME,
+            _("File deletion time is suspicious or broken"));
+
+    /* BEWARE! This is 32bit data casted to 64bit field */
+    copy_field (size, buf, FILESIZE_OFFSET, UNICODE_FILENAME_OFFSET);
+    rec->size = GUINT32_FROM_LE (size);
+    r2_debug ("filesize=%" PRIu64, rec->size);
+
+    rec->index_name = NULL;
+    rec->version = version;
+    rec->legacy_path = buf + LEGACY_FILENAME_OFFSET;
+    rec->legacy_len = WIN_PATH_MAX;
+
+    // Only bother checking legacy path when requested,
+    // because otherwise we don't know which encoding to use
+    if (rec->error == NULL && dec->ctx->legacy_encoding)
+    {
+        char  path[WIN_PATH_MAX + 1], *s;
+
+        // First byte is removed when trashed file is gone
+        memcpy (path, rec->legacy_path, WIN_PATH_MAX);
+        path[WIN_PATH_MAX] = '\0';
+        if (path[0] == '\0')
+            path[0] = rec->drive;
+
+        s = r2_decoder_convert (dec, true, path, strlen (path),
+            &rec->error);
+        g_free (s);
+    }
+
+    if (avail == LEGACY_RECORD_SIZE)
+    {
+        rec->uni_path = NULL;
+        rec->uni_len = 0;
+        return true;
+    }
+
+    // Part below deals with unicode path only
+
+    rec->uni_path = buf + UNICODE_FILENAME_OFFSET;
+    rec->uni_len = avail - UNICODE_FILENAME_OFFSET;
+
+    if (rec->error == NULL && avail < UNICODE_RECORD_SIZE)
+        g_set_error_literal (&rec->error, R2_REC_ERROR,
+            R2_REC_ERROR_DUBIOUS_PATH,
+            _("Record is truncated, thus unicode path might be incomplete"));
+
+    if (rec->error == NULL)
+    {
+        char *s = r2_decoder_convert (dec, false,
+            (const char *) rec->uni_path,
+            ucs2_bytelen ((const char *) rec->uni_path, rec->uni_len),
+            &rec->error);
+        g_free (s);
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Move iterator to next `INFO2` record
+ * @return `false` if there is no more record
+ */
+bool
+r2_info2_iter_next   (r2_iter   *it)
+{
+    const guint8  *buf;
+    gsize          avail;
+
+    if (it->pos < RECORD_START_OFFSET)
+        it->pos = RECORD_START_OFFSET;
+
+    buf = (const guint8 *) g_mapped_file_get_contents (it->map) + it->pos;
+    avail = g_mapped_file_get_length (it->map) - it->pos;
+    if (! r2_info2_decode (&it->dec, &it->rec, buf, avail,
+        it->recordsize, it->version))
+        return false;
+
+    it->pos += MIN (avail, it->recordsize);
+    return true;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Parts of librifiuti shared with command line programs, and among
+ * library source files. Layout of INFO2 and $Recycle.bin index are
+ * kept in separate files, since their offset macros collide.
+ */
+
+#pragma once
+
+#include "librifiuti.h"
+
+struct _r2_context
+{
+    char         *legacy_encoding;
+};
+
+/*
+ * Record decoding state. Converters are opened lazily and kept for
+ * the lifetime of decoder, so each thread must use its own decoder,
+ * while the context can be shared.
+ */
+typedef struct _r2_decoder
+{
+    const r2_context  *ctx;
+    GIConv             uni_conv;
+    GIConv             legacy_conv;
+    char              *legacy_conv_enc;  /* encoding legacy_conv is for */
+} r2_decoder;
+
+struct _r2_iter
+{
+    r2_bin_type   type;
+    r2_record     rec;
+    r2_decoder    dec;
+
+    /* INFO2 file, or single index file */
+    GMappedFile  *map;
+    gsize         pos;
+    uint32_t      recordsize;
+    uint32_t      version;
+
+    /* $Recycle.bin folder, or parent folder of single index file */
+    char         *dir;
+    GPtrArray    *names;
+    guint         next;
+    char         *buf;
+    gsize         buflen;
+    bool          isolated;
+};
+
+
+/* INFO2 drive number to letter */
+extern const unsigned char driveletters[28];
+
+void              r2_decoder_init            (r2_decoder       *dec,
+                                              const r2_context *ctx);
+void              r2_decoder_clear           (r2_decoder       *dec);
+void              r2_decoder_rebind          (r2_decoder       *dec,
+                                              const r2_context *ctx);
+void              r2_decoder_preload         (r2_decoder       *dec);
+char *            r2_decoder_convert         (r2_decoder       *dec,
+                                              bool              legacy,
+                                              const char       *str,
+                                              gsize             len,
+                                              GError          **error);
+bool              r2_filetime_is_dubious     (int64_t           filetime,
+                                              int64_t           earliest);
+
+bool              r2_info2_check_header      (const void       *buf,
+                                              gsize             bufsize,
+                                              uint32_t         *version,
+                                              uint32_t         *recordsize,
+                                              GError          **error);
+bool              r2_info2_decode            (r2_decoder       *dec,
+                                              r2_record        *rec,
+                                              const guint8     *buf,
+                                              gsize             avail,
+                                              uint32_t          recordsize,
+                                              uint32_t          version);
+bool              r2_info2_iter_next         (r2_iter          *it);
+
+bool              r2_index_check_header      (const void       *buf,
+                                              gsize             bufsize,
+                                              uint64_t         *version,
+                                              GError          **error);
+void              r2_index_decode            (r2_decoder       *dec,
+                                              r2_record        *rec,
+                                              const guint8     *buf,
+                                              gsize             bufsize,
+                                              uint64_t          version);
+bool              r2_is_index_name           (const char       *name);
+bool              r2_found_desktop_ini       (const char       *path);
+r2_status         r2_index_status            (const char       *dir,
+                                              const char       *index_name,
+                                              bool              isolated);
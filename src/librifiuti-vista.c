@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2007-2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include "utils-debug.h"
+#include "utils-error.h"
+#include "utils-conv.h"
+#include "utils.h"
+#include "rifiuti-vista.h"
+#include "librifiuti-private.h"
+
+/* 2007-01-01 in Unix time, before any index file could be created */
+#define INDEX_EARLIEST_TIME   1167609600LL
+
+
+/**
+ * @brief Basic validation of index file content
+ * @param buf Buffer holding index file content
+ * @param bufsize Size of buffer
+ * @param version Location to store index file version
+ * @param error Location to store error upon failure
+ * @return `true` if content is deemed usable, `false` otherwise
+ * @note This only checks if index file has sufficient amount
+ * of data for sensible reading
+ */
+bool
+r2_index_check_header   (const void   *buf,
+                         gsize         bufsize,
+                         uint64_t     *version,
+                         GError      **error)
+{
+    if (bufsize <= VERSION1_FILENAME_OFFSET)
+    {
+        g_set_error_literal (error, R2_REC_ERROR,
+        R2_REC_ERROR_IDX_SIZE_INVALID,
+            _("File is not a $Recycle.bin index"));
+        return false;
+    }
+
+    copy_field (*version, buf, VERSION_OFFSET, FILESIZE_OFFSET);
+    *version = GUINT64_FROM_LE (*version);
+    r2_debug ("version = %" PRIu64, *version);
+
+    switch (*version)
+    {
+    case VERSION_VISTA: break;  // already handled above
+
+    case VERSION_WIN10:
+        // Version 2 adds a uint32 file name strlen before file name.
+        // This presumably breaks the 260 char barrier in version 1.
+        if (bufsize <= VERSION2_FILENAME_OFFSET)
+        {
+            g_set_error_literal (error, R2_REC_ERROR,
+            R2_REC_ERROR_IDX_SIZE_INVALID,
+                _("File is not a $Recycle.bin index"));
+            return false;
+        }
+        break;
+
+    default:
+        if (*version < 10)
+            g_set_error (error, R2_REC_ERROR,
+                R2_REC_ERROR_VER_UNSUPPORTED,
+                _("Index file version %" PRIu64 " is unsupported"),
+                *version);
+        else
+            g_set_error (error, R2_REC_ERROR,
+                R2_REC_ERROR_VER_UNSUPPORTED,
+                "%s", _("File is not a $Recycle.bin index"));
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Decode and validate content of index file
+ * @param dec The decoder
+ * @param rec The record view to be filled
+ * @param buf Buffer holding index file content
+ * @param bufsize Size of buffer
+ * @param version Index file version from `r2_index_check_header()`
+ * @note Record problems are stored in `rec->error`, first problem
+ * found wins
+ */
+void
+r2_index_decode   (r2_decoder     *dec,
+                   r2_record      *rec,
+                   const guint8   *buf,
+                   gsize           bufsize,
+                   uint64_t        version)
+{
+    bool       erraneous = false;
+    uint32_t   name_len;
+    uint64_t   path_sz_expected;
+    gsize      path_sz_actual;
+
+    g_clear_error (&rec->error);
+
+    if (version == VERSION_VISTA)
+    {
+        // In rare cases, the size of index file is one byte short of
+        // (fixed) 544 bytes in Vista. Under such occasion, file size
+        // only occupies 56 bit, not 64 bit as it ought to be.
+        // Actually this 56-bit file size is very likely wrong after all.
+        // This is observed during deletion of dd.exe from Forensic
+        // Acquisition Utilities (by George M. Garner Jr)
+        // in certain localized Vista.
+        erraneous = (bufsize == VERSION1_FILE_SIZE - 1);
+        path_sz_expected = WIN_PATH_MAX * sizeof (gunichar2);
+        path_sz_actual = bufsize + (int) erraneous - VERSION1_FILENAME_OFFSET;
+        rec->uni_path = buf - (int) erraneous + VERSION1_FILENAME_OFFSET;
+    }
+    else
+    {
+        // Hostile file name length must not wrap around
+        copy_field (name_len, buf, VERSION1_FILENAME_OFFSET,
+            VERSION2_FILENAME_OFFSET);
+        path_sz_expected = (uint64_t) GUINT32_FROM_LE (name_len) *
+            sizeof (gunichar2);
+        path_sz_actual = bufsize - VERSION2_FILENAME_OFFSET;
+        rec->uni_path = buf + VERSION2_FILENAME_OFFSET;
+    }
+    rec->uni_len = MIN (path_sz_actual, path_sz_expected);
+
+    // Not printing the 56 bit value, it is wrong and misleading
+    if (erraneous)
+        rec->size = G_MAXUINT64;
+    else
+    {
+        copy_field (rec->size, buf, FILESIZE_OFFSET, FILETIME_OFFSET);
+        rec->size = GUINT64_FROM_LE (rec->size);
+        r2_debug ("deleted file size = %" PRIu64, rec->size);
+    }
+
+    copy_field (rec->filetime, buf - (int) erraneous,
+        FILETIME_OFFSET, VERSION1_FILENAME_OFFSET);
+    rec->filetime = GINT64_FROM_LE (rec->filetime);
+    if (r2_filetime_is_dubious (rec->filetime, INDEX_EARLIEST_TIME))
+        g_set_error_literal (&rec->error, R2_REC_ERROR,
+            R2_REC_ERROR_DUBIOUS_TIME,
+            _("File deletion time is suspicious or broken"));
+
+    if (rec->error == NULL && path_sz_actual > path_sz_expected)
+        g_set_error_literal (&rec->error, R2_REC_ERROR,
+            R2_REC_ERROR_DUBIOUS_PATH,
+            _("Ignored dangling extraneous data after record"));
+    else if (rec->error == NULL && path_sz_actual < path_sz_expected &&
+        ! erraneous)
+        g_set_error_literal (&rec->error, R2_REC_ERROR,
+            R2_REC_ERROR_DUBIOUS_PATH,
+            _("Record is truncated, thus unicode path might be incomplete"));
+
+    if (rec->error == NULL)
+    {
+        char *s = r2_decoder_convert (dec, false,
+            (const char *) rec->uni_path,
+            ucs2_bytelen ((const char *) rec->uni_path, rec->uni_len),
+            &rec->error);
+        g_free (s);
+    }
+
+    rec->version = version;
+    rec->index = 0;
+    rec->drive = '\0';
+    rec->legacy_path = NULL;
+    rec->legacy_len = 0;
+}
+
+
+/**
+ * @brief Check if file name matches `$Recycle.bin` index file
+ * pattern, that is `$I??????` or `$I??????.*`
+ * @param name The file name to check
+ * @note Same as matching with `GPatternSpec`, each `?` stands for
+ * one UTF-8 character
+ */
+bool
+r2_is_index_name   (const char   *name)
+{
+    if (! g_str_has_prefix (name, "$I"))
+        return false;
+
+    name += 2;
+    for (int i = 0; i < 6; i++)
+    {
+        if (*name == '\0')
+            return false;
+        name = g_utf8_find_next_char (name, NULL);
+    }
+    return (*name == '\0' || *name == '.');
+}
+
+
+/**
+ * @brief Search for desktop.ini in folder for hint of recycle bin
+ * @param path The searched path
+ * @return `true` if `desktop.ini` found to contain recycle bin
+ *         identifier, `false` otherwise
+ */
+bool
+r2_found_desktop_ini   (const char   *path)
+{
+    char *filename = NULL, *content = NULL, *found = NULL;
+
+    filename = g_build_filename (path, "desktop.ini", NULL);
+    if (!g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+    {
+        g_free (filename);
+        return false;
+    }
+
+    if (g_file_get_contents (filename, &content, NULL, NULL))
+        /* Don't bother parsing, we don't use the content at all */
+        found = strstr (content, RECYCLE_BIN_CLSID);
+
+    g_free (content);
+    g_free (filename);
+    return (found != NULL);
+}
+
+
+/**
+ * @brief Check if trashed file of index file is still inside
+ * recycle bin, by existence of corresponding `$R` file
+ * @param dir Folder containing index file
+ * @param index_name Index file name
+ * @param isolated Whether index file was taken out of its original
+ * folder, in which case the status is unknown
+ */
+r2_status
+r2_index_status   (const char   *dir,
+                   const char   *index_name,
+                   bool          isolated)
+{
+    char   *name, *path;
+    bool    found;
+
+    if (isolated)
+        return R2_STATUS_UNKNOWN;
+
+    name = g_strdup (index_name);
+    name[1] = 'R';  /* $R... versus $I... */
+    path = g_build_filename (dir, name, NULL);
+    found = g_file_test (path, G_FILE_TEST_EXISTS);
+    g_free (name);
+    g_free (path);
+
+    return found ? R2_STATUS_EXISTS : R2_STATUS_GONE;
+}
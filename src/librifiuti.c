@@ -0,0 +1,591 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include "utils-debug.h"
+#include "utils-error.h"
+#include "utils-conv.h"
+#include "librifiuti-private.h"
+
+#define NO_CONV             ((GIConv) -1)
+
+
+/* Our own error domain */
+G_DEFINE_QUARK (rifiuti-fatal-error-quark, rifiuti_fatal_error)
+G_DEFINE_QUARK (rifiuti-record-error-quark, rifiuti_record_error)
+
+
+#ifndef NDEBUG
+/* -1 until G_MESSAGES_DEBUG is looked up, see r2_debug_enabled() */
+int r2_debug_state = -1;
+
+
+/**
+ * @brief Check if debug messages of this program are enabled
+ * @return `true` if `G_MESSAGES_DEBUG` contains `all` or log domain
+ * of this program, `false` otherwise
+ * @note Result is cached, later changes of environment are not
+ * noticed
+ */
+bool
+r2_debug_check   (void)
+{
+    const char  *domains = g_getenv ("G_MESSAGES_DEBUG");
+    char       **list;
+    bool         enabled = false;
+
+    if (domains)
+    {
+        list = g_strsplit_set (domains, " ,", -1);
+        for (char **p = list; *p && ! enabled; p++)
+            enabled = (0 == strcmp (*p, "all") ||
+                       0 == strcmp (*p, G_LOG_DOMAIN));
+        g_strfreev (list);
+    }
+
+    g_atomic_int_set (&r2_debug_state, enabled ? 1 : 0);
+    return enabled;
+}
+#endif
+
+
+/**
+ * @brief Create parsing context with default settings
+ * @return New context, to be freed with `r2_context_free()`
+ */
+r2_context *
+r2_context_new   (void)
+{
+    return g_malloc0 (sizeof (r2_context));
+}
+
+
+/**
+ * @brief Set code page used by legacy (8.3) paths of `INFO2` records
+ * @param ctx The context, which must not be used by any iterator yet
+ * @param encoding Encoding name understood by iconv, or `NULL`
+ * to unset
+ * @param error Location to store error if encoding is unsupported
+ * @return `true` on success, `false` otherwise
+ */
+bool
+r2_context_set_legacy_encoding   (r2_context   *ctx,
+                                  const char   *encoding,
+                                  GError      **error)
+{
+    g_return_val_if_fail (ctx != NULL, false);
+
+    if (encoding)
+    {
+        GIConv conv = g_iconv_open ("UTF-8", encoding);
+
+        if (conv == NO_CONV)
+        {
+            g_set_error (error, G_CONVERT_ERROR,
+                G_CONVERT_ERROR_NO_CONVERSION,
+                _("'%s' encoding is not supported by glib library "
+                "on this system."), encoding);
+            return false;
+        }
+        g_iconv_close (conv);
+    }
+
+    g_free (ctx->legacy_encoding);
+    ctx->legacy_encoding = g_strdup (encoding);
+    return true;
+}
+
+
+/**
+ * @brief Get code page used by legacy (8.3) paths of `INFO2` records
+ * @param ctx The context
+ * @return Encoding name, or `NULL` if unset
+ */
+const char *
+r2_context_get_legacy_encoding   (const r2_context   *ctx)
+{
+    g_return_val_if_fail (ctx != NULL, NULL);
+
+    return ctx->legacy_encoding;
+}
+
+
+void
+r2_context_free   (r2_context   *ctx)
+{
+    if (ctx == NULL)
+        return;
+
+    g_free (ctx->legacy_encoding);
+    g_free (ctx);
+}
+
+
+/**
+ * @brief Prepare decoder using settings of context
+ * @param dec The decoder
+ * @param ctx The context, which must outlive the decoder
+ */
+void
+r2_decoder_init   (r2_decoder         *dec,
+                   const r2_context   *ctx)
+{
+    dec->ctx = ctx;
+    dec->uni_conv = dec->legacy_conv = NO_CONV;
+    dec->legacy_conv_enc = NULL;
+}
+
+
+void
+r2_decoder_clear   (r2_decoder   *dec)
+{
+    if (dec->uni_conv != NO_CONV)
+        g_iconv_close (dec->uni_conv);
+    if (dec->legacy_conv != NO_CONV)
+        g_iconv_close (dec->legacy_conv);
+    dec->uni_conv = dec->legacy_conv = NO_CONV;
+    g_clear_pointer (&dec->legacy_conv_enc, g_free);
+}
+
+
+/**
+ * @brief Switch decoder to settings of another context
+ * @param dec The decoder
+ * @param ctx The new context, which must outlive the decoder
+ * @note Converters already opened are kept if they still apply,
+ * so that decoder prepared in advance can be handed over to
+ * context created later
+ */
+void
+r2_decoder_rebind   (r2_decoder         *dec,
+                     const r2_context   *ctx)
+{
+    dec->ctx = ctx;
+    if (dec->legacy_conv == NO_CONV ||
+        g_strcmp0 (dec->legacy_conv_enc, ctx->legacy_encoding) == 0)
+        return;
+
+    g_iconv_close (dec->legacy_conv);
+    dec->legacy_conv = NO_CONV;
+    g_clear_pointer (&dec->legacy_conv_enc, g_free);
+}
+
+
+/**
+ * @brief Get converter of decoder, opening it upon first use
+ * @param dec The decoder
+ * @param legacy `true` for converter of legacy code page,
+ * `false` for UTF-16LE converter
+ * @param error Location to store error if encoding is unsupported
+ * @return The converter, or `NO_CONV` upon error
+ */
+static GIConv
+_decoder_get_conv   (r2_decoder   *dec,
+                     bool          legacy,
+                     GError      **error)
+{
+    GIConv      *conv = legacy ? &dec->legacy_conv : &dec->uni_conv;
+    const char  *enc = legacy ? dec->ctx->legacy_encoding : "UTF-16LE";
+
+    if (*conv != NO_CONV)
+        return *conv;
+
+    if (NO_CONV == (*conv = g_iconv_open ("UTF-8", enc)))
+    {
+        g_set_error (error, R2_REC_ERROR, R2_REC_ERROR_CONV_PATH,
+            _("'%s' encoding is not supported by glib library "
+            "on this system."), enc);
+        return NO_CONV;
+    }
+    if (legacy)
+        dec->legacy_conv_enc = g_strdup (enc);
+    return *conv;
+}
+
+
+/**
+ * @brief Open all converters of decoder in advance
+ * @param dec The decoder
+ * @note Failure is left for `r2_decoder_convert()` to report
+ */
+void
+r2_decoder_preload   (r2_decoder   *dec)
+{
+    _decoder_get_conv (dec, false, NULL);
+    if (dec->ctx->legacy_encoding)
+        _decoder_get_conv (dec, true, NULL);
+}
+
+
+/**
+ * @brief Convert path of record to UTF-8
+ * @param dec The decoder
+ * @param legacy `true` for legacy path in code page of context,
+ * `false` for unicode path in UTF-16LE
+ * @param str The path
+ * @param len Length of path in bytes, without null terminator
+ * @param error Location to store error if path can't be converted
+ * @return Newly allocated path in UTF-8, or `NULL` upon error
+ */
+char *
+r2_decoder_convert   (r2_decoder    *dec,
+                      bool           legacy,
+                      const char    *str,
+                      gsize          len,
+                      GError       **error)
+{
+    GIConv       conv;
+    char        *result;
+
+    if (NO_CONV == (conv = _decoder_get_conv (dec, legacy, error)))
+        return NULL;
+
+    if (NULL != (result = g_convert_with_iconv (str, len, conv,
+        NULL, NULL, NULL)))
+        return result;
+
+    if (legacy)
+        g_set_error (error, R2_REC_ERROR, R2_REC_ERROR_CONV_PATH,
+            _("Path contains character(s) that could not be "
+            "interpreted in %s encoding"), dec->ctx->legacy_encoding);
+    else
+        g_set_error_literal (error, R2_REC_ERROR, R2_REC_ERROR_CONV_PATH,
+            _("Path contains broken unicode character(s)"));
+    return NULL;
+}
+
+
+/**
+ * @brief Check if deletion time is impossible for recycle bin format
+ * @param filetime Deletion time as Windows `FILETIME`
+ * @param earliest Unix time when recycle bin format appeared
+ * @return `true` if deletion time is before `earliest`, or later
+ * than current time beyond tolerance of clock difference
+ */
+bool
+r2_filetime_is_dubious   (int64_t   filetime,
+                          int64_t   earliest)
+{
+    // Same resolution as r2_record_get_deltime()
+    int64_t t = (filetime - 116444736000000000LL) / 10000000;
+
+    return (t < earliest ||
+        t * G_USEC_PER_SEC - g_get_real_time () > 525600000LL);
+}
+
+
+static int
+_sort_names   (gconstpointer   a,
+               gconstpointer   b)
+{
+    return strcmp (*(const char **) a, *(const char **) b);
+}
+
+
+/**
+ * @brief List index files of `$Recycle.bin` folder, sorted by name
+ * @note Same as command line programs, folder without index file
+ * is only accepted if `desktop.ini` identifies it as empty
+ * recycle bin
+ */
+static bool
+_list_index_files   (r2_iter      *it,
+                     const char   *path,
+                     GError      **error)
+{
+    GDir        *dir;
+    const char  *name;
+
+    if (NULL == (dir = g_dir_open (path, 0, error)))
+        return false;
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+        if (r2_is_index_name (name))
+            g_ptr_array_add (it->names, g_strdup (name));
+    g_dir_close (dir);
+
+    if (it->names->len == 0 && ! r2_found_desktop_ini (path))
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+            _("No files with name pattern '%s' "
+            "are found in directory."), "$Ixxxxxx.*");
+        return false;
+    }
+
+    g_ptr_array_sort (it->names, _sort_names);
+    return true;
+}
+
+
+/**
+ * @brief Start iterating records of a recycle bin
+ * @param ctx Parsing context, which must outlive the iterator
+ * @param path `INFO2` file, `$Recycle.bin` folder, or single
+ * `$Recycle.bin` index file
+ * @param error Location to store error upon problem
+ * @return New iterator, or `NULL` if recycle bin can't be read
+ * @note `INFO2` header is validated immediately, while each
+ * `$Recycle.bin` index file is only read upon iteration. Single file
+ * is treated as index file if its name matches index file pattern.
+ */
+r2_iter *
+r2_iter_new   (r2_context   *ctx,
+               const char   *path,
+               GError      **error)
+{
+    r2_iter *it;
+
+    g_return_val_if_fail (ctx != NULL, NULL);
+    g_return_val_if_fail (path && *path, NULL);
+
+    if (! g_file_test (path, G_FILE_TEST_EXISTS))
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+            _("'%s' does not exist."), path);
+        return NULL;
+    }
+
+    it = g_malloc0 (sizeof (r2_iter));
+    it->rec.iter = it;
+    r2_decoder_init (&it->dec, ctx);
+
+    if (g_file_test (path, G_FILE_TEST_IS_DIR))
+    {
+        it->type = R2_BIN_FOLDER;
+        it->dir = g_strdup (path);
+        it->names = g_ptr_array_new_with_free_func (g_free);
+        if (! _list_index_files (it, path, error))
+            goto iter_fail;
+        return it;
+    }
+
+    {
+        char *basename = g_path_get_basename (path);
+
+        if (r2_is_index_name (basename))
+        {
+            it->type = R2_BIN_INDEX;
+            it->dir = g_path_get_dirname (path);
+            it->isolated = ! r2_found_desktop_ini (it->dir);
+            it->names = g_ptr_array_new_with_free_func (g_free);
+            g_ptr_array_add (it->names, basename);
+            return it;
+        }
+        g_free (basename);
+    }
+
+    it->type = R2_BIN_INFO2;
+    if (NULL == (it->map = g_mapped_file_new (path, FALSE, error)) ||
+        ! r2_info2_check_header (g_mapped_file_get_contents (it->map),
+            g_mapped_file_get_length (it->map),
+            &it->version, &it->recordsize, error))
+        goto iter_fail;
+
+    return it;
+
+    iter_fail:
+
+    r2_iter_free (it);
+    return NULL;
+}
+
+
+r2_bin_type
+r2_iter_get_bin_type   (const r2_iter   *it)
+{
+    return it->type;
+}
+
+
+/**
+ * @brief Read next `$Recycle.bin` index file
+ * @return `true` if a record is available, `false` at end of folder
+ * or upon error
+ */
+static bool
+_index_iter_next   (r2_iter   *it,
+                    GError   **error)
+{
+    const char *name;
+    char       *path;
+    uint64_t    version;
+    bool        ret;
+
+    if (it->next >= it->names->len)
+        return false;
+
+    name = it->names->pdata[it->next++];
+    path = g_build_filename (it->dir, name, NULL);
+
+    g_clear_pointer (&it->buf, g_free);
+    ret = g_file_get_contents (path, &it->buf, &it->buflen, error) &&
+        r2_index_check_header (it->buf, it->buflen, &version, error);
+    g_free (path);
+
+    if (! ret)
+    {
+        g_prefix_error (error, "%s: ", name);
+        return false;
+    }
+
+    r2_index_decode (&it->dec, &it->rec, (const guint8 *) it->buf,
+        it->buflen, version);
+    it->rec.index_name = name;
+    return true;
+}
+
+
+/**
+ * @brief Move to next record
+ * @param it The iterator
+ * @param error Location to store problem of current index file
+ * @return Record view, or `NULL` if there is no more record or upon
+ * error. After an error, iteration can continue with next index file.
+ */
+const r2_record *
+r2_iter_next   (r2_iter   *it,
+                GError   **error)
+{
+    g_return_val_if_fail (it != NULL, NULL);
+
+    if (it->type == R2_BIN_INFO2)
+        return r2_info2_iter_next (it) ? &it->rec : NULL;
+
+    return _index_iter_next (it, error) ? &it->rec : NULL;
+}
+
+
+void
+r2_iter_free   (r2_iter   *it)
+{
+    if (it == NULL)
+        return;
+
+    if (it->map)
+        g_mapped_file_unref (it->map);
+    if (it->names)
+        g_ptr_array_free (it->names, TRUE);
+    r2_decoder_clear (&it->dec);
+    g_clear_error (&it->rec.error);
+    g_free (it->dir);
+    g_free (it->buf);
+    g_free (it);
+}
+
+
+/**
+ * @brief Decode path of trashed file
+ * @param rec The record
+ * @param error Location to store error if path can't be decoded
+ * @return Newly allocated path in UTF-8, or `NULL` upon error
+ * @note Unicode path is preferred; legacy path is only used for
+ * `INFO2` without unicode path, and requires legacy encoding set
+ * in context
+ */
+char *
+r2_record_get_path   (const r2_record   *rec,
+                      GError           **error)
+{
+    g_return_val_if_fail (rec != NULL, NULL);
+
+    if (rec->uni_path)
+        return r2_decoder_convert (&rec->iter->dec, false,
+            (const char *) rec->uni_path,
+            ucs2_bytelen ((const char *) rec->uni_path, rec->uni_len),
+            error);
+
+    return r2_record_get_legacy_path (rec, error);
+}
+
+
+/**
+ * @brief Decode legacy (8.3) path of `INFO2` record
+ * @param rec The record
+ * @param error Location to store error if path can't be decoded
+ * @return Newly allocated path in UTF-8, or `NULL` upon error
+ */
+char *
+r2_record_get_legacy_path   (const r2_record   *rec,
+                             GError           **error)
+{
+    const char *enc;
+    char       *path, *result;
+
+    g_return_val_if_fail (rec != NULL, NULL);
+
+    enc = rec->iter->dec.ctx->legacy_encoding;
+    if (rec->legacy_path == NULL || enc == NULL)
+    {
+        g_set_error_literal (error, R2_REC_ERROR, R2_REC_ERROR_CONV_PATH,
+            _("Legacy path is unavailable, or its code page is unknown"));
+        return NULL;
+    }
+
+    // First byte is removed when trashed file is gone
+    path = g_strndup ((const char *) rec->legacy_path, rec->legacy_len);
+    if (path[0] == '\0')
+        path[0] = rec->drive;
+
+    result = r2_decoder_convert (&rec->iter->dec, true,
+        path, strlen (path), error);
+    g_free (path);
+    return result;
+}
+
+
+/**
+ * @brief Check if trashed file is still inside recycle bin
+ * @note For `$Recycle.bin`, this checks existence of corresponding
+ * `$R` file. Single index file taken out of its folder, that is
+ * without `desktop.ini` of recycle bin, reports unknown status.
+ */
+r2_status
+r2_record_get_status   (const r2_record   *rec)
+{
+    r2_iter *it;
+
+    g_return_val_if_fail (rec != NULL, R2_STATUS_UNKNOWN);
+
+    // First byte of legacy path is removed when trashed file is gone
+    if (rec->index_name == NULL)
+        return rec->legacy_path[0] ? R2_STATUS_EXISTS : R2_STATUS_GONE;
+
+    it = rec->iter;
+    return r2_index_status (it->dir, rec->index_name, it->isolated);
+}
+
+
+/**
+ * @brief Deletion time of record
+ * @return `GDateTime` in UTC, to be freed with `g_date_time_unref()`
+ */
+GDateTime *
+r2_record_get_deltime   (const r2_record   *rec)
+{
+    g_return_val_if_fail (rec != NULL, NULL);
+
+    // Sub-second resolution is not needed
+    return g_date_time_new_from_unix_utc (
+        (rec->filetime - 116444736000000000LL) / 10000000);
+}
+
+
+/**
+ * @brief Problem found when decoding record
+ * @return The error, owned by record, or `NULL` if record is
+ * deemed sane
+ * @note Records with problems are still returned by iterator,
+ * it's up to caller to decide whether to use them
+ */
+const GError *
+r2_record_get_error   (const r2_record   *rec)
+{
+    g_return_val_if_fail (rec != NULL, NULL);
+
+    return rec->error;
+}
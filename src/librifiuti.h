@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Embeddable recycle bin parser. All state lives in context and
+ * iterator objects, so any number of recycle bins can be parsed
+ * concurrently, as long as each iterator is only used by one thread
+ * at a time. A context is read-only after setup, thus can be shared
+ * among threads.
+ *
+ * Typical usage:
+ *
+ *     r2_context *ctx = r2_context_new ();
+ *     r2_iter *it = r2_iter_new (ctx, path, &error);
+ *     const r2_record *rec;
+ *
+ *     while ((rec = r2_iter_next (it, &error)) || error)
+ *     {
+ *         if (error) { ...; g_clear_error (&error); continue; }
+ *         char *p = r2_record_get_path (rec, NULL);
+ *         ...
+ *     }
+ *     r2_iter_free (it);
+ *     r2_context_free (ctx);
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <glib.h>
+
+typedef enum
+{
+    R2_BIN_INFO2,       /*!< Windows 95 to 2003 `INFO2` file */
+    R2_BIN_INDEX,       /*!< Single `$Recycle.bin` index file */
+    R2_BIN_FOLDER,      /*!< `$Recycle.bin` folder of index files */
+} r2_bin_type;
+
+typedef enum
+{
+    R2_STATUS_UNKNOWN = 0,
+    R2_STATUS_EXISTS,   /*!< Trashed file still inside recycle bin */
+    R2_STATUS_GONE,     /*!< Trashed file restored or purged */
+} r2_status;
+
+typedef struct _r2_context r2_context;
+typedef struct _r2_iter    r2_iter;
+
+/**
+ * @brief View of single record, only valid until next call of
+ * `r2_iter_next()` on the same iterator
+ * @note Numeric fields are decoded and validated upon iteration,
+ * with same criteria as command line programs. Paths and file
+ * status are only decoded upon request, see `r2_record_get_*()`.
+ */
+typedef struct _r2_record
+{
+    /*! `INFO2` only: index number of record */
+    uint32_t       index;
+    /*! `$Recycle.bin` only: index file name, `NULL` for `INFO2` */
+    const char    *index_name;
+    /*! `INFO2` only: drive letter of trashed file */
+    char           drive;
+    /*! Deletion time as Windows `FILETIME` */
+    int64_t        filetime;
+    /*! Size of trashed file, or `G_MAXUINT64` if unknown */
+    uint64_t       size;
+    /*! Version of `$Recycle.bin` index file, or version of `INFO2` */
+    uint64_t       version;
+
+    /*< private >*/
+    r2_iter       *iter;
+    const guint8  *uni_path;
+    gsize          uni_len;
+    const guint8  *legacy_path;
+    gsize          legacy_len;
+    GError        *error;
+} r2_record;
+
+
+r2_context *      r2_context_new             (void);
+bool              r2_context_set_legacy_encoding
+                                             (r2_context       *ctx,
+                                              const char       *encoding,
+                                              GError          **error);
+const char *      r2_context_get_legacy_encoding
+                                             (const r2_context *ctx);
+void              r2_context_free            (r2_context       *ctx);
+
+r2_iter *         r2_iter_new                (r2_context       *ctx,
+                                              const char       *path,
+                                              GError          **error);
+r2_bin_type       r2_iter_get_bin_type       (const r2_iter    *it);
+const r2_record * r2_iter_next               (r2_iter          *it,
+                                              GError          **error);
+void              r2_iter_free               (r2_iter          *it);
+
+char *            r2_record_get_path         (const r2_record  *rec,
+                                              GError          **error);
+char *            r2_record_get_legacy_path  (const r2_record  *rec,
+                                              GError          **error);
+r2_status         r2_record_get_status       (const r2_record  *rec);
+GDateTime *       r2_record_get_deltime      (const r2_record  *rec);
+const GError *    r2_record_get_error        (const r2_record  *rec);
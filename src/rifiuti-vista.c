@@ -6,13 +6,17 @@
 
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
+#include <string.h>
 
+#include "utils-cache.h"
 #include "utils-error.h"
 #include "utils-conv.h"
+#include "utils-debug.h"
+#include "utils-progress.h"
+#include "utils-stats.h"
 #include "utils.h"
 #include "rifiuti-vista.h"
-
-extern metarecord  *meta;
+#include "librifiuti-private.h"
 
 
 /**
@@ -41,222 +45,227 @@ _validate_index_file   (const char   *filename,
     g_return_val_if_fail (bufsize  , false);
     g_return_val_if_fail (ver      , false);
 
-    g_debug ("Start file validation for '%s'...", filename);
+    r2_debug ("Start file validation for '%s'...", filename);
 
     if (! g_file_get_contents (filename, &buf, bufsize, error))
-        goto validate_fail;
+        return false;
+
+    stats_count (STATS_FILES_OPENED, 1);
+    stats_count (STATS_BYTES_READ, *bufsize);
 
-    if (*bufsize <= VERSION1_FILENAME_OFFSET)
+    if (! r2_index_check_header (buf, *bufsize, ver, error))
     {
-        g_set_error_literal (error, R2_REC_ERROR,
-        R2_REC_ERROR_IDX_SIZE_INVALID,
-            _("File is not a $Recycle.bin index"));
-        goto validate_fail;
+        g_free (buf);
+        return false;
     }
 
-    copy_field (*ver, buf, VERSION_OFFSET, FILESIZE_OFFSET);
-    *ver = GUINT64_FROM_LE (*ver);
-    g_debug ("version = %" PRIu64, *ver);
+    *outbuf = buf;
+    r2_debug ("Finished file validation for '%s'", filename);
+    return true;
+}
 
-    switch (*ver)
-    {
-    case VERSION_VISTA: break;  // already handled above
 
-    case VERSION_WIN10:
-        // Version 2 adds a uint32 file name strlen before file name.
-        // This presumably breaks the 260 char barrier in version 1.
-        if (*bufsize <= VERSION2_FILENAME_OFFSET)
+/**
+ * @brief Convert decoded index file into record for output
+ * @param dec Decoder of calling thread
+ * @param buf Buffer holding index file content
+ * @param bufsize Size of buffer
+ * @param version Index file version
+ * @return Newly allocated record
+ */
+static rbin_struct *
+_populate_record_data  (r2_decoder  *dec,
+                        void        *buf,
+                        gsize        bufsize,
+                        uint64_t     version)
+{
+    rbin_struct  *record;
+    r2_record     rec = { 0 };
+
+    r2_index_decode (dec, &rec, buf, bufsize, version);
+
+    record = g_malloc0 (sizeof (rbin_struct));
+    record->version = rec.version;
+    record->filesize = rec.size;
+    record->winfiletime = rec.filetime;
+    record->deltime = win_filetime_to_gdatetime (rec.filetime);
+    record->raw_uni_path = g_string_new_len (
+        (const char *) rec.uni_path, rec.uni_len);
+    record->error = g_steal_pointer (&rec.error);
+
+    return record;
+}
+
+static void
+_parse_record_cb   (const char *index_file,
+                    metarecord *meta)
+{
+    rbin_struct       *record = NULL;
+    char              *basename = NULL;
+    uint64_t           version = 0;
+    gsize              bufsize;
+    void              *buf = NULL;
+    GError            *error = NULL;
+    GStatBuf           st;
+    bool               use_cache;
+    char              *dirname;
+
+    basename = g_path_get_basename (index_file);
+
+    // File status must be taken before reading
+    use_cache = (meta->cache && 0 == g_stat (index_file, &st));
+    if (use_cache &&
+        NULL != (record = rbin_cache_lookup (meta->cache, index_file, &st)))
+        r2_debug ("Using cached record for '%s'", basename);
+    else
+    {
+        if (! _validate_index_file (index_file,
+            &buf, &bufsize, &version, &error))
         {
-            g_set_error_literal (error, R2_REC_ERROR,
-            R2_REC_ERROR_IDX_SIZE_INVALID,
-                _("File is not a $Recycle.bin index"));
-            goto validate_fail;
+            g_hash_table_replace (meta->invalid_records,
+                g_strdup (basename), error);
+            g_free (basename);
+            return;
         }
-        break;
 
-    default:
-        if (*ver < 10)
-            g_set_error (error, R2_REC_ERROR,
-                R2_REC_ERROR_VER_UNSUPPORTED,
-                _("Index file version %" PRIu64 " is unsupported"), *ver);
-        else
-            g_set_error (error, R2_REC_ERROR,
-                R2_REC_ERROR_VER_UNSUPPORTED,
-                "%s", _("File is not a $Recycle.bin index"));
-        goto validate_fail;
+        r2_debug ("Start populating record for '%s'...", basename);
+
+        record = _populate_record_data (meta->dec, buf, bufsize, version);
+        g_free (buf);
+
+        if (use_cache)
+            rbin_cache_store (meta->cache, index_file, &st, record);
     }
 
-    *outbuf = buf;
-    g_debug ("Finished file validation for '%s'", filename);
-    return true;
+    /* Check corresponding $R.... file existance and set record->gone */
+    dirname = g_path_get_dirname (index_file);
+    record->gone = (trash_file_status) r2_index_status (dirname,
+        basename, meta->isolated_index);
+    g_free (dirname);
+
+    record->index_s = basename;
+    g_ptr_array_add (meta->records, record);
+    progress_add (PROGRESS_RECORDS, 1);
 
-    validate_fail:
-    g_free (buf);
-    return false;
+    r2_debug ("Parsing done for '%s'", basename);
 }
 
 
+/**
+ * @brief Attempt to interpret data at certain position as index record
+ * @param dec Decoder of calling thread
+ * @param buf Candidate record start
+ * @param avail Number of readable bytes from `buf`
+ * @return Newly allocated record, or `NULL` if data doesn't look like
+ * a sane index record
+ */
 static rbin_struct *
-_populate_record_data  (void      *buf,
-                        gsize      bufsize,
-                        uint64_t   version)
+_carve_index_at   (r2_decoder    *dec,
+                   const guint8  *buf,
+                   gsize          avail)
 {
+    uint64_t      ver;
+    int64_t       filetime;
+    uint32_t      namelen;
+    gsize         recsize;
     rbin_struct  *record;
-    uint32_t      path_sz_expected, path_sz_actual;
-    size_t        null_terminator_offset;
-    void         *pathbuf_start = NULL;
-    bool          erraneous = false;
-    GString      *u;  // shorthand
 
-    switch (version)
+    if (avail < VERSION2_FILENAME_OFFSET + 6)
+        return NULL;
+
+    copy_field (ver, buf, VERSION_OFFSET, FILESIZE_OFFSET);
+    ver = GUINT64_FROM_LE (ver);
+    copy_field (filetime, buf, FILETIME_OFFSET, VERSION1_FILENAME_OFFSET);
+    filetime = GINT64_FROM_LE (filetime);
+
+    if (filetime < CARVE_FILETIME_MIN || filetime > CARVE_FILETIME_MAX)
+        return NULL;
+
+    switch (ver)
     {
     case VERSION_VISTA:
-        // In rare cases, the size of index file is one byte short of
-        // (fixed) 544 bytes in Vista. Under such occasion, file size
-        // only occupies 56 bit, not 64 bit as it ought to be.
-        // Actually this 56-bit file size is very likely wrong after all.
-        // This is observed during deletion of dd.exe from Forensic
-        // Acquisition Utilities (by George M. Garner Jr)
-        // in certain localized Vista.
-        if (bufsize == VERSION1_FILE_SIZE - 1)
-            erraneous = true;
-
-        path_sz_expected = WIN_PATH_MAX * sizeof(gunichar2);
-        path_sz_actual = bufsize + (int)erraneous - VERSION1_FILENAME_OFFSET;
-        pathbuf_start = buf - (int)erraneous + VERSION1_FILENAME_OFFSET;
+        recsize = VERSION1_FILE_SIZE;
+        if (recsize > avail ||
+            ! carve_path_is_plausible (buf + VERSION1_FILENAME_OFFSET,
+                WIN_PATH_MAX, true))
+            return NULL;
         break;
 
     case VERSION_WIN10:
-        copy_field (path_sz_expected, buf, VERSION1_FILENAME_OFFSET,
+        copy_field (namelen, buf, VERSION1_FILENAME_OFFSET,
             VERSION2_FILENAME_OFFSET);
-        path_sz_expected = GUINT32_FROM_LE (path_sz_expected) *
-            sizeof(gunichar2);
-        path_sz_actual = bufsize - VERSION2_FILENAME_OFFSET;
-        pathbuf_start = buf + VERSION2_FILENAME_OFFSET;
+        namelen = GUINT32_FROM_LE (namelen);
+        if (namelen < 4 || namelen > CARVE_VERSION2_PATH_MAX)
+            return NULL;
+        recsize = VERSION2_FILENAME_OFFSET + namelen * sizeof (gunichar2);
+        if (recsize > avail ||
+            ! carve_path_is_plausible (buf + VERSION2_FILENAME_OFFSET,
+                namelen, true))
+            return NULL;
         break;
 
     default:
-        g_assert_not_reached ();
-    }
-
-    record = g_malloc0 (sizeof (rbin_struct));
-    record->version = version;
-
-    copy_field (record->filesize, buf, FILESIZE_OFFSET,
-        FILETIME_OFFSET - (int) erraneous);
-    if (erraneous)
-    {
-        g_debug ("filesize field broken, 56 bit only, val=0x%" PRIX64,
-                 record->filesize);
-        /* not printing the value because it was wrong and misleading */
-        record->filesize = G_MAXUINT64;
-    }
-    else
-    {
-        record->filesize = GUINT64_FROM_LE (record->filesize);
-        g_debug ("deleted file size = %" PRIu64, record->filesize);
-    }
-
-    /* File deletion time */
-    copy_field (record->winfiletime, buf - (int) erraneous,
-        FILETIME_OFFSET, VERSION1_FILENAME_OFFSET);
-    record->winfiletime = GINT64_FROM_LE (record->winfiletime);
-    record->deltime = win_filetime_to_gdatetime (record->winfiletime);
-    if (record->error == NULL)
-    {
-        GDateTime *now = g_date_time_new_now_utc ();
-
-        if (g_date_time_difference (record->deltime, now) > 525600000LL ||  // 1y
-            g_date_time_get_year (record->deltime) < 2007)
-            g_set_error_literal (&record->error, R2_REC_ERROR,
-                R2_REC_ERROR_DUBIOUS_TIME,
-                _("File deletion time is suspicious or broken"));
-        g_date_time_unref (now);
-    }
-
-    // Unicode path
-
-    if (path_sz_actual > path_sz_expected)
-    {
-        g_set_error_literal (&record->error, R2_REC_ERROR,
-            R2_REC_ERROR_DUBIOUS_PATH,
-            _("Ignored dangling extraneous data after record"));
-    }
-    else if (path_sz_actual < path_sz_expected && ! erraneous)
-    {
-        g_set_error_literal (&record->error, R2_REC_ERROR,
-            R2_REC_ERROR_DUBIOUS_PATH,
-            _("Record is truncated, thus unicode path might be incomplete"));
+        return NULL;
     }
 
-    u = g_string_new_len ((const char *) pathbuf_start,
-        MIN(path_sz_actual, path_sz_expected));
-    record->raw_uni_path = u;
-
-    null_terminator_offset = ucs2_bytelen (u->str, u->len);
+    if (! r2_index_check_header (buf, recsize, &ver, NULL))
+        return NULL;
 
-    if (record->error == NULL)
+    // Unlike index files on disk, any doubt means it is not a record
+    record = _populate_record_data (dec, (void *) buf, recsize, ver);
+    if (record->error)
     {
-        char *s = g_convert (u->str, null_terminator_offset,
-            "UTF-8", "UTF-16LE", NULL, NULL, NULL);
-        if (s)
-            g_free (s);
-        else
-            g_set_error_literal (&record->error, R2_REC_ERROR, R2_REC_ERROR_CONV_PATH,
-                _("Path contains broken unicode character(s)"));
+        free_record (record);
+        return NULL;
     }
-
     return record;
 }
 
+
+/**
+ * @brief Scan image chunk for index records
+ * @param chunk The image chunk
+ * @param meta Metadata for carved records
+ * @note Index files are small enough to be stored inside MFT entry,
+ * or otherwise placed at cluster boundary; either way records begin
+ * at 8 byte boundary, which reduces false positives drastically.
+ * Most significant byte of plausible deletion time is always 0x01,
+ * so candidates are located with `memchr()` before full check.
+ */
 static void
-_parse_record_cb   (const char *index_file,
-                    metarecord *meta)
+_carve_scan_cb   (carve_chunk  *chunk,
+                  metarecord   *meta)
 {
-    rbin_struct       *record = NULL;
-    char              *basename = NULL;
-    uint64_t           version = 0;
-    gsize              bufsize;
-    void              *buf = NULL;
-    extern bool        isolated_index;
-    GError            *error = NULL;
+    const guint8  *p, *end;
+    const gsize    msb = FILETIME_OFFSET + 7;
+    r2_decoder     dec;
 
-    basename = g_path_get_basename (index_file);
+    if (chunk->avail <= msb)
+        return;
 
-    if (! _validate_index_file (index_file,
-        &buf, &bufsize, &version, &error))
+    p = chunk->data + msb;
+    end = chunk->data + MIN (chunk->len + msb, chunk->avail);
+    r2_decoder_init (&dec, meta->ctx);
+
+    while (p < end && NULL != (p = memchr (p, 0x01, end - p)))
     {
-        g_hash_table_replace (meta->invalid_records,
-            g_strdup (basename), error);
-        g_free (basename);
-        return;
-    }
+        gsize         c = p - chunk->data - msb;
+        rbin_struct  *record;
 
-    g_debug ("Start populating record for '%s'...", basename);
+        p++;
+        if (c % 8 != 0)
+            continue;
 
-    record = _populate_record_data (buf, bufsize, version);
-    g_free (buf);
+        if (NULL == (record = _carve_index_at (&dec, chunk->data + c,
+            chunk->avail - c)))
+            continue;
 
-    /* Check corresponding $R.... file existance and set record->gone */
-    if (isolated_index)
-        record->gone = FILESTATUS_UNKNOWN;
-    else
-    {
-        char *dirname = g_path_get_dirname (index_file);
-        char *trash_basename = g_strdup (basename);
-        trash_basename[1] = 'R';  /* $R... versus $I... */
-        char *trash_path = g_build_filename (dirname, trash_basename, NULL);
-        record->gone = g_file_test (trash_path, G_FILE_TEST_EXISTS) ?
-            FILESTATUS_EXISTS : FILESTATUS_GONE;
-        g_free (dirname);
-        g_free (trash_basename);
-        g_free (trash_path);
+        record->index_s = g_strdup_printf ("0x%012" PRIX64,
+            chunk->offset + c);
+        g_ptr_array_add (chunk->found, record);
     }
 
-    record->index_s = basename;
-    g_ptr_array_add (meta->records, record);
-
-    g_debug ("Parsing done for '%s'", basename);
+    r2_decoder_clear (&dec);
 }
 
 
@@ -281,7 +290,7 @@ _compare_idx_versions (rbin_struct *record,
         return;
 
     if (meta->version != (int64_t) record->version) {
-        g_debug ("Bad entry %s, meta ver = %" PRId64
+        r2_debug ("Bad entry %s, meta ver = %" PRId64
             ", rec ver = %" PRId64,
             record->index_s, meta->version, (int64_t)record->version);
         meta->version = VERSION_INCONSISTENT;
@@ -307,6 +316,32 @@ _set_overall_rbin_version (metarecord *meta)
     return (meta->version != VERSION_INCONSISTENT);
 }
 
+static bool
+_post_parse_cb   (metarecord  *meta,
+                  GError     **error)
+{
+    if (! meta->records->len && g_hash_table_size (meta->invalid_records))
+    {
+        g_set_error_literal (error, R2_FATAL_ERROR,
+            R2_FATAL_ERROR_ILLEGAL_DATA,
+            _("No valid recycle bin record found"));
+        return false;
+    }
+
+    g_ptr_array_sort (meta->records, _sort_record_by_time);
+
+    // Carved records can come from any number of recycle bins
+    if (! _set_overall_rbin_version (meta) && ! meta->carved)
+    {
+        g_set_error_literal (error, R2_FATAL_ERROR,
+            R2_FATAL_ERROR_ILLEGAL_DATA,
+            _("Index files from multiple Windows versions are mixed together."
+            "  Please check each file individually."));
+        return false;
+    }
+    return true;
+}
+
 int
 main (int    argc,
       char **argv)
@@ -325,35 +360,8 @@ main (int    argc,
     ))
         goto cleanup;
 
-    do_parse_records (&_parse_record_cb);
-
-    if (! meta->records->len && g_hash_table_size (meta->invalid_records))
-    {
-        g_set_error_literal (&error, R2_FATAL_ERROR,
-            R2_FATAL_ERROR_ILLEGAL_DATA,
-            _("No valid recycle bin record found"));
-        goto cleanup;
-    }
-
-    g_ptr_array_sort (meta->records, _sort_record_by_time);
-    if (! _set_overall_rbin_version (meta))
-    {
-        g_set_error_literal (&error, R2_FATAL_ERROR,
-            R2_FATAL_ERROR_ILLEGAL_DATA,
-            _("Index files from multiple Windows versions are mixed together."
-            "  Please check each file individually."));
-        goto cleanup;
-    }
-
-    if (! dump_content (&error))
-    {
-        g_assert (error->domain == G_FILE_ERROR);
-        GError *new_err = g_error_new_literal (
-            R2_FATAL_ERROR, R2_FATAL_ERROR_TEMPFILE,
-            g_strdup (error->message));
-        g_error_free (error);
-        error = new_err;
-    }
+    process_bins (&_parse_record_cb, &_post_parse_cb,
+        (CarveScanFunc) &_carve_scan_cb, &error);
 
     cleanup:
 
@@ -16,3 +16,10 @@
 
 #define VERSION1_FILE_SIZE           ((VERSION1_FILENAME_OFFSET) + (WIN_PATH_MAX) * 2)
 
+
+/* Plausible deletion time of carved records, 2007-01-01 to 2040-01-01 */
+#define CARVE_FILETIME_MIN           128120832000000000LL
+#define CARVE_FILETIME_MAX           138534624000000000LL
+
+/* Longest path (including NUL) accepted in carved version 2 records */
+#define CARVE_VERSION2_PATH_MAX      32768
@@ -7,26 +7,18 @@
 
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
+#include <string.h>
 
 #include "utils-error.h"
 #include "utils-conv.h"
+#include "utils-debug.h"
+#include "utils-progress.h"
+#include "utils-stats.h"
 #include "utils.h"
 #include "rifiuti.h"
+#include "librifiuti-private.h"
 
 
-extern char        *legacy_encoding;
-extern metarecord  *meta;
-
-
-/* 0-25 => A-Z, 26 => '\', 27 or above is erraneous */
-unsigned char   driveletters[28] =
-{
-    'A', 'B', 'C', 'D', 'E', 'F', 'G',
-    'H', 'I', 'J', 'K', 'L', 'M', 'N',
-    'O', 'P', 'Q', 'R', 'S', 'T', 'U',
-    'V', 'W', 'X', 'Y', 'Z', '\\', '?'
-};
-
 /*!
  * Check if index file has sufficient amount of data for reading
  * 0 = success, all other return status = error
@@ -35,6 +27,7 @@ unsigned char   driveletters[28] =
  */
 static bool
 _validate_index_file   (const char   *filename,
+                        metarecord   *meta,
                         FILE        **infile,
                         GError      **error)
 {
@@ -42,11 +35,12 @@ _validate_index_file   (const char   *filename,
     FILE           *fp = NULL;
     uint32_t        ver;
     int             e;
+    gsize           read_sz;
 
     g_return_val_if_fail (filename && *filename, false);
     g_return_val_if_fail (infile && ! *infile, false);
 
-    g_debug ("Start file validation for '%s'...", filename);
+    r2_debug ("Start file validation for '%s'...", filename);
 
     if (! (fp = g_fopen (filename, "rb")))
     {
@@ -55,19 +49,15 @@ _validate_index_file   (const char   *filename,
             _("Can not open file: %s"), g_strerror(e));
         return false;
     }
+    stats_count (STATS_FILES_OPENED, 1);
 
     /* empty recycle bin = 20 bytes */
     buf = g_malloc (RECORD_START_OFFSET);
-    if (1 > fread (buf, RECORD_START_OFFSET, 1, fp))
-    {
-        g_set_error_literal (error, R2_FATAL_ERROR,
-            R2_FATAL_ERROR_ILLEGAL_DATA,
-            _("File is not an INFO2 index."));
+    read_sz = fread (buf, 1, RECORD_START_OFFSET, fp);
+    stats_count (STATS_BYTES_READ, read_sz);
+    if (! r2_info2_check_header (buf, read_sz, &ver,
+        &meta->recordsize, error))
         goto validation_fail;
-    }
-
-    copy_field (ver, buf, VERSION_OFFSET, KEPT_ENTRY_OFFSET);
-    ver = GUINT32_FROM_LE (ver);
 
     // total_entry only meaningful for 95 and NT4, on other versions
     // it's junk memory data, don't bother copying
@@ -76,52 +66,19 @@ _validate_index_file   (const char   *filename,
         meta->total_entry = GUINT32_FROM_LE (meta->total_entry);
     }
 
-    copy_field (meta->recordsize, buf, RECORD_SIZE_OFFSET, FILESIZE_SUM_OFFSET);
-    meta->recordsize = GUINT32_FROM_LE (meta->recordsize);
-
     g_free (buf);
     buf = NULL;
 
-    switch (meta->recordsize)
+    if (meta->recordsize == LEGACY_RECORD_SIZE &&
+        ! meta->ctx->legacy_encoding)
     {
-        case LEGACY_RECORD_SIZE:
-
-            if (( ver != VERSION_ME_03 ) &&  /* ME -> 280 byte record */
-                ( ver != VERSION_WIN98 ) &&
-                ( ver != VERSION_WIN95 ))
-            {
-                g_set_error (error, R2_FATAL_ERROR, R2_FATAL_ERROR_ILLEGAL_DATA,
-                    "Illegal INFO2 version %" PRIu32, ver);
-                goto validation_fail;
-            }
-
-            if (!legacy_encoding)
-            {
-                g_set_error_literal (error, G_OPTION_ERROR,
-                    G_OPTION_ERROR_FAILED,
-                    "This INFO2 file was produced on a legacy system "
-                    "without Unicode file name (Windows ME or earlier). "
-                    "Please specify codepage of concerned system with "
-                    "'-l' option.");
-                goto validation_fail;
-            }
-            break;
-
-        case UNICODE_RECORD_SIZE:
-
-            if (ver != VERSION_ME_03 && ver != VERSION_NT4)
-            {
-                g_set_error (error, R2_FATAL_ERROR, R2_FATAL_ERROR_ILLEGAL_DATA,
-                    "Illegal INFO2 version %" PRIu32, ver);
-                goto validation_fail;
-            }
-            break;
-
-        default:
-            g_set_error (error, R2_FATAL_ERROR, R2_FATAL_ERROR_ILLEGAL_DATA,
-                "Illegal INFO2 of record size %" PRIu32,
-                meta->recordsize);
-            goto validation_fail;
+        g_set_error_literal (error, G_OPTION_ERROR,
+            G_OPTION_ERROR_FAILED,
+            "This INFO2 file was produced on a legacy system "
+            "without Unicode file name (Windows ME or earlier). "
+            "Please specify codepage of concerned system with "
+            "'-l' option.");
+        goto validation_fail;
     }
 
     rewind (fp);
@@ -137,124 +94,53 @@ _validate_index_file   (const char   *filename,
 }
 
 
+/**
+ * @brief Convert decoded `INFO2` record into record for output
+ * @param meta Metadata of recycle bin
+ * @param dec Decoder of calling thread
+ * @param buf Start of record
+ * @param bufsize Number of readable bytes from `buf`
+ * @return Newly allocated record, or `NULL` if data is too short
+ */
 static rbin_struct *
-_populate_record_data   (void     *buf,
-                         size_t    bufsize)
+_populate_record_data   (metarecord  *meta,
+                         r2_decoder  *dec,
+                         void        *buf,
+                         size_t       bufsize)
 {
     rbin_struct    *record;
-    uint32_t        drivenum;
+    r2_record       rec = { 0 };
     size_t          null_terminator_offset;
     GString        *l, *u;  // shorthand for paths
 
-    // Unicode records accept partial path truncation,
-    // but no fault tolerance for Legacy records
-
-    if (meta->recordsize == LEGACY_RECORD_SIZE &&
-        bufsize < LEGACY_RECORD_SIZE)
-        return NULL;
-
-    if (meta->recordsize == UNICODE_RECORD_SIZE &&
-        bufsize <= LEGACY_RECORD_SIZE)
+    if (! r2_info2_decode (dec, &rec, buf, bufsize,
+        meta->recordsize, (uint32_t) meta->version))
         return NULL;
 
     record = g_malloc0 (sizeof (rbin_struct));
-
-    // Verbatim path in ANSI code page
-    l = g_string_new_len (buf, WIN_PATH_MAX);
-    record->raw_legacy_path = l;
-
-    /* Index number associated with the record */
-    copy_field (record->index_n, buf, RECORD_INDEX_OFFSET, DRIVE_LETTER_OFFSET);
-    record->index_n = GUINT32_FROM_LE (record->index_n);
-    g_debug ("index=%u", record->index_n);
-
-    /* Number representing drive letter, 'A:' = 0, etc */
-    copy_field (drivenum, buf, DRIVE_LETTER_OFFSET, FILETIME_OFFSET);
-    drivenum = GUINT32_FROM_LE (drivenum);
-    g_debug ("drive=%u", drivenum);
-    if (drivenum >= sizeof (driveletters) - 1) {
-        g_set_error (&record->error, R2_REC_ERROR,
-            R2_REC_ERROR_DRIVE_LETTER,
-            _("Drive number %" PRIu32 "does not represent "
-            "a valid drive"), drivenum);
-    }
-    record->drive = driveletters[MIN (drivenum, sizeof (driveletters) - 1)];
-
-    record->gone = FILESTATUS_EXISTS;
-    // If file is not in recycle bin (restored or permanently deleted),
-    // first byte will be removed from filename
+    record->index_n = rec.index;
+    record->drive = rec.drive;
+    record->winfiletime = rec.filetime;
+    record->deltime = win_filetime_to_gdatetime (rec.filetime);
+    record->filesize = rec.size;
+    record->gone = (trash_file_status) r2_record_get_status (&rec);
+    record->error = g_steal_pointer (&rec.error);
+
+    // Verbatim path in ANSI code page, with drive letter restored
+    // if trashed file is gone
+    l = g_string_new_len ((const char *) rec.legacy_path, rec.legacy_len);
     if (l->str[0] == '\0')
-    {
-        record->gone = FILESTATUS_GONE;
         l->str[0] = record->drive;
-    }
-
-    /* File deletion time */
-    copy_field (record->winfiletime, buf, FILETIME_OFFSET, FILESIZE_OFFSET);
-    record->winfiletime = GINT64_FROM_LE (record->winfiletime);
-    record->deltime = win_filetime_to_gdatetime (record->winfiletime);
-    if (record->error == NULL)
-    {
-        GDateTime *now = g_date_time_new_now_utc ();
-
-        if (g_date_time_difference (record->deltime, now) > 525600000LL ||  // 1y
-            g_date_time_get_year (record->deltime) < 1995)
-            g_set_error_literal (&record->error, R2_REC_ERROR,
-                R2_REC_ERROR_DUBIOUS_TIME,
-                _("File deletion time is suspicious or broken"));
-        g_date_time_unref (now);
-    }
-
-    /* File size or occupied cluster size */
-    /* BEWARE! This is 32bit data casted to 64bit struct member */
-    copy_field (record->filesize, buf,
-        FILESIZE_OFFSET, UNICODE_FILENAME_OFFSET);
-    record->filesize = GUINT64_FROM_LE (record->filesize);
-    g_debug ("filesize=%" PRIu64, record->filesize);
-
-    // Only bother checking legacy path when requested,
-    // because otherwise we don't know which encoding to use
-    if (legacy_encoding)
-    {
-        char *s = g_convert (l->str, -1,
-            "UTF-8", legacy_encoding, NULL, NULL, NULL);
-        if (s)
-            g_free (s);
-        else
-            g_set_error (&record->error, R2_REC_ERROR, R2_REC_ERROR_CONV_PATH,
-                _("Path contains character(s) that could not be "
-                "interpreted in %s encoding"), legacy_encoding);
-    }
+    record->raw_legacy_path = l;
 
-    if (bufsize == LEGACY_RECORD_SIZE)
+    if (rec.uni_path == NULL)
         return record;
 
-    // Part below deals with unicode path only
-
-    if (bufsize < UNICODE_RECORD_SIZE && record->error == NULL)
-    {
-        g_set_error_literal (&record->error, R2_REC_ERROR,
-            R2_REC_ERROR_DUBIOUS_PATH,
-            _("Record is truncated, thus unicode path might be incomplete"));
-    }
-
-    u = g_string_new_len ((const char *) (buf + UNICODE_FILENAME_OFFSET),
-        bufsize - UNICODE_FILENAME_OFFSET);
+    u = g_string_new_len ((const char *) rec.uni_path, rec.uni_len);
     record->raw_uni_path = u;
 
     null_terminator_offset = ucs2_bytelen (u->str, u->len);
 
-    if (record->error == NULL)
-    {
-        char *s = g_convert (u->str, null_terminator_offset,
-            "UTF-8", "UTF-16LE", NULL, NULL, NULL);
-        if (s)
-            g_free (s);
-        else
-            g_set_error_literal (&record->error, R2_REC_ERROR, R2_REC_ERROR_CONV_PATH,
-                _("Path contains broken unicode character(s)"));
-    }
-
     /*
      * We check for junk memory filling the padding area after
      * unicode path, using it as the indicator of OS generating this
@@ -282,7 +168,7 @@ _populate_record_data   (void     *buf,
         {
             if (*p != '\0')
             {
-                g_debug ("Junk detected at offset 0x%tx of unicode path",
+                r2_debug ("Junk detected at offset 0x%tx of unicode path",
                     p - u->str);
                 meta->fill_junk = true;
                 break;
@@ -310,29 +196,60 @@ _parse_record_cb   (const char *index_file,
     void          *buf = NULL;
     GError        *error = NULL;
     char          *segment_id;
+    uint32_t       prev_recordsize = meta->recordsize;
+    int64_t        prev_version = meta->version;
+    long           filesize;
+    uint64_t       total_read = 0;
 
-    if (! _validate_index_file (index_file, &infile, &error))
+    if (! _validate_index_file (index_file, meta, &infile, &error))
     {
+        meta->parsed_size = 0;
         g_hash_table_replace (meta->invalid_records,
             g_strdup (index_file), error);
         return;
     }
-    g_debug ("Start populating record for '%s'...", index_file);
-
-    fseek (infile, RECORD_START_OFFSET, SEEK_SET);
+    r2_debug ("Start populating record for '%s'...", index_file);
+
+    // Only records after previously parsed part are read, unless
+    // file is truncated (recycle bin emptied) or header changes,
+    // which means it is not the same INFO2 anymore
+    fseek (infile, 0, SEEK_END);
+    filesize = ftell (infile);
+    if (meta->parsed_size < RECORD_START_OFFSET ||
+        meta->parsed_size > (gsize) filesize ||
+        meta->recordsize != prev_recordsize ||
+        meta->version != prev_version)
+        meta->parsed_size = RECORD_START_OFFSET;
+    progress_add (PROGRESS_BYTES_TOTAL, (uint64_t) filesize - meta->parsed_size);
+
+    fseek (infile, (long) meta->parsed_size, SEEK_SET);
     prev_pos = curr_pos = ftell (infile);
 
     buf = g_malloc0 (meta->recordsize);
     while ((read_sz = fread (buf, 1, meta->recordsize, infile)) > 0)
     {
+        total_read += read_sz;
+        progress_add (PROGRESS_BYTES_DONE, read_sz);
+        // Record at end of growing file may be under writing
+        if (meta->follow && read_sz < meta->recordsize)
+        {
+            read_sz = 0;
+            break;
+        }
         prev_pos = curr_pos;
         curr_pos = ftell (infile);
-        g_debug ("Read byte range %zu-%zu %s", prev_pos, curr_pos,
+        r2_debug ("Read byte range %zu-%zu %s", prev_pos, curr_pos,
             (read_sz < meta->recordsize ? "" : " (!!!)"));
-        if (NULL != (record = _populate_record_data (buf, read_sz)))
+        if (NULL != (record = _populate_record_data (meta, meta->dec,
+            buf, read_sz)))
+        {
             g_ptr_array_add (meta->records, record);
+            progress_add (PROGRESS_RECORDS, 1);
+        }
     }
     g_free (buf);
+    meta->parsed_size = curr_pos;
+    stats_count (STATS_BYTES_READ, total_read);
 
     segment_id = g_strdup_printf ("|%zu|%zu", prev_pos, curr_pos);
 
@@ -358,6 +275,130 @@ _parse_record_cb   (const char *index_file,
     fclose (infile);
 }
 
+/**
+ * @brief Attempt to interpret data at certain position as INFO2 record
+ * @param dec Decoder of calling thread
+ * @param buf Candidate record start
+ * @param avail Number of readable bytes from `buf`
+ * @return Newly allocated record, or `NULL` if data doesn't look like
+ * a sane record
+ * @note Legacy (280 byte) records are only carved when code page
+ * is specified, as they don't contain unicode path
+ */
+static rbin_struct *
+_carve_record_at   (r2_decoder    *dec,
+                    const guint8  *buf,
+                    gsize          avail)
+{
+    metarecord    tmpl = { .type = RECYCLE_BIN_TYPE_FILE };
+    uint32_t      drivenum;
+    int64_t       filetime;
+    rbin_struct  *record;
+
+    if (avail < LEGACY_RECORD_SIZE)
+        return NULL;
+
+    copy_field (drivenum, buf, DRIVE_LETTER_OFFSET, FILETIME_OFFSET);
+    drivenum = GUINT32_FROM_LE (drivenum);
+    copy_field (filetime, buf, FILETIME_OFFSET, FILESIZE_OFFSET);
+    filetime = GINT64_FROM_LE (filetime);
+
+    if (drivenum >= sizeof (driveletters) - 1 ||
+        filetime < CARVE_FILETIME_MIN || filetime > CARVE_FILETIME_MAX ||
+        ! carve_path_is_plausible (buf, WIN_PATH_MAX, false))
+        return NULL;
+
+    // Drive letter is only removed from path when entry is gone
+    if (buf[0] && g_ascii_toupper (buf[0]) != driveletters[drivenum])
+        return NULL;
+
+    if (avail >= UNICODE_RECORD_SIZE && carve_path_is_plausible (
+        buf + UNICODE_FILENAME_OFFSET, WIN_PATH_MAX, true))
+        tmpl.recordsize = UNICODE_RECORD_SIZE;
+    else if (dec->ctx->legacy_encoding)
+        tmpl.recordsize = LEGACY_RECORD_SIZE;
+    else
+        return NULL;
+
+    // Unlike INFO2 file, any doubt means it is not a record
+    record = _populate_record_data (&tmpl, dec, (void *) buf,
+        tmpl.recordsize);
+    if (record->error)
+    {
+        free_record (record);
+        return NULL;
+    }
+    return record;
+}
+
+
+/**
+ * @brief Scan image chunk for INFO2 records
+ * @param chunk The image chunk
+ * @param meta Metadata for carved records
+ * @note Records are placed right after each other, but INFO2 header
+ * may be lost, and file itself can be fragmented; so every record is
+ * recognized on its own. Most significant byte of plausible deletion
+ * time is always 0x01, and upper bytes of drive number are zero, so
+ * candidates are located with `memchr()` before full check.
+ */
+static void
+_carve_scan_cb   (carve_chunk  *chunk,
+                  metarecord   *meta)
+{
+    const guint8  *p, *end;
+    const gsize    msb = FILETIME_OFFSET + 7;
+    r2_decoder     dec;
+
+    if (chunk->avail <= msb)
+        return;
+
+    p = chunk->data + msb;
+    end = chunk->data + MIN (chunk->len + msb, chunk->avail);
+    r2_decoder_init (&dec, meta->ctx);
+
+    while (p < end && NULL != (p = memchr (p, 0x01, end - p)))
+    {
+        gsize         c = p - chunk->data - msb;
+        const guint8 *d = chunk->data + c + DRIVE_LETTER_OFFSET;
+        rbin_struct  *record;
+
+        p++;
+        if (d[1] || d[2] || d[3])
+            continue;
+
+        if (NULL == (record = _carve_record_at (&dec, chunk->data + c,
+            chunk->avail - c)))
+            continue;
+
+        record->index_s = g_strdup_printf ("0x%012" PRIX64,
+            chunk->offset + c);
+        g_ptr_array_add (chunk->found, record);
+    }
+
+    r2_decoder_clear (&dec);
+}
+
+
+static bool
+_post_parse_cb   (metarecord  *meta,
+                  GError     **error)
+{
+    // INFO2 header is not carved, and records may come from
+    // any number of recycle bins
+    if (meta->carved)
+        meta->version = VERSION_NOT_FOUND;
+
+    if (! meta->records->len && g_hash_table_size (meta->invalid_records))
+    {
+        g_set_error_literal (error, R2_FATAL_ERROR,
+            R2_FATAL_ERROR_ILLEGAL_DATA,
+            _("No valid recycle bin record found"));
+        return false;
+    }
+    return true;
+}
+
 int
 main (int    argc,
       char **argv)
@@ -374,25 +415,8 @@ main (int    argc,
     ))
         goto cleanup;
 
-    do_parse_records (&_parse_record_cb);
-
-    if (! meta->records->len && g_hash_table_size (meta->invalid_records))
-    {
-        g_set_error_literal (&error, R2_FATAL_ERROR,
-            R2_FATAL_ERROR_ILLEGAL_DATA,
-            _("No valid recycle bin record found"));
-        goto cleanup;
-    }
-
-    if (! dump_content (&error))
-    {
-        g_assert (error->domain == G_FILE_ERROR);
-        GError *new_err = g_error_new_literal (
-            R2_FATAL_ERROR, R2_FATAL_ERROR_TEMPFILE,
-            g_strdup (error->message));
-        g_error_free (error);
-        error = new_err;
-    }
+    process_bins (&_parse_record_cb, &_post_parse_cb,
+        (CarveScanFunc) &_carve_scan_cb, &error);
 
     cleanup:
 
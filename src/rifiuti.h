@@ -28,3 +28,6 @@
 #define LEGACY_RECORD_SIZE      ((WIN_PATH_MAX) + 20)        /* 280 bytes */
 #define UNICODE_RECORD_SIZE     ((WIN_PATH_MAX) * 3 + 20)    /* 800 bytes */
 
+/* Plausible deletion time of carved records, 1995-01-01 to 2040-01-01 */
+#define CARVE_FILETIME_MIN      124333920000000000LL
+#define CARVE_FILETIME_MAX      138534624000000000LL
@@ -0,0 +1,628 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Minimal writer of Apache Arrow IPC streaming format, see
+ * https://arrow.apache.org/docs/format/Columnar.html#ipc-streaming-format
+ *
+ * Only the tiny subset of flatbuffers needed for encoding schema and
+ * record batch messages is implemented here, so that no extra library
+ * is needed. Objects are laid out front to back, and offsets to child
+ * objects are patched after children are written.
+ */
+
+#include <string.h>
+
+#include "utils-arrow.h"
+#include "utils-conv.h"
+
+/* Records per batch, which bounds memory used by column buffers */
+#define ARROW_BATCH_SIZE        65536
+
+/* Windows FILETIME value of Unix epoch, in 100ns unit */
+#define FILETIME_UNIX_EPOCH     116444736000000000LL
+
+#define ALIGN_TO(n, a)          (((n) + (a) - 1) / (a) * (a))
+
+/* Enum values from Arrow Schema.fbs and Message.fbs */
+#define ARROW_METADATA_V5       4
+#define ARROW_HEADER_SCHEMA     1
+#define ARROW_HEADER_BATCH      3
+#define ARROW_TYPE_INT          2
+#define ARROW_TYPE_UTF8         5
+#define ARROW_TYPE_BOOL         6
+#define ARROW_TYPE_TIMESTAMP    10
+#define ARROW_UNIT_NANOSECOND   3
+
+#define ARROW_CONTINUATION      0xFFFFFFFFU
+
+typedef enum
+{
+    COL_INDEX,
+    COL_TIME,
+    COL_GONE,
+    COL_SIZE,
+    COL_PATH,
+    N_COLS
+} arrow_col_id;
+
+typedef struct _arrow_column
+{
+    GString    *validity;    /* bitmap, 1 = valid */
+    GString    *values;      /* fixed width values, or bitmap for bool */
+    GString    *offsets;     /* int32 offsets of string data */
+    GString    *data;        /* string data */
+    int64_t     null_count;
+} arrow_column;
+
+struct _arrow_writer
+{
+    const metarecord  *meta;
+    GString           *out;
+    int64_t            nrows;
+    arrow_column       cols[N_COLS];
+};
+
+
+/*
+ * Flatbuffer construction helpers
+ */
+
+static void
+_fb_pad   (GByteArray   *fb,
+           guint         align)
+{
+    static const guint8 zero[8] = { 0 };
+
+    g_byte_array_append (fb, zero, (align - fb->len % align) % align);
+}
+
+
+static void
+_fb_put   (GByteArray   *fb,
+           gsize         pos,
+           uint64_t      val,
+           guint         size)
+{
+    // flatbuffers are always little endian
+    for (guint i = 0; i < size; i++, val >>= 8)
+        fb->data[pos + i] = (guint8) (val & 0xFF);
+}
+
+
+/**
+ * @brief Point uoffset field at `pos` to object at `target`
+ * @note uoffsets are unsigned, so target must come after `pos`
+ */
+static void
+_fb_link  (GByteArray   *fb,
+           gsize         pos,
+           gsize         target)
+{
+    g_assert (target > pos);
+    _fb_put (fb, pos, target - pos, 4);
+}
+
+
+/**
+ * @brief Append zero filled table and its vtable
+ * @param fb The flatbuffer being built
+ * @param nfields Number of fields in table
+ * @param sizes Inline size of each field, 0 if field is absent
+ * @param pos Location to store position of each field
+ * @return Position of table, which should be referenced by parent
+ * @note Fields are placed in decreasing order of size, so that all
+ * of them are naturally aligned. Table is always 8-byte aligned.
+ */
+static gsize
+_fb_table   (GByteArray     *fb,
+             guint           nfields,
+             const guint8   *sizes,
+             gsize          *pos)
+{
+    guint16  offs[8] = { 0 };
+    guint    cur = 4;  /* after soffset to vtable */
+    guint    vt_size = 4 + 2 * nfields;
+    gsize    tbl_pos;
+
+    g_assert (nfields <= G_N_ELEMENTS (offs));
+
+    for (guint width = 8; width > 0; width /= 2)
+        for (guint i = 0; i < nfields; i++)
+            if (sizes[i] == width)
+            {
+                cur = ALIGN_TO (cur, width);
+                offs[i] = cur;
+                cur += width;
+            }
+    cur = ALIGN_TO (cur, 4);
+
+    // vtable immediately precedes table
+    while ((fb->len + vt_size) % 8)
+        g_byte_array_append (fb, (const guint8 *) "", 1);
+
+    tbl_pos = fb->len + vt_size;
+    g_byte_array_set_size (fb, tbl_pos + cur);
+    memset (fb->data + tbl_pos - vt_size, 0, vt_size + cur);
+
+    _fb_put (fb, tbl_pos - vt_size, vt_size, 2);
+    _fb_put (fb, tbl_pos - vt_size + 2, cur, 2);
+    for (guint i = 0; i < nfields; i++)
+    {
+        _fb_put (fb, tbl_pos - vt_size + 4 + 2 * i, offs[i], 2);
+        pos[i] = offs[i] ? tbl_pos + offs[i] : 0;
+    }
+    _fb_put (fb, tbl_pos, vt_size, 4);  /* vtable = table - soffset */
+
+    return tbl_pos;
+}
+
+
+/**
+ * @brief Append zero filled vector
+ * @param fb The flatbuffer being built
+ * @param count Number of elements
+ * @param elem_size Size of each element, which also decides alignment
+ * @return Position of vector, which should be referenced by parent.
+ * Elements start 4 bytes after that.
+ */
+static gsize
+_fb_vector   (GByteArray   *fb,
+              guint         count,
+              guint         elem_size)
+{
+    gsize vec_pos;
+
+    _fb_pad (fb, 4);
+    while ((fb->len + 4) % MAX (MIN (elem_size, 8), 4))
+        g_byte_array_append (fb, (const guint8 *) "", 1);
+
+    vec_pos = fb->len;
+    g_byte_array_set_size (fb, vec_pos + 4 + count * elem_size);
+    memset (fb->data + vec_pos, 0, 4 + count * elem_size);
+    _fb_put (fb, vec_pos, count, 4);
+
+    return vec_pos;
+}
+
+
+static gsize
+_fb_string   (GByteArray   *fb,
+              const char   *str)
+{
+    gsize len = strlen (str);
+    gsize pos = _fb_vector (fb, len + 1, 1);
+
+    // length doesn't include NUL terminator
+    _fb_put (fb, pos, len, 4);
+    memcpy (fb->data + pos + 4, str, len);
+    return pos;
+}
+
+
+static GByteArray *
+_fb_new_message   (guint8      header_type,
+                   int64_t     body_len,
+                   gsize      *header_pos)
+{
+    static const guint8 msg_sizes[] = { 2, 1, 4, 8 };
+    gsize        pos[G_N_ELEMENTS (msg_sizes)], tbl;
+    GByteArray  *fb = g_byte_array_new ();
+
+    g_byte_array_set_size (fb, 4);  /* root offset */
+    tbl = _fb_table (fb, G_N_ELEMENTS (msg_sizes), msg_sizes, pos);
+    _fb_put (fb, 0, tbl, 4);
+
+    _fb_put (fb, pos[0], ARROW_METADATA_V5, 2);
+    _fb_put (fb, pos[1], header_type, 1);
+    _fb_put (fb, pos[3], (uint64_t) body_len, 8);
+
+    *header_pos = pos[2];
+    return fb;
+}
+
+
+/*
+ * Arrow message encoding
+ */
+
+static void
+_append_le   (GString    *s,
+              uint64_t    val,
+              guint       size)
+{
+    for (guint i = 0; i < size; i++, val >>= 8)
+        s = g_string_append_c (s, (char) (val & 0xFF));
+}
+
+
+static void
+_append_padding   (GString   *s)
+{
+    while (s->len % 8)
+        s = g_string_append_c (s, '\0');
+}
+
+
+/**
+ * @brief Write encapsulated message, followed by message body
+ * @note Output buffer is assumed to start at 8-byte boundary, which
+ * holds as long as it contains nothing but Arrow messages.
+ */
+static void
+_write_message   (GString      *out,
+                  GByteArray   *fb,
+                  GString     **body,
+                  guint         nbody)
+{
+    _fb_pad (fb, 8);
+    _append_le (out, ARROW_CONTINUATION, 4);
+    _append_le (out, fb->len, 4);
+    out = g_string_append_len (out, (const char *) fb->data, fb->len);
+
+    for (guint i = 0; i < nbody; i++)
+    {
+        if (body[i] != NULL)
+            out = g_string_append_len (out, body[i]->str, body[i]->len);
+        _append_padding (out);
+    }
+    g_byte_array_free (fb, TRUE);
+}
+
+
+static bool
+_col_is_utf8   (const arrow_writer  *w,
+                arrow_col_id         id)
+{
+    return (id == COL_PATH ||
+        (id == COL_INDEX && ! has_numeric_index (w->meta)));
+}
+
+
+static gsize
+_write_field   (GByteArray          *fb,
+                const arrow_writer  *w,
+                arrow_col_id         id)
+{
+    static const char *names[] = { "index", "time", "gone", "size", "path" };
+    static const guint8 field_sizes[] = { 4, 1, 1, 4, 0, 4 };
+    static const guint8 int_sizes[] = { 4, 1 };
+    static const guint8 ts_sizes[] = { 2, 4 };
+    gsize   pos[G_N_ELEMENTS (field_sizes)], type_pos[2], tbl, type_tbl;
+    guint8  type;
+
+    if (_col_is_utf8 (w, id))
+        type = ARROW_TYPE_UTF8;
+    else if (id == COL_TIME)
+        type = ARROW_TYPE_TIMESTAMP;
+    else if (id == COL_GONE)
+        type = ARROW_TYPE_BOOL;
+    else
+        type = ARROW_TYPE_INT;
+
+    tbl = _fb_table (fb, G_N_ELEMENTS (field_sizes), field_sizes, pos);
+    // Index is always present, others may be unknown or broken
+    _fb_put (fb, pos[1], (id != COL_INDEX), 1);
+    _fb_put (fb, pos[2], type, 1);
+    _fb_link (fb, pos[0], _fb_string (fb, names[id]));
+
+    switch (type)
+    {
+        case ARROW_TYPE_INT:
+            type_tbl = _fb_table (fb, 2, int_sizes, type_pos);
+            _fb_put (fb, type_pos[0], (id == COL_INDEX) ? 32 : 64, 4);
+            break;
+        case ARROW_TYPE_TIMESTAMP:
+            type_tbl = _fb_table (fb, 2, ts_sizes, type_pos);
+            _fb_put (fb, type_pos[0], ARROW_UNIT_NANOSECOND, 2);
+            _fb_link (fb, type_pos[1], _fb_string (fb, "UTC"));
+            break;
+        default:  /* Utf8 and Bool tables are empty */
+            type_tbl = _fb_table (fb, 0, NULL, type_pos);
+    }
+    _fb_link (fb, pos[3], type_tbl);
+
+    // Some readers refuse null children vector
+    _fb_link (fb, pos[5], _fb_vector (fb, 0, 4));
+
+    return tbl;
+}
+
+
+static gsize
+_write_keyvalue   (GByteArray   *fb,
+                   const char   *key,
+                   const char   *value)
+{
+    static const guint8 kv_sizes[] = { 4, 4 };
+    gsize pos[2], tbl;
+
+    tbl = _fb_table (fb, 2, kv_sizes, pos);
+    _fb_link (fb, pos[0], _fb_string (fb, key));
+    _fb_link (fb, pos[1], _fb_string (fb, value));
+    return tbl;
+}
+
+
+/**
+ * @brief Write schema message, with recycle bin metadata stored
+ * as custom key-value pairs
+ * @note Keys are the same as metadata in JSON output
+ */
+static void
+_write_schema   (arrow_writer   *w)
+{
+    static const guint8 schema_sizes[] = { 0, 4, 4 };
+    const metarecord *meta = w->meta;
+    GPtrArray   *kv = g_ptr_array_new_with_free_func (g_free);
+    GByteArray  *fb;
+    gsize        hdr_pos, pos[3], vec;
+
+    g_ptr_array_add (kv, g_strdup ("format"));
+    g_ptr_array_add (kv, g_strdup (
+        (meta->type == RECYCLE_BIN_TYPE_FILE) ? "file" : "dir"));
+    if (meta->version >= 0)
+    {
+        g_ptr_array_add (kv, g_strdup ("version"));
+        g_ptr_array_add (kv, g_strdup_printf ("%" PRId64, meta->version));
+    }
+    if (meta->type == RECYCLE_BIN_TYPE_FILE && meta->total_entry > 0)
+    {
+        g_ptr_array_add (kv, g_strdup ("ever_existed"));
+        g_ptr_array_add (kv, g_strdup_printf ("%" PRIu32, meta->total_entry));
+    }
+    g_ptr_array_add (kv, g_strdup ("path"));
+    g_ptr_array_add (kv, g_filename_display_name (meta->filename));
+
+    fb = _fb_new_message (ARROW_HEADER_SCHEMA, 0, &hdr_pos);
+    _fb_link (fb, hdr_pos,
+        _fb_table (fb, G_N_ELEMENTS (schema_sizes), schema_sizes, pos));
+
+    vec = _fb_vector (fb, N_COLS, 4);
+    _fb_link (fb, pos[1], vec);
+    for (guint i = 0; i < N_COLS; i++)
+        _fb_link (fb, vec + 4 + 4 * i, _write_field (fb, w, i));
+
+    vec = _fb_vector (fb, kv->len / 2, 4);
+    _fb_link (fb, pos[2], vec);
+    for (guint i = 0; i < kv->len / 2; i++)
+        _fb_link (fb, vec + 4 + 4 * i, _write_keyvalue (fb,
+            g_ptr_array_index (kv, 2 * i), g_ptr_array_index (kv, 2 * i + 1)));
+
+    _write_message (w->out, fb, NULL, 0);
+    g_ptr_array_free (kv, TRUE);
+}
+
+
+/*
+ * Column building
+ */
+
+static void
+_reset_columns   (arrow_writer   *w)
+{
+    for (guint i = 0; i < N_COLS; i++)
+    {
+        arrow_column *c = &w->cols[i];
+
+        g_string_truncate (c->validity, 0);
+        g_string_truncate (c->values, 0);
+        g_string_truncate (c->offsets, 0);
+        g_string_truncate (c->data, 0);
+        c->null_count = 0;
+
+        if (_col_is_utf8 (w, i))
+            _append_le (c->offsets, 0, 4);
+    }
+    w->nrows = 0;
+}
+
+
+static void
+_bitmap_append   (GString   *bitmap,
+                  int64_t    row,
+                  bool       val)
+{
+    if (row % 8 == 0)
+        bitmap = g_string_append_c (bitmap, '\0');
+    if (val)
+        bitmap->str[row / 8] |= (char) (1 << (row % 8));
+}
+
+
+static void
+_set_valid   (arrow_column  *c,
+              int64_t        row,
+              bool           valid)
+{
+    _bitmap_append (c->validity, row, valid);
+    if (! valid)
+        c->null_count++;
+}
+
+
+static void
+_end_string   (arrow_column  *c)
+{
+    _append_le (c->offsets, c->data->len, 4);
+}
+
+
+/**
+ * @brief Write all buffered rows as a record batch message
+ */
+static void
+_write_batch   (arrow_writer   *w)
+{
+    static const guint8 batch_sizes[] = { 8, 4, 4 };
+    GString     *body[N_COLS * 3];
+    GByteArray  *fb;
+    guint        nbody = 0;
+    int64_t      body_len = 0;
+    gsize        hdr_pos, pos[3], vec;
+
+    if (w->nrows == 0)
+        return;
+
+    // Buffer order follows column order; validity bitmap can
+    // be omitted when there is no null value
+    for (guint i = 0; i < N_COLS; i++)
+    {
+        arrow_column *c = &w->cols[i];
+
+        body[nbody++] = c->null_count ? c->validity : NULL;
+        if (_col_is_utf8 (w, i))
+        {
+            body[nbody++] = c->offsets;
+            body[nbody++] = c->data;
+        }
+        else
+            body[nbody++] = c->values;
+    }
+
+    for (guint i = 0; i < nbody; i++)
+        body_len += ALIGN_TO (body[i] ? body[i]->len : 0, 8);
+
+    fb = _fb_new_message (ARROW_HEADER_BATCH, body_len, &hdr_pos);
+    _fb_link (fb, hdr_pos,
+        _fb_table (fb, G_N_ELEMENTS (batch_sizes), batch_sizes, pos));
+    _fb_put (fb, pos[0], (uint64_t) w->nrows, 8);
+
+    // FieldNode { length, null_count }
+    vec = _fb_vector (fb, N_COLS, 16);
+    _fb_link (fb, pos[1], vec);
+    for (guint i = 0; i < N_COLS; i++)
+    {
+        _fb_put (fb, vec + 4 + 16 * i, (uint64_t) w->nrows, 8);
+        _fb_put (fb, vec + 12 + 16 * i, (uint64_t) w->cols[i].null_count, 8);
+    }
+
+    // Buffer { offset, length }
+    vec = _fb_vector (fb, nbody, 16);
+    _fb_link (fb, pos[2], vec);
+    body_len = 0;
+    for (guint i = 0; i < nbody; i++)
+    {
+        gsize len = body[i] ? body[i]->len : 0;
+
+        _fb_put (fb, vec + 4 + 16 * i, (uint64_t) body_len, 8);
+        _fb_put (fb, vec + 12 + 16 * i, len, 8);
+        body_len += ALIGN_TO (len, 8);
+    }
+
+    _write_message (w->out, fb, body, nbody);
+    _reset_columns (w);
+}
+
+
+/**
+ * @brief Start writing Arrow IPC stream
+ * @param meta Recycle bin metadata, which determines column types
+ * @param out Output buffer for the binary stream
+ * @return Newly created writer, after schema message is written
+ */
+arrow_writer *
+arrow_writer_new   (const metarecord  *meta,
+                    GString           *out)
+{
+    arrow_writer *w = g_malloc0 (sizeof (arrow_writer));
+
+    w->meta = meta;
+    w->out = out;
+
+    for (guint i = 0; i < N_COLS; i++)
+    {
+        w->cols[i].validity = g_string_sized_new (ARROW_BATCH_SIZE / 8);
+        w->cols[i].values   = g_string_sized_new (ARROW_BATCH_SIZE * 8);
+        w->cols[i].offsets  = g_string_sized_new (ARROW_BATCH_SIZE * 4 + 4);
+        w->cols[i].data     = g_string_new (NULL);
+    }
+    _reset_columns (w);
+    _write_schema (w);
+
+    return w;
+}
+
+
+/**
+ * @brief Append a record to current batch
+ * @note A record batch message is written to output buffer when
+ * batch is full.
+ */
+void
+arrow_writer_add   (arrow_writer   *w,
+                    rbin_struct    *record)
+{
+    arrow_column  *c;
+    GString       *src;
+    const char    *enc;
+    int64_t        row = w->nrows;
+    bool           valid;
+
+    g_return_if_fail (w != NULL);
+    g_return_if_fail (record != NULL);
+
+    c = &w->cols[COL_INDEX];
+    _set_valid (c, row, true);
+    if (has_numeric_index (w->meta))
+        _append_le (c->values, record->index_n, 4);
+    else
+    {
+        c->data = g_string_append (c->data, record->index_s);
+        _end_string (c);
+    }
+
+    // FILETIME is 100ns unit, which can overflow for bogus values
+    c = &w->cols[COL_TIME];
+    valid = (record->winfiletime >= FILETIME_UNIX_EPOCH + G_MININT64 / 100 &&
+             record->winfiletime <= FILETIME_UNIX_EPOCH + G_MAXINT64 / 100);
+    _set_valid (c, row, valid);
+    _append_le (c->values, valid ?
+        (uint64_t) ((record->winfiletime - FILETIME_UNIX_EPOCH) * 100) : 0, 8);
+
+    c = &w->cols[COL_GONE];
+    _set_valid (c, row, record->gone != FILESTATUS_UNKNOWN);
+    _bitmap_append (c->values, row, record->gone == FILESTATUS_GONE);
+
+    c = &w->cols[COL_SIZE];
+    valid = (record->filesize != G_MAXUINT64);  // faulty
+    _set_valid (c, row, valid);
+    _append_le (c->values, valid ? record->filesize : 0, 8);
+
+    c = &w->cols[COL_PATH];
+    enc = r2_context_get_legacy_encoding (w->meta->ctx);
+    src = enc ? record->raw_legacy_path : record->raw_uni_path;
+    _set_valid (c, row, conv_path_to_utf8_with_tmpl (src, enc,
+        FORMAT_ARROW, NULL, c->data, &record->error));
+    _end_string (c);
+
+    if (++w->nrows == ARROW_BATCH_SIZE)
+        _write_batch (w);
+}
+
+
+/**
+ * @brief Write remaining records and end of stream marker,
+ * then free the writer
+ */
+void
+arrow_writer_finish   (arrow_writer   *w)
+{
+    g_return_if_fail (w != NULL);
+
+    _write_batch (w);
+    _append_le (w->out, ARROW_CONTINUATION, 4);
+    _append_le (w->out, 0, 4);
+
+    for (guint i = 0; i < N_COLS; i++)
+    {
+        g_string_free (w->cols[i].validity, TRUE);
+        g_string_free (w->cols[i].values, TRUE);
+        g_string_free (w->cols[i].offsets, TRUE);
+        g_string_free (w->cols[i].data, TRUE);
+    }
+    g_free (w);
+}
@@ -0,0 +1,20 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "utils.h"
+
+typedef struct _arrow_writer arrow_writer;
+
+arrow_writer *    arrow_writer_new           (const metarecord  *meta,
+                                              GString           *out);
+void              arrow_writer_add           (arrow_writer      *w,
+                                              rbin_struct       *record);
+void              arrow_writer_finish        (arrow_writer      *w);
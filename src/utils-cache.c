@@ -0,0 +1,629 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Persistent cache of parsed $Recycle.bin index files, for repeated
+ * sweeps of same recycle bins. Index files are keyed by device, inode,
+ * size and modification time; folders by device, inode and
+ * modification time, so that unchanged folders are not scanned again.
+ *
+ * Cache is a text file, one entry per line, with fields separated by
+ * TAB. Path and file names are escaped with g_strescape().
+ *
+ *   D  dev  ino  mtime  path          (folder, followed by its entries)
+ *   N  name                           (index file name inside folder)
+ *   F  dev  ino  size  mtime  version  filesize  filetime  upath  path
+ *
+ * where `upath` is base64 encoded UTF-16 path stored inside index file.
+ * Like git index, an entry modified within the same second as it is
+ * being examined is never stored, since further modification within
+ * that second would go unnoticed.
+ *
+ * In memory, index files are grouped under their folder, so that
+ * storing names of one folder only touches entries of that folder.
+ * Folders not visited in current run are dropped upon saving if they
+ * no longer exist.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include "utils-cache.h"
+
+#define CACHE_FILE_NAME     "rifiuti2-index.cache"
+#define CACHE_MAGIC         "rifiuti2 index cache 1"
+
+typedef struct _stat_key
+{
+    uint64_t  dev;
+    uint64_t  ino;
+    uint64_t  size;     /* unused for folders */
+    int64_t   mtime;
+} stat_key;
+
+typedef struct _dir_entry
+{
+    stat_key    key;
+    GPtrArray  *names;   /* NULL if folder content is not cached */
+    GHashTable *files;   /* file name -> file_entry */
+    bool        seen;    /* visited in current run */
+} dir_entry;
+
+typedef struct _file_entry
+{
+    stat_key   key;
+    uint64_t   version;
+    uint64_t   filesize;
+    int64_t    winfiletime;
+    GString   *uni_path;
+} file_entry;
+
+struct _rbin_cache
+{
+    char       *path;
+    GMutex      lock;
+    GHashTable *dirs;    /* canonical path -> dir_entry */
+    bool        dirty;
+};
+
+
+static void
+_free_file_entry   (file_entry  *f)
+{
+    g_string_free (f->uni_path, TRUE);
+    g_free (f);
+}
+
+
+static void
+_free_dir_entry   (dir_entry   *d)
+{
+    if (d->names)
+        g_ptr_array_free (d->names, TRUE);
+    g_hash_table_destroy (d->files);
+    g_free (d);
+}
+
+
+static void
+_key_from_stat   (stat_key        *key,
+                  const GStatBuf  *st)
+{
+    key->dev   = (uint64_t) st->st_dev;
+    key->ino   = (uint64_t) st->st_ino;
+    key->size  = (uint64_t) st->st_size;
+    key->mtime = (int64_t)  st->st_mtime;
+}
+
+
+static bool
+_key_is_racy   (const GStatBuf  *st)
+{
+    return (int64_t) st->st_mtime >= g_get_real_time () / G_USEC_PER_SEC;
+}
+
+
+/* Same recycle bin may be specified with relative path in each run */
+static char *
+_canonical_path   (const char   *path)
+{
+    char *cwd, *result;
+
+    gsize len;
+
+    if (g_path_is_absolute (path))
+        result = g_strdup (path);
+    else
+    {
+        cwd = g_get_current_dir ();
+        result = g_build_filename (cwd, path, NULL);
+        g_free (cwd);
+    }
+
+    // Folder may be specified with trailing separator
+    len = strlen (result);
+    while (len > 1 && G_IS_DIR_SEPARATOR (result[len - 1]))
+        result[--len] = '\0';
+
+    return result;
+}
+
+
+/**
+ * @brief Split canonical path into folder and file name in place
+ * @param cpath Location of canonical path, which becomes folder path
+ * @return File name, which points inside `cpath`
+ */
+static char *
+_split_path   (char   **cpath)
+{
+    gsize len = strlen (*cpath), pos = len;
+
+    while (pos > 0 && ! G_IS_DIR_SEPARATOR ((*cpath)[pos - 1]))
+        pos--;
+
+    if (pos > 1)
+    {
+        (*cpath)[pos - 1] = '\0';
+        return *cpath + pos;
+    }
+
+    // Folder is root, whose separator must be kept
+    *cpath = g_realloc (*cpath, len + 2);
+    memmove (*cpath + pos + 1, *cpath + pos, len - pos + 1);
+    (*cpath)[pos] = '\0';
+    return *cpath + pos + 1;
+}
+
+
+/**
+ * @brief Find entry of folder, creating an empty one if absent
+ * @note Must be called with cache locked. Folder is not marked as
+ * visited, which is left to caller.
+ */
+static dir_entry *
+_get_dir   (rbin_cache   *c,
+            const char   *dir)
+{
+    dir_entry *d = g_hash_table_lookup (c->dirs, dir);
+
+    if (d == NULL)
+    {
+        d = g_malloc0 (sizeof (dir_entry));
+        d->files = g_hash_table_new_full (g_str_hash, g_str_equal,
+            g_free, (GDestroyNotify) _free_file_entry);
+        g_hash_table_insert (c->dirs, g_strdup (dir), d);
+    }
+    return d;
+}
+
+
+static void
+_parse_key   (char      **fields,
+              stat_key   *key,
+              bool        has_size)
+{
+    guint i = 1;
+
+    key->dev   = g_ascii_strtoull (fields[i++], NULL, 10);
+    key->ino   = g_ascii_strtoull (fields[i++], NULL, 10);
+    key->size  = has_size ? g_ascii_strtoull (fields[i++], NULL, 10) : 0;
+    key->mtime = g_ascii_strtoll  (fields[i++], NULL, 10);
+}
+
+
+/**
+ * @brief Load cache content, ignoring anything unrecognized
+ * @note Cache is merely an optimization, so broken cache file
+ * is treated like an empty one
+ */
+static void
+_load_cache   (rbin_cache   *c,
+               const char   *content)
+{
+    char      **lines;
+    dir_entry  *cur_dir = NULL;
+
+    lines = g_strsplit (content, "\n", -1);
+    if (lines[0] == NULL || strcmp (lines[0], CACHE_MAGIC) != 0)
+    {
+        g_debug ("Cache '%s' has unknown format, ignored", c->path);
+        g_strfreev (lines);
+        return;
+    }
+
+    for (guint i = 1; lines[i] != NULL; i++)
+    {
+        char  **fields = g_strsplit (lines[i], "\t", -1);
+        guint   n = g_strv_length (fields);
+
+        if (n == 5 && fields[0][0] == 'D')
+        {
+            char *dir = g_strcompress (fields[4]);
+
+            cur_dir = _get_dir (c, dir);
+            _parse_key (fields, &cur_dir->key, false);
+            if (cur_dir->names)
+                g_ptr_array_set_size (cur_dir->names, 0);
+            else
+                cur_dir->names = g_ptr_array_new_with_free_func (g_free);
+            g_free (dir);
+        }
+        else if (n == 2 && fields[0][0] == 'N' && cur_dir)
+            g_ptr_array_add (cur_dir->names, g_strcompress (fields[1]));
+        else if (n == 10 && fields[0][0] == 'F')
+        {
+            file_entry *f = g_malloc0 (sizeof (file_entry));
+            char       *cpath = g_strcompress (fields[9]);
+            char       *name = _split_path (&cpath);
+            guchar     *upath;
+            gsize       len;
+
+            _parse_key (fields, &f->key, true);
+            f->version     = g_ascii_strtoull (fields[5], NULL, 10);
+            f->filesize    = g_ascii_strtoull (fields[6], NULL, 10);
+            f->winfiletime = g_ascii_strtoll  (fields[7], NULL, 10);
+            upath = g_base64_decode (fields[8], &len);
+            f->uni_path = g_string_new_len ((const char *) upath, len);
+            g_free (upath);
+            g_hash_table_replace (_get_dir (c, cpath)->files,
+                g_strdup (name), f);
+            g_free (cpath);
+        }
+        g_strfreev (fields);
+    }
+    g_strfreev (lines);
+}
+
+
+/**
+ * @brief Open parse cache inside specified folder
+ * @param dir Folder storing cache file, created if not exist
+ * @param error Location to store error upon problem
+ * @return Cache handle, or `NULL` if folder can't be created
+ */
+rbin_cache *
+rbin_cache_open   (const char   *dir,
+                   GError      **error)
+{
+    rbin_cache *c;
+    char       *content = NULL;
+
+    g_return_val_if_fail (dir && *dir, NULL);
+
+    if (0 != g_mkdir_with_parents (dir, 0755))
+    {
+        int e = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (e),
+            _("Can not create cache folder: %s"), g_strerror (e));
+        return NULL;
+    }
+
+    c = g_malloc0 (sizeof (rbin_cache));
+    c->path = g_build_filename (dir, CACHE_FILE_NAME, NULL);
+    g_mutex_init (&c->lock);
+    c->dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, (GDestroyNotify) _free_dir_entry);
+
+    if (g_file_get_contents (c->path, &content, NULL, NULL))
+    {
+        _load_cache (c, content);
+        g_free (content);
+    }
+
+    return c;
+}
+
+
+static void
+_append_key   (GString          *s,
+               char              type,
+               const stat_key   *key,
+               bool              has_size)
+{
+    g_string_append_printf (s, "%c\t%" PRIu64 "\t%" PRIu64 "\t",
+        type, key->dev, key->ino);
+    if (has_size)
+        g_string_append_printf (s, "%" PRIu64 "\t", key->size);
+    g_string_append_printf (s, "%" PRId64 "\t", key->mtime);
+}
+
+
+static void
+_append_escaped   (GString      *s,
+                   const char   *str)
+{
+    char *e = g_strescape (str, NULL);
+    s = g_string_append (s, e);
+    g_free (e);
+}
+
+
+/**
+ * @brief Drop folders not visited in current run which are gone
+ * @note Folders merely not visited are kept, as they may belong to
+ * recycle bins checked in other runs
+ */
+static void
+_prune_dirs   (rbin_cache   *c)
+{
+    GHashTableIter  iter;
+    gpointer        key, val;
+
+    g_hash_table_iter_init (&iter, c->dirs);
+    while (g_hash_table_iter_next (&iter, &key, &val))
+    {
+        if (((dir_entry *) val)->seen || g_file_test (key, G_FILE_TEST_IS_DIR))
+            continue;
+        g_debug ("Folder '%s' is gone, dropped from cache", (char *) key);
+        g_hash_table_iter_remove (&iter);
+        c->dirty = true;
+    }
+}
+
+
+/**
+ * @brief Write cache back to disk if modified, and free it
+ * @param c The cache, can be `NULL`
+ * @param error Location to store error upon problem
+ * @return `true` if cache is saved or unchanged, `false` otherwise
+ */
+bool
+rbin_cache_close   (rbin_cache   *c,
+                    GError      **error)
+{
+    GHashTableIter  iter;
+    gpointer        key, val;
+    GString        *s;
+    bool            ret = true;
+
+    if (c == NULL)
+        return true;
+
+    _prune_dirs (c);
+
+    if (c->dirty)
+    {
+        s = g_string_new (CACHE_MAGIC "\n");
+
+        g_hash_table_iter_init (&iter, c->dirs);
+        while (g_hash_table_iter_next (&iter, &key, &val))
+        {
+            dir_entry      *d = val;
+            GHashTableIter  fiter;
+            gpointer        name, fval;
+
+            if (d->names)
+            {
+                _append_key (s, 'D', &d->key, false);
+                _append_escaped (s, key);
+                s = g_string_append_c (s, '\n');
+                for (guint i = 0; i < d->names->len; i++)
+                {
+                    s = g_string_append (s, "N\t");
+                    _append_escaped (s, d->names->pdata[i]);
+                    s = g_string_append_c (s, '\n');
+                }
+            }
+
+            g_hash_table_iter_init (&fiter, d->files);
+            while (g_hash_table_iter_next (&fiter, &name, &fval))
+            {
+                file_entry *f = fval;
+                char       *upath, *path;
+
+                _append_key (s, 'F', &f->key, true);
+                upath = g_base64_encode ((const guchar *) f->uni_path->str,
+                    f->uni_path->len);
+                g_string_append_printf (s, "%" PRIu64 "\t%" PRIu64 "\t%"
+                    PRId64 "\t%s\t", f->version, f->filesize,
+                    f->winfiletime, upath);
+                g_free (upath);
+                path = g_build_filename (key, name, NULL);
+                _append_escaped (s, path);
+                g_free (path);
+                s = g_string_append_c (s, '\n');
+            }
+        }
+
+        ret = g_file_set_contents (c->path, s->str, s->len, error);
+        g_string_free (s, TRUE);
+    }
+
+    rbin_cache_free (c);
+    return ret;
+}
+
+
+/**
+ * @brief Free cache without writing it back to disk
+ * @param c The cache, can be `NULL`
+ * @note For processes not owning the cache file, whose changes
+ * would otherwise overwrite those of its owner
+ */
+void
+rbin_cache_free   (rbin_cache   *c)
+{
+    if (c == NULL)
+        return;
+
+    g_hash_table_destroy (c->dirs);
+    g_mutex_clear (&c->lock);
+    g_free (c->path);
+    g_free (c);
+}
+
+
+/**
+ * @brief Fetch index file names of unchanged folder
+ * @param c The cache, can be `NULL`
+ * @param path The folder
+ * @param st Current folder status
+ * @return Newly allocated list of file names, or `NULL` if folder
+ * is not cached or has changed since
+ */
+GPtrArray *
+rbin_cache_lookup_dir   (rbin_cache       *c,
+                         const char       *path,
+                         const GStatBuf   *st)
+{
+    char       *cpath;
+    dir_entry  *d;
+    stat_key    key;
+    GPtrArray  *result = NULL;
+
+    if (c == NULL)
+        return NULL;
+
+    _key_from_stat (&key, st);
+    cpath = _canonical_path (path);
+
+    g_mutex_lock (&c->lock);
+    d = g_hash_table_lookup (c->dirs, cpath);
+    if (d)
+        d->seen = true;
+    if (d && d->names && d->key.dev == key.dev && d->key.ino == key.ino &&
+        d->key.mtime == key.mtime)
+    {
+        result = g_ptr_array_new_full (d->names->len, g_free);
+        for (guint i = 0; i < d->names->len; i++)
+            g_ptr_array_add (result, g_strdup (d->names->pdata[i]));
+    }
+    g_mutex_unlock (&c->lock);
+
+    g_free (cpath);
+    return result;
+}
+
+
+/**
+ * @brief Remember index file names of folder
+ * @param c The cache, can be `NULL`
+ * @param path The folder
+ * @param st Folder status obtained before folder is scanned
+ * @param names Index file names found in folder
+ * @note Entries of index files no more in folder are dropped as well
+ */
+void
+rbin_cache_store_dir   (rbin_cache        *c,
+                        const char        *path,
+                        const GStatBuf    *st,
+                        const GPtrArray   *names)
+{
+    char           *cpath;
+    dir_entry      *d;
+    GPtrArray      *copy;
+    GHashTable     *wanted;
+    GHashTableIter  iter;
+    gpointer        key;
+
+    if (c == NULL || _key_is_racy (st))
+        return;
+
+    cpath = _canonical_path (path);
+    copy = g_ptr_array_new_full (names->len, g_free);
+    wanted = g_hash_table_new (g_str_hash, g_str_equal);
+    for (guint i = 0; i < names->len; i++)
+    {
+        g_ptr_array_add (copy, g_strdup (names->pdata[i]));
+        g_hash_table_add (wanted, copy->pdata[i]);
+    }
+
+    g_mutex_lock (&c->lock);
+
+    d = _get_dir (c, cpath);
+    d->seen = true;
+    _key_from_stat (&d->key, st);
+    if (d->names)
+        g_ptr_array_free (d->names, TRUE);
+    d->names = copy;
+
+    g_hash_table_iter_init (&iter, d->files);
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+        if (! g_hash_table_contains (wanted, key))
+            g_hash_table_iter_remove (&iter);
+
+    c->dirty = true;
+    g_mutex_unlock (&c->lock);
+
+    g_hash_table_destroy (wanted);
+    g_free (cpath);
+}
+
+
+/**
+ * @brief Fetch parsed record of unchanged index file
+ * @param c The cache, can be `NULL`
+ * @param path The index file
+ * @param st Current file status
+ * @return Newly allocated record without index and file status,
+ * or `NULL` if index file is not cached or has changed since
+ */
+rbin_struct *
+rbin_cache_lookup   (rbin_cache       *c,
+                     const char       *path,
+                     const GStatBuf   *st)
+{
+    char         *cpath, *name;
+    dir_entry    *d;
+    file_entry   *f = NULL;
+    stat_key      key;
+    rbin_struct  *record = NULL;
+
+    if (c == NULL)
+        return NULL;
+
+    _key_from_stat (&key, st);
+    cpath = _canonical_path (path);
+    name = _split_path (&cpath);
+
+    g_mutex_lock (&c->lock);
+    if (NULL != (d = g_hash_table_lookup (c->dirs, cpath)))
+    {
+        d->seen = true;
+        f = g_hash_table_lookup (d->files, name);
+    }
+    if (f && f->key.dev == key.dev && f->key.ino == key.ino &&
+        f->key.size == key.size && f->key.mtime == key.mtime)
+    {
+        record = g_malloc0 (sizeof (rbin_struct));
+        record->version     = f->version;
+        record->filesize    = f->filesize;
+        record->winfiletime = f->winfiletime;
+        record->deltime     = win_filetime_to_gdatetime (f->winfiletime);
+        record->raw_uni_path = g_string_new_len (f->uni_path->str,
+            f->uni_path->len);
+    }
+    g_mutex_unlock (&c->lock);
+
+    g_free (cpath);
+    return record;
+}
+
+
+/**
+ * @brief Remember parsed record of index file
+ * @param c The cache, can be `NULL`
+ * @param path The index file
+ * @param st File status obtained before file is read
+ * @param record The parsed record
+ * @note Records with any error are not stored, so that
+ * the error is reported each time
+ */
+void
+rbin_cache_store   (rbin_cache          *c,
+                    const char          *path,
+                    const GStatBuf      *st,
+                    const rbin_struct   *record)
+{
+    file_entry *f;
+    dir_entry  *d;
+    char       *cpath, *name;
+
+    if (c == NULL || record->error || _key_is_racy (st))
+        return;
+
+    f = g_malloc0 (sizeof (file_entry));
+    _key_from_stat (&f->key, st);
+    f->version     = record->version;
+    f->filesize    = record->filesize;
+    f->winfiletime = record->winfiletime;
+    f->uni_path    = g_string_new_len (record->raw_uni_path->str,
+        record->raw_uni_path->len);
+
+    cpath = _canonical_path (path);
+    name = _split_path (&cpath);
+
+    g_mutex_lock (&c->lock);
+    d = _get_dir (c, cpath);
+    d->seen = true;
+    g_hash_table_replace (d->files, g_strdup (name), f);
+    c->dirty = true;
+    g_mutex_unlock (&c->lock);
+
+    g_free (cpath);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "utils.h"
+
+typedef struct _rbin_cache rbin_cache;
+
+rbin_cache *      rbin_cache_open            (const char        *dir,
+                                              GError           **error);
+bool              rbin_cache_close           (rbin_cache        *c,
+                                              GError           **error);
+void              rbin_cache_free            (rbin_cache        *c);
+GPtrArray *       rbin_cache_lookup_dir      (rbin_cache        *c,
+                                              const char        *path,
+                                              const GStatBuf    *st);
+void              rbin_cache_store_dir       (rbin_cache        *c,
+                                              const char        *path,
+                                              const GStatBuf    *st,
+                                              const GPtrArray   *names);
+rbin_struct *     rbin_cache_lookup          (rbin_cache        *c,
+                                              const char        *path,
+                                              const GStatBuf    *st);
+void              rbin_cache_store           (rbin_cache        *c,
+                                              const char        *path,
+                                              const GStatBuf    *st,
+                                              const rbin_struct *record);
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Carving of recycle bin records from raw disk image or memory dump.
+ * Image is memory mapped and split into chunks, which are scanned
+ * in parallel. Scanning routine may read up to CARVE_OVERLAP bytes
+ * beyond chunk end, so that a record crossing chunk boundary is
+ * found exactly once, by the chunk where it starts.
+ */
+
+#include <errno.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "utils-carve.h"
+#include "utils-progress.h"
+
+/* Image size handled by each worker at a time */
+#define CARVE_CHUNK_SIZE    (64 * 1024 * 1024)
+
+typedef struct _carve_ctx
+{
+    CarveScanFunc  func;
+    gpointer       user_data;
+} carve_ctx;
+
+
+static void
+_scan_chunk   (carve_chunk  *chunk,
+               carve_ctx    *ctx)
+{
+    ctx->func (chunk, ctx->user_data);
+    progress_add (PROGRESS_RECORDS, chunk->found->len);
+    progress_add (PROGRESS_BYTES_DONE, chunk->len);
+}
+
+
+/**
+ * @brief Check if data looks like start of a Windows path
+ * @param p Start of path
+ * @param maxchars Maximum number of characters, including NUL
+ * @param utf16 Whether path is in UTF-16, or in ANSI code page
+ * @return `true` if path begins with drive letter or UNC prefix,
+ * and is terminated within `maxchars` characters
+ * @note First character is allowed to be NUL for ANSI path, since
+ * `INFO2` removes drive letter of entries no more in recycle bin
+ */
+bool
+carve_path_is_plausible   (const guint8  *p,
+                           gsize          maxchars,
+                           bool           utf16)
+{
+    gsize w = utf16 ? 2 : 1;
+
+    if (utf16 && (p[1] || p[3] || p[5]))
+        return false;
+
+    if (! ((g_ascii_isalpha (p[0]) || (! utf16 && ! p[0])) &&
+           p[w] == ':' && p[2 * w] == '\\') &&
+        ! ((p[0] == '\\' || (! utf16 && ! p[0])) && p[w] == '\\'))
+        return false;
+
+    for (gsize i = 3; i < maxchars; i++)
+        if (p[i * w] == 0 && p[i * w + w - 1] == 0)
+            return true;
+
+    return false;
+}
+
+
+/**
+ * @brief Scan whole image for records on all processors
+ * @param path Path of image file
+ * @param func Routine scanning single chunk of image
+ * @param user_data Data passed to `func`
+ * @param results Array to append carved records to, in order of
+ * their position inside image
+ * @param error Location to store error upon problem
+ * @return `true` if image is scanned, `false` if it can't be mapped
+ * @note Only regular files are accepted. Devices are rejected, since
+ * their size is not reported by `stat()` and nothing would be mapped.
+ */
+bool
+carve_image   (const char     *path,
+               CarveScanFunc   func,
+               gpointer        user_data,
+               GPtrArray      *results,
+               GError        **error)
+{
+    carve_ctx     ctx = { .func = func, .user_data = user_data };
+    GMappedFile  *mf;
+    const guint8 *data;
+    gsize         len, n_chunks;
+    carve_chunk  *chunks;
+    GThreadPool  *pool;
+    GStatBuf      st;
+
+    g_return_val_if_fail (path && *path, false);
+    g_return_val_if_fail (func != NULL, false);
+    g_return_val_if_fail (results != NULL, false);
+
+    if (0 != g_stat (path, &st))
+    {
+        int e = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (e),
+            _("Can not access '%s': %s"), path, g_strerror (e));
+        return false;
+    }
+    if (! S_ISREG (st.st_mode))
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+            _("'%s' is not a regular file; copy device content "
+              "to an image file before carving"), path);
+        return false;
+    }
+
+    if (NULL == (mf = g_mapped_file_new (path, FALSE, error)))
+        return false;
+
+    len = g_mapped_file_get_length (mf);
+    data = (const guint8 *) g_mapped_file_get_contents (mf);
+    n_chunks = (len + CARVE_CHUNK_SIZE - 1) / CARVE_CHUNK_SIZE;
+    chunks = g_new0 (carve_chunk, n_chunks);
+    progress_add (PROGRESS_BYTES_TOTAL, len);
+
+    pool = g_thread_pool_new ((GFunc) _scan_chunk, &ctx,
+        (gint) g_get_num_processors (), FALSE, NULL);
+
+    for (gsize i = 0; i < n_chunks; i++)
+    {
+        gsize off = i * CARVE_CHUNK_SIZE;
+
+        chunks[i].data   = data + off;
+        chunks[i].len    = MIN (len - off, CARVE_CHUNK_SIZE);
+        chunks[i].avail  = MIN (len - off, CARVE_CHUNK_SIZE + CARVE_OVERLAP);
+        chunks[i].offset = off;
+        chunks[i].found  = g_ptr_array_new ();
+        g_thread_pool_push (pool, &chunks[i], NULL);
+    }
+
+    // Wait for all chunks
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+    for (gsize i = 0; i < n_chunks; i++)
+    {
+        for (guint j = 0; j < chunks[i].found->len; j++)
+            g_ptr_array_add (results, chunks[i].found->pdata[j]);
+        g_ptr_array_free (chunks[i].found, TRUE);
+    }
+
+    g_free (chunks);
+    g_mapped_file_unref (mf);
+    return true;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <glib.h>
+
+/*
+ * Bytes readable beyond end of each chunk, which must be no less
+ * than the largest record being carved
+ */
+#define CARVE_OVERLAP       (128 * 1024)
+
+/**
+ * @brief Portion of image scanned by a single worker
+ */
+typedef struct _carve_chunk
+{
+    const guint8  *data;    /* start of chunk */
+    gsize          len;     /* records must start within this range */
+    gsize          avail;   /* readable bytes, including overlap */
+    guint64        offset;  /* position of chunk inside image */
+    GPtrArray     *found;   /* records carved from this chunk */
+} carve_chunk;
+
+typedef void (*CarveScanFunc)                 (carve_chunk      *chunk,
+                                               gpointer          user_data);
+
+bool              carve_path_is_plausible    (const guint8     *p,
+                                              gsize             maxchars,
+                                              bool              utf16);
+bool              carve_image                (const char       *path,
+                                              CarveScanFunc     func,
+                                              gpointer          user_data,
+                                              GPtrArray        *results,
+                                              GError          **error);
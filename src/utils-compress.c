@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Streaming compression of output, done in a separate thread so that
+ * formatting of records and compression can overlap. Output buffer
+ * content is handed over by swapping string buffers, thus at most
+ * one buffer is being formatted while another one is compressed.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gi18n.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "utils-compress.h"
+
+/* Size of compressed data written each time */
+#define COMPRESS_OUT_SIZE       (64 * 1024)
+
+struct _compressor
+{
+    compress_type  type;
+    FILE          *fh;
+    GThread       *thread;
+    GMutex         lock;
+    GCond          cond;
+    GString       *input;      /* only touched by worker if has_input */
+    bool           has_input;
+    bool           finishing;
+    GError        *error;      /* first problem found by worker */
+    guint8        *outbuf;
+#ifdef HAVE_ZLIB
+    z_stream       zs;
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx     *zctx;
+#endif
+};
+
+
+/**
+ * @brief Check if compression method is available in this build
+ * @param type Compression method
+ * @param error Location to store error if unsupported
+ * @return `true` if supported, `false` otherwise
+ */
+bool
+compress_type_supported   (compress_type   type,
+                           GError        **error)
+{
+    switch (type)
+    {
+        case COMPRESS_NONE:
+            return true;
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZIP:
+            return true;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD:
+            return true;
+#endif
+        default:
+            break;
+    }
+
+    g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+        _("%s compression is not supported in this build"),
+        (type == COMPRESS_GZIP) ? "gzip" : "zstd");
+    return false;
+}
+
+
+static bool
+_write_compressed   (compressor  *c,
+                     gsize        len)
+{
+    if (len == 0 || fwrite (c->outbuf, 1, len, c->fh) == len)
+        return true;
+
+    int e = errno;
+    g_set_error (&c->error, G_FILE_ERROR, g_file_error_from_errno (e),
+        _("Failed to write compressed output: %s"), g_strerror (e));
+    return false;
+}
+
+
+#ifdef HAVE_ZLIB
+static bool
+_gzip_chunk   (compressor   *c,
+               const char   *data,
+               gsize         len,
+               bool          end)
+{
+    z_stream *zs = &c->zs;
+
+    zs->next_in  = (Bytef *) data;
+    zs->avail_in = (uInt) len;
+
+    do
+    {
+        zs->next_out  = c->outbuf;
+        zs->avail_out = COMPRESS_OUT_SIZE;
+
+        if (Z_STREAM_ERROR == deflate (zs, end ? Z_FINISH : Z_NO_FLUSH))
+        {
+            g_set_error (&c->error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                _("Failed to compress output: %s"), zs->msg);
+            return false;
+        }
+        if (! _write_compressed (c, COMPRESS_OUT_SIZE - zs->avail_out))
+            return false;
+    }
+    while (zs->avail_out == 0);
+
+    return true;
+}
+#endif
+
+
+#ifdef HAVE_ZSTD
+static bool
+_zstd_chunk   (compressor   *c,
+               const char   *data,
+               gsize         len,
+               bool          end)
+{
+    ZSTD_inBuffer  in = { data, len, 0 };
+    size_t         remaining;
+
+    do
+    {
+        ZSTD_outBuffer out = { c->outbuf, COMPRESS_OUT_SIZE, 0 };
+
+        remaining = ZSTD_compressStream2 (c->zctx, &out, &in,
+            end ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError (remaining))
+        {
+            g_set_error (&c->error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                _("Failed to compress output: %s"),
+                ZSTD_getErrorName (remaining));
+            return false;
+        }
+        if (! _write_compressed (c, out.pos))
+            return false;
+    }
+    while (end ? (remaining != 0) : (in.pos < in.size));
+
+    return true;
+}
+#endif
+
+
+static void
+_compress_chunk   (compressor   *c,
+                   const char   *data,
+                   gsize         len,
+                   bool          end)
+{
+    switch (c->type)
+    {
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZIP:
+            _gzip_chunk (c, data, len, end);
+            break;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD:
+            _zstd_chunk (c, data, len, end);
+            break;
+#endif
+        default:
+            g_assert_not_reached ();
+    }
+}
+
+
+static gpointer
+_compress_thread   (gpointer   data)
+{
+    compressor  *c = data;
+    bool         end = false;
+
+    while (! end)
+    {
+        g_mutex_lock (&c->lock);
+        while (! c->has_input && ! c->finishing)
+            g_cond_wait (&c->cond, &c->lock);
+        end = ! c->has_input;
+        g_mutex_unlock (&c->lock);
+
+        // After a failure, input is still consumed but discarded,
+        // so that main thread never blocks forever
+        if (c->error == NULL)
+            _compress_chunk (c, c->input->str, c->input->len, end);
+
+        g_mutex_lock (&c->lock);
+        g_string_truncate (c->input, 0);
+        c->has_input = false;
+        g_cond_signal (&c->cond);
+        g_mutex_unlock (&c->lock);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Start compressing output in background thread
+ * @param type Compression method, must be supported
+ * @param fh File handle where compressed data is written to
+ * @param error Location to store error upon problem
+ * @return Newly created compressor, or `NULL` upon failure
+ */
+compressor *
+compressor_new   (compress_type   type,
+                  FILE           *fh,
+                  GError        **error)
+{
+    compressor *c;
+
+    g_return_val_if_fail (fh != NULL, NULL);
+    g_return_val_if_fail (compress_type_supported (type, NULL), NULL);
+
+    c = g_malloc0 (sizeof (compressor));
+    c->type = type;
+    c->fh = fh;
+
+    switch (type)
+    {
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZIP:
+            // Window bits + 16 writes gzip header instead of zlib one
+            if (Z_OK != deflateInit2 (&c->zs, Z_DEFAULT_COMPRESSION,
+                Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY))
+            {
+                g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                    _("Failed to initialize gzip compression"));
+                g_free (c);
+                return NULL;
+            }
+            break;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD:
+            if (NULL == (c->zctx = ZSTD_createCCtx ()))
+            {
+                g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                    _("Failed to initialize zstd compression"));
+                g_free (c);
+                return NULL;
+            }
+            break;
+#endif
+        default:
+            g_assert_not_reached ();
+    }
+
+    c->outbuf = g_malloc (COMPRESS_OUT_SIZE);
+    c->input = g_string_new (NULL);
+    g_mutex_init (&c->lock);
+    g_cond_init (&c->cond);
+    c->thread = g_thread_new ("compress", _compress_thread, c);
+
+    return c;
+}
+
+
+/**
+ * @brief Hand over buffer content for compression
+ * @param c The compressor
+ * @param buf Buffer holding data to be compressed, which is
+ * emptied afterwards
+ * @note Blocks until previous buffer is fully compressed. No data
+ * is copied; the buffer is swapped with the one used by compressor.
+ */
+void
+compressor_push   (compressor   *c,
+                   GString      *buf)
+{
+    GString tmp;
+
+    g_return_if_fail (c != NULL);
+    g_return_if_fail (buf != NULL);
+
+    if (buf->len == 0)
+        return;
+
+    g_mutex_lock (&c->lock);
+    while (c->has_input)
+        g_cond_wait (&c->cond, &c->lock);
+
+    tmp = *c->input;
+    *c->input = *buf;
+    *buf = tmp;
+
+    c->has_input = true;
+    g_cond_signal (&c->cond);
+    g_mutex_unlock (&c->lock);
+}
+
+
+/**
+ * @brief Compress remaining data, end compressed stream
+ * and free the compressor
+ * @param c The compressor
+ * @param error Location to store error upon problem
+ * @return `true` if all data is compressed and written successfully
+ */
+bool
+compressor_finish   (compressor   *c,
+                     GError      **error)
+{
+    bool ret;
+
+    g_return_val_if_fail (c != NULL, false);
+
+    g_mutex_lock (&c->lock);
+    c->finishing = true;
+    g_cond_signal (&c->cond);
+    g_mutex_unlock (&c->lock);
+    g_thread_join (c->thread);
+
+    switch (c->type)
+    {
+#ifdef HAVE_ZLIB
+        case COMPRESS_GZIP:
+            deflateEnd (&c->zs);
+            break;
+#endif
+#ifdef HAVE_ZSTD
+        case COMPRESS_ZSTD:
+            ZSTD_freeCCtx (c->zctx);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    if (c->error == NULL && fflush (c->fh) != 0)
+    {
+        int e = errno;
+        g_set_error (&c->error, G_FILE_ERROR, g_file_error_from_errno (e),
+            _("Failed to write compressed output: %s"), g_strerror (e));
+    }
+
+    ret = (c->error == NULL);
+    if (! ret)
+        g_propagate_error (error, c->error);
+
+    g_mutex_clear (&c->lock);
+    g_cond_clear (&c->cond);
+    g_string_free (c->input, TRUE);
+    g_free (c->outbuf);
+    g_free (c);
+
+    return ret;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <glib.h>
+
+typedef enum
+{
+    COMPRESS_NONE = 0,
+    COMPRESS_GZIP,
+    COMPRESS_ZSTD,
+} compress_type;
+
+typedef struct _compressor compressor;
+
+bool              compress_type_supported    (compress_type      type,
+                                              GError           **error);
+compressor *      compressor_new             (compress_type      type,
+                                              FILE              *fh,
+                                              GError           **error);
+void              compressor_push            (compressor        *c,
+                                              GString           *buf);
+bool              compressor_finish          (compressor        *c,
+                                              GError           **error);
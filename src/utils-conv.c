@@ -9,6 +9,7 @@
 #include <glib.h>
 #include <glib/gi18n.h>
 
+#include "utils-debug.h"
 #include "utils-error.h"
 #include "utils-conv.h"
 
@@ -17,11 +18,13 @@ struct _fmt_data fmt[] = {
     // must match out_fmt enum order
     {
         .friendly_name = "TSV format",
+        .file_ext      = "txt",
         .fallback_tmpl = {"<\\u%04X>", "<\\%02X>", "<\\u%04X>"},
         .gone_outtext  = {"???", "FALSE", "TRUE"},
     },
     {
         .friendly_name = "XML format",
+        .file_ext      = "xml",
         // All paths are placed inside CDATA, using entities
         // can be confusing
         .fallback_tmpl = {"<\\u%04X>", "<\\%02X>", "<\\u%04X>"},
@@ -29,6 +32,7 @@ struct _fmt_data fmt[] = {
     },
     {
         .friendly_name = "JSON format",
+        .file_ext      = "json",
         .fallback_tmpl = {
             "",  // Unused, see json_escape()
             // JSON doesn't allow encoding raw byte data in strings
@@ -41,9 +45,41 @@ struct _fmt_data fmt[] = {
         },
         .gone_outtext  = {"null", "false", "true"},
     },
+    {
+        // One JSON object per line; shares everything with JSON
+        .friendly_name = "JSON Lines format",
+        .file_ext      = "jsonl",
+        .fallback_tmpl = {"", "<\\%02X>", "*u%04X"},
+        .gone_outtext  = {"null", "false", "true"},
+    },
+    {
+        // Binary columnar output, only path strings use templates
+        .friendly_name = "Arrow IPC format",
+        .file_ext      = "arrows",
+        .fallback_tmpl = {"<\\u%04X>", "<\\%02X>", "<\\u%04X>"},
+        .gone_outtext  = {"null", "false", "true"},
+    },
+    {
+        // Gone status is stored as integer, only path uses templates
+        .friendly_name = "SQLite database",
+        .file_ext      = "db",
+        .fallback_tmpl = {"<\\u%04X>", "<\\%02X>", "<\\u%04X>"},
+        .gone_outtext  = {"NULL", "0", "1"},
+    },
 };
 
 
+/* Reused across path conversions, see conv_path_to_utf8_with_tmpl() */
+static GIConv       unicode_conv       = (GIConv) -1;
+static GIConv       legacy_conv        = (GIConv) -1;
+static char        *legacy_conv_enc    = NULL;
+static GString     *conv_buf           = NULL;
+static GArray      *err_offsets        = NULL;
+
+static bool         stats_on           = false;
+static conv_stats   stats              = { 0 };
+
+
 /**
  * @brief Try out if encoding is compatible to ASCII
  * @param enc The encoding to test
@@ -111,6 +147,77 @@ ucs2_bytelen   (const char   *str,
 }
 
 
+/**
+ * @brief Append a single number formatted with fallback template
+ * @param s The `GString` to append to
+ * @param tmpl A template in `fmt[]`, see `_fmt_data` for detail
+ * @param c The number to be formatted
+ * @note Only handles the tiny subset of `printf` directives used by
+ * fallback templates (optional zero padding and width, followed by
+ * one of `%u`, `%o`, `%d`, `%i`, `%x` or `%X`), but never allocates
+ * temporary strings like `g_string_append_printf()` does.
+ */
+static void
+_append_tmpl   (GString      *s,
+                const char   *tmpl,
+                unsigned int  c)
+{
+    const char *p = tmpl;
+    const char *digits;
+    char        buf[16];
+    unsigned    base, width;
+    int         n;
+    bool        zero_pad;
+
+    while (*p)
+    {
+        if (*p != '%')
+        {
+            s = g_string_append_c (s, *p++);
+            continue;
+        }
+
+        if (*(++p) == '%')
+        {
+            s = g_string_append_c (s, *p++);
+            continue;
+        }
+
+        zero_pad = (*p == '0');
+        if (zero_pad)
+            p++;
+
+        width = 0;
+        while (g_ascii_isdigit (*p))
+            width = width * 10 + (unsigned) (*p++ - '0');
+
+        digits = "0123456789abcdef";
+        switch (*p)
+        {
+            case 'X': digits = "0123456789ABCDEF";  /* fall through */
+            case 'x': base = 16; break;
+            case 'o': base =  8; break;
+            default : base = 10; break;
+        }
+        if (*p)
+            p++;
+
+        n = 0;
+        do
+        {
+            buf[n++] = digits[c % base];
+            c /= base;
+        }
+        while (c);
+
+        for (unsigned i = (unsigned) n; i < width; i++)
+            s = g_string_append_c (s, zero_pad ? '0' : ' ');
+        while (n)
+            s = g_string_append_c (s, buf[--n]);
+    }
+}
+
+
 /**
  * @brief Move character pointer for specified bytes
  * @param sz Must be either 1 or 2, denoting broken byte or broken UCS2 character
@@ -142,8 +249,7 @@ _advance_octet    (size_t       sz,
     else
         c = GUINT16_FROM_LE (*(uint16_t *) (*ptr));
 
-    g_string_append_printf (s,
-        fmt[fmt_type].fallback_tmpl[sz], c);
+    _append_tmpl (s, fmt[fmt_type].fallback_tmpl[sz], c);
 
     *ptr += sz;
     *bytes_left -= sz;
@@ -153,22 +259,21 @@ _advance_octet    (size_t       sz,
 
 /**
  * @brief Convert non-printable characters to escape sequences
+ * @param dest The `GString` where converted string is appended
  * @param str The original string to be converted
  * @param fmt_type Type of output format; see `fmt[]` for detail
- * @return Converted string, maybe containing escape sequences
  * @attention Caller is responsible for using correct template, no
  * error checking is performed. This template should handle a single
  * Windows unicode path character, which is in UTF-16LE encoding.
  */
-static char *
-_filter_printable_char   (const char   *str,
-                          out_fmt       fmt_type)
+void
+filter_printable_char   (GString      *dest,
+                         const char   *str,
+                         out_fmt       fmt_type)
 {
     char     *p, *np;
     gunichar  c;
-    GString  *s;
 
-    s = g_string_sized_new (strlen (str) * 2);
     p = (char *) str;
     while (*p)
     {
@@ -178,14 +283,109 @@ _filter_printable_char   (const char   *str,
         // ASCII space is common (e.g. "Program Files"), but not
         // for any other kinds of space or invisible char
         if (g_unichar_isgraph (c) || (c == 0x20))
-            s = g_string_append_len (s, p, (size_t) (np - p));
+            dest = g_string_append_len (dest, p, (size_t) (np - p));
         else
-            g_string_append_printf (s, fmt[fmt_type].fallback_tmpl[0], c);
+            _append_tmpl (dest, fmt[fmt_type].fallback_tmpl[0], c);
 
         p = np;
     }
+}
+
+
+/**
+ * @brief Fetch cached converter for path conversion
+ * @param from_enc Legacy Windows ANSI encoding, or `NULL` for
+ * Windows wide char encoding (UTF-16LE)
+ * @return Converter with its shift state reset
+ * @note Opening iconv descriptor is costly, and only 2 encodings at
+ * most are involved during the whole program run, so converters are
+ * kept around until `free_conv_cache()` is called.
+ */
+static GIConv
+_get_conv   (const char   *from_enc)
+{
+    GIConv *conv = from_enc ? &legacy_conv : &unicode_conv;
+
+    if (from_enc && g_strcmp0 (from_enc, legacy_conv_enc) != 0)
+    {
+        if (legacy_conv != (GIConv) -1)
+            g_iconv_close (legacy_conv);
+        legacy_conv = (GIConv) -1;
+        g_free (legacy_conv_enc);
+        legacy_conv_enc = g_strdup (from_enc);
+    }
+
+    // Shouldn't fail, encoding already tested upon start of prog
+    if (*conv == (GIConv) -1)
+        *conv = g_iconv_open ("UTF-8", from_enc ? from_enc : "UTF-16LE");
+    else
+        g_iconv (*conv, NULL, NULL, NULL, NULL);
+
+    return *conv;
+}
+
+
+/**
+ * @brief Open path converters in advance
+ * @param legacy_enc Legacy Windows ANSI encoding to be prepared
+ * as well, or `NULL`
+ * @note For resident process, so that later processing starts
+ * with converters ready
+ */
+void
+preload_conv_cache   (const char   *legacy_enc)
+{
+    _get_conv (NULL);
+    if (legacy_enc)
+        _get_conv (legacy_enc);
+}
+
+
+/**
+ * @brief Free converters and buffers kept for path conversion
+ */
+void
+free_conv_cache   (void)
+{
+    if (unicode_conv != (GIConv) -1)
+        g_iconv_close (unicode_conv);
+    if (legacy_conv != (GIConv) -1)
+        g_iconv_close (legacy_conv);
+    unicode_conv = legacy_conv = (GIConv) -1;
 
-    return g_string_free (s, FALSE);
+    g_clear_pointer (&legacy_conv_enc, g_free);
+
+    if (conv_buf)
+        g_string_free (conv_buf, TRUE);
+    conv_buf = NULL;
+
+    if (err_offsets)
+        g_array_free (err_offsets, TRUE);
+    err_offsets = NULL;
+}
+
+
+/**
+ * @brief Start counting path conversions and time spent on them
+ * @note Conversion only happens on main thread during output,
+ * so counters are not protected from concurrent access
+ */
+void
+enable_conv_stats   (void)
+{
+    stats_on = true;
+}
+
+
+/**
+ * @brief Fetch path conversion counters
+ * @return Counters, which are all zero unless `enable_conv_stats()`
+ * was called
+ */
+const conv_stats *
+get_conv_stats   (void)
+{
+    return &stats;
 }
 
 
@@ -216,41 +416,50 @@ _sync_pos   (GString   *str,
  * @param fmt_type Type of output format; see `fmt[]` for detail
  * @param func String transform func for post processing; can be
  * `NULL`, which still does some internal filtering
+ * @param dest The `GString` where UTF-8 encoded path is appended
  * @param error Location to store error upon problem
- * @return UTF-8 encoded path, or `NULL` if conversion error happens
+ * @return `true` on success, `false` if conversion error happens,
+ * in which case `dest` is left untouched
  * @note This is very similar to `g_convert_with_fallback()`, but the
  * fallback is a `printf`-style string instead of a fixed string,
  * so that different fallback sequence can be used with various output
  * format.
+ * @note Converters and intermediate buffers are reused between calls,
+ * so that no heap allocation happens for each converted path in
+ * usual case.
  * @attention 1. This routine is not for generic charset conversion.
  * Extra transformation is intended for path display only.
  * @attention 1. Caller is responsible for using correct template,
  * no error checking is performed.
  */
-char *
+bool
 conv_path_to_utf8_with_tmpl (const GString   *path,
                              const char      *from_enc,
                              out_fmt          fmt_type,
                              StrTransformFunc func,
+                             GString         *dest,
                              GError         **error)
 {
     char            *i_ptr,
-                    *o_ptr,
-                    *result;
+                    *o_ptr;
     gsize            i_size,
                      i_left,
                      o_left,
                      char_sz,
-                     status;
+                     status = 0;
     GIConv           conv;
-    GPtrArray       *err_offsets;
     GString         *s;
+    gint64           start = 0;
 
     // For unicode path, the first char must be ASCII drive letter
     // or slash. And since it is in little endian, first byte is
     // always non-null
-    g_return_val_if_fail (path != NULL, NULL);
-    g_return_val_if_fail (! from_enc || *from_enc, NULL);
+    g_return_val_if_fail (path != NULL, false);
+    g_return_val_if_fail (dest != NULL, false);
+    g_return_val_if_fail (! from_enc || *from_enc, false);
+
+    if (stats_on)
+        start = g_get_monotonic_time ();
 
     if (from_enc)
     {
@@ -264,16 +473,22 @@ conv_path_to_utf8_with_tmpl (const GString   *path,
     }
     i_ptr = path->str;
 
-    // Ballpark figure, GString decides alloc size on its own
-    s = g_string_sized_new (i_size + 1);
+    if (conv_buf == NULL)
+        conv_buf = g_string_sized_new (WIN_PATH_MAX * 3);
+    if (err_offsets == NULL)
+        err_offsets = g_array_new (FALSE, FALSE, sizeof (size_t));
+
+    // Each input char expands to at most 3 bytes in UTF-8 (which
+    // is the case of CJK chars), so E2BIG is rarely encountered.
+    // Buffer is only grown, never shrunk between calls.
+    s = conv_buf;
+    if (s->allocated_len <= i_size * 3 + 1)
+        s = g_string_set_size (s, i_size * 3 + 1);
+    s = g_string_truncate (s, 0);
     _sync_pos (s, &o_left, &o_ptr, true);
 
-    // Shouldn't fail, encoding already tested upon start of prog
-    conv = g_iconv_open ("UTF-8", from_enc ? from_enc : "UTF-16LE");
-
-    g_debug ("Initial : r=%02zu, w=%02zu/%02zu",
-        i_left, o_left, s->allocated_len - 1);
-    err_offsets = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
+    conv = _get_conv (from_enc);
+    err_offsets = g_array_set_size (err_offsets, 0);
 
     // Pass 1: Convert to UTF-8, all illegal seq become escaped hex
 
@@ -291,38 +506,43 @@ conv_path_to_utf8_with_tmpl (const GString   *path,
         if (status != (gsize) -1)
             break;
 
+        // Nothing is logged for each broken char, since hostile
+        // path full of them would be dominated by logging cost, or
+        // even become quadratic when converted string is logged
         int e = errno;
-        g_debug ("Progress: r=%02zu, w=%02zu/%02zu, status=%zd (%s), str=%s",
-            i_left, o_left, s->allocated_len - 1,
-            status, g_strerror(e), s->str);
 
         switch (e)
         {
         case EINVAL:
         case EILSEQ:
         {
-            size_t *processed = g_malloc (sizeof (size_t));
-            *processed = i_size - i_left;
-            g_ptr_array_add (err_offsets, processed);
+            size_t processed = i_size - i_left;
+            g_array_append_val (err_offsets, processed);
         }
             _advance_octet (char_sz, &i_ptr, &i_left, s, fmt_type);
             _sync_pos (s, &o_left, &o_ptr, true);
-            g_debug ("Progress: r=%02zu, w=%02zu/%02zu, str=%s",
-                i_left, o_left, s->allocated_len - 1, s->str);
             g_iconv (conv, NULL, NULL, &o_ptr, &o_left);  // reset state
             _sync_pos (s, &o_left, &o_ptr, false);
             break;
         case E2BIG:
+        {
+            // Enlarge buffer but keep converted content intact
+            gsize len = s->len;
             s = g_string_set_size (s, s->allocated_len * 2);
+            s = g_string_truncate (s, len);
             _sync_pos (s, &o_left, &o_ptr, true);
+        }
             break;
         }
     }
 
-    g_debug ("Finally : r=%02zu, w=%02zu/%02zu, status=%zd, str=%s",
-        i_left, o_left, s->allocated_len - 1, status, s->str);
+    // Keep the buffer pointer in sync, since it may be enlarged above
+    conv_buf = s;
 
-    g_iconv_close (conv);
+    if (err_offsets->len > 0)
+        r2_debug ("Finally : r=%02zu, w=%02zu/%02zu, status=%zd, "
+            "broken=%u, str=%s", i_left, o_left, s->allocated_len - 1,
+            status, err_offsets->len, s->str);
 
     if (error &&
         g_error_matches ((const GError *) (*error),
@@ -336,25 +556,29 @@ conv_path_to_utf8_with_tmpl (const GString   *path,
         for (size_t i = 0; i < err_offsets->len; i++)
         {
             g_string_append_printf (dbg_str, " %zu",
-                *((size_t *) (err_offsets->pdata[i])));
+                g_array_index (err_offsets, size_t, i));
         }
         (*error)->message = g_string_free (dbg_str, FALSE);
         g_free (old);
     }
 
-    g_ptr_array_free (err_offsets, TRUE);
-
     // Pass 2: Post processing, e.g. convert non-printable chars to hex
 
-    g_return_val_if_fail (g_utf8_validate (s->str, -1, NULL), NULL);
+    g_return_val_if_fail (g_utf8_validate (s->str, -1, NULL), false);
 
     if (func == NULL)
-        result = _filter_printable_char (s->str, fmt_type);
+        filter_printable_char (dest, s->str, fmt_type);
     else
-        result = func (s->str);
-    g_string_free (s, TRUE);
+        func (dest, s->str);
 
-    return result;
+    if (stats_on)
+    {
+        stats.paths++;
+        stats.fallbacks += err_offsets->len;
+        stats.wall += g_get_monotonic_time () - start;
+    }
+
+    return true;
 }
 
 
@@ -415,13 +639,19 @@ filter_escapes (const char *str)
 }
 
 
-char *
-json_escape (const char *src)
+/**
+ * @brief Escape string for use as JSON string value
+ * @param dest The `GString` where escaped string is appended
+ * @param src The UTF-8 string to be escaped
+ */
+void
+json_escape (GString      *dest,
+             const char   *src)
 {
     // TODO g_string_replace from glib 2.68 does it all
 
     char *p = (char *) src;
-    GString *s = g_string_sized_new (strlen (src));
+    GString *s = dest;
 
     while (*p) {
         gunichar c = g_utf8_get_char (p);
@@ -449,18 +679,17 @@ json_escape (const char *src)
             if (g_unichar_isgraph (c) || c == 0x20)
                 s = g_string_append_unichar (s, c);
             else if (c < 0x10000)
-                g_string_append_printf (s, "\\u%04X", c);
+                _append_tmpl (s, "\\u%04X", c);
             else  // calculate surrogate
             {
                 uint16_t high, low;
                 high = 0xD800 + ((c - 0x10000) >> 10  );
                 low  = 0xDC00 + ((c - 0x10000) & 0x3FF);
-                g_string_append_printf (s, "\\u%04X\\u%04X", high, low);
+                _append_tmpl (s, "\\u%04X", high);
+                _append_tmpl (s, "\\u%04X", low);
             }
             break;
         }
         p = g_utf8_next_char (p);
     }
-    return g_string_free (s, FALSE);
 }
-
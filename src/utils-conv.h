@@ -7,6 +7,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <inttypes.h>
 #include <glib.h>
 
 // All versions of recycle bin prior to Windows 10 use full PATH_MAX
@@ -26,12 +27,18 @@ typedef enum
     FORMAT_TEXT,
     FORMAT_XML,
     FORMAT_JSON,
+    FORMAT_JSONL,
+    FORMAT_ARROW,
+    FORMAT_SQLITE,
 } out_fmt;
 
 
 typedef struct _fmt_data {
     const char *friendly_name;
 
+    // File extension used when output file names are generated
+    const char *file_ext;
+
     // tmpl[0]=utf8 (max 32bit), 1=char (8bit), 2=ucs2 (16bit)
     // templates should use numeric printf format since
     // they are not proper characters, or non-printable
@@ -44,8 +51,17 @@ typedef struct _fmt_data {
 } _fmt_data;
 
 
+/* Counters of path conversion, only collected upon request */
+typedef struct _conv_stats {
+    uint64_t    paths;      /*!< Number of paths converted */
+    uint64_t    fallbacks;  /*!< Broken chars escaped with fallback template */
+    gint64      wall;       /*!< Time spent in microseconds */
+} conv_stats;
+
+
 typedef
-char *      (*StrTransformFunc)           (const char       *src);
+void        (*StrTransformFunc)           (GString          *dest,
+                                           const char       *src);
 
 
 bool          enc_is_ascii_compatible     (const char       *enc,
@@ -54,13 +70,27 @@ bool          enc_is_ascii_compatible     (const char       *enc,
 size_t        ucs2_bytelen                (const char       *str,
                                            ssize_t           max_sz);
 
-char *        conv_path_to_utf8_with_tmpl (const GString    *path,
+bool          conv_path_to_utf8_with_tmpl (const GString    *path,
                                            const char       *from_enc,
                                            out_fmt           fmt_type,
                                            StrTransformFunc  func,
+                                           GString          *dest,
                                            GError          **error);
 
+void          filter_printable_char       (GString          *dest,
+                                           const char       *str,
+                                           out_fmt           fmt_type);
+
+void          preload_conv_cache          (const char       *legacy_enc);
+
+void          free_conv_cache             (void);
+
+void          enable_conv_stats           (void);
+
+const conv_stats *get_conv_stats          (void);
+
 char *        filter_escapes              (const char       *str);
 
-char *        json_escape                 (const char       *src);
+void          json_escape                 (GString          *dest,
+                                           const char       *src);
 
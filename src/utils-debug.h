@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <glib.h>
+
+/*
+ * Debug messages on code paths run for every record or index file.
+ * Unlike plain g_debug(), arguments are not evaluated unless debug
+ * messages are enabled with G_MESSAGES_DEBUG environment variable,
+ * which is only looked up once. Release builds (where NDEBUG is
+ * defined) drop these messages entirely.
+ */
+
+#ifdef NDEBUG
+
+#define r2_debug_enabled()      (false)
+
+#else
+
+extern int      r2_debug_state;
+bool            r2_debug_check      (void);
+
+#define r2_debug_enabled()      \
+    (G_LIKELY (g_atomic_int_get (&r2_debug_state) >= 0) ? \
+        (bool) g_atomic_int_get (&r2_debug_state) : r2_debug_check ())
+
+#endif
+
+#define r2_debug(...)           \
+    do {                        \
+        if (G_UNLIKELY (r2_debug_enabled ())) \
+            g_debug (__VA_ARGS__);            \
+    } while (0)
@@ -4,18 +4,41 @@
  * Please see LICENSE file for more info.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE  /* O_TMPFILE, fallocate() */
+#endif
+
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 
+#include "utils-compress.h"
 #include "utils-io.h"
 #include "utils-platform.h"
 
+#ifdef G_OS_WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* Don't bother preallocating space for small output */
+#define PREALLOC_MIN_SIZE       (1024 * 1024)
+
 
 static FILE        *out_fh             = NULL;
 static FILE        *err_fh             = NULL;
 static FILE        *prev_fh            = NULL;
 static char        *tmpfile_path       = NULL;
+static bool         tmpfile_anon       = false;
+static bool         binary_out         = false;
+static compressor  *out_comp           = NULL;
+static GString     *comp_stage         = NULL;
 
 
 static void
@@ -29,6 +52,17 @@ _local_print   (const char   *str,
         return;
     }
 
+    // Output not written via output buffer (such as header)
+    // must be sent to compressor as well, in correct order
+    if (is_stdout && out_comp != NULL)
+    {
+        if (comp_stage == NULL)
+            comp_stage = g_string_new (NULL);
+        comp_stage = g_string_append (comp_stage, str);
+        compressor_push (out_comp, comp_stage);
+        return;
+    }
+
     fh = is_stdout ? out_fh : err_fh;
 
 #ifdef G_OS_WIN32
@@ -59,33 +93,198 @@ _local_printerr   (const char   *str)
 
 
 /**
- * @brief Wrapper of `g_mkstemp()` that manages file handle and
- * output behind the scene
+ * @brief Write out content of output buffer and empty it
+ * @param buf The buffer holding formatted output
+ * @note Unlike `g_print()`, no temporary string is allocated
+ * during the process, except for Windows console output.
+ */
+void
+flush_out_buffer   (GString   *buf)
+{
+    g_return_if_fail (buf != NULL);
+
+    if (buf->len == 0)
+        return;
+
+    if (out_comp != NULL)
+        compressor_push (out_comp, buf);
+    else if (binary_out)
+        fwrite (buf->str, 1, buf->len, out_fh);
+    else
+        _local_print (buf->str, true);
+    g_string_truncate (buf, 0);
+}
+
+
+/**
+ * @brief Deliver everything written so far to output destination
+ * @note Only needed when output is consumed while being written,
+ * since standard output is fully buffered when not a terminal
+ */
+void
+flush_output   (void)
+{
+    if (out_fh != NULL)
+        fflush (out_fh);
+}
+
+
+/**
+ * @brief Prepare output handle for writing binary data
+ * @param error Location of `GError` pointer to store potential problem
+ * @return `true` if binary data can be written, `false` otherwise
+ * @note Afterwards, `flush_out_buffer()` writes buffer content as is,
+ * without UTF-8 validation. Binary data can't be written to Windows
+ * console, and would be mangled by text mode translation on Windows.
+ */
+bool
+set_binary_output   (GError   **error)
+{
+    if (out_fh == NULL)
+    {
+        g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+            _("Binary output can not be written to console, "
+              "please use '-o' option or redirect output"));
+        return false;
+    }
+
+#ifdef G_OS_WIN32
+    _setmode (_fileno (out_fh), _O_BINARY);
+#endif
+    binary_out = true;
+    return true;
+}
+
+
+/**
+ * @brief Compress all subsequent output until `end_compress()`
+ * @param type Compression method
+ * @param error Location of `GError` pointer to store potential problem
+ * @return `true` if compression is started or not needed at all,
+ * `false` otherwise
+ * @note Compression happens in background thread, which writes
+ * to current output handle (such as temp file created by
+ * `get_tempfile()`)
+ */
+bool
+start_compress   (compress_type   type,
+                  GError        **error)
+{
+    if (type == COMPRESS_NONE)
+        return true;
+
+    if (! set_binary_output (error))
+        return false;
+
+    out_comp = compressor_new (type, out_fh, error);
+    return (out_comp != NULL);
+}
+
+
+/**
+ * @brief Finish compressed output started by `start_compress()`
+ * @param error Location of `GError` pointer to store potential problem
+ * @return `true` if all compressed data is written successfully
+ * @note Must be called before `clean_tempfile()`, which closes
+ * the handle compressed data is written to
+ */
+bool
+end_compress   (GError   **error)
+{
+    bool ret;
+
+    if (out_comp == NULL)
+        return true;
+
+    ret = compressor_finish (out_comp, error);
+    out_comp = NULL;
+    return ret;
+}
+
+
+/**
+ * @brief Create temp file in destination folder, and manage file
+ * handle and output behind the scene
+ * @param dest Final destination of output
+ * @param size_hint Estimated output size, or 0 if unknown
+ * @param named Whether temp file must be accessible by name,
+ * for output written by external library
  * @param error Location of `GError` pointer to store potential problem
  * @return `true` if temp file is created successfully. Upon problem,
  * returns `false` and `error` is set.
+ * @note On Linux, an anonymous file is created with `O_TMPFILE`
+ * whenever file system supports it, so that nothing is visible until
+ * `clean_tempfile()` links it to destination. Otherwise a named file
+ * is created with `g_mkstemp()`. Being in the same folder, the final
+ * rename or link never crosses file system boundary.
  */
 bool
-get_tempfile    (GError   **error)
+get_tempfile    (const char   *dest,
+                 gsize         size_hint,
+                 bool          named,
+                 GError      **error)
 {
-    int     fd, e = 0;
+    int     fd = -1, e = 0;
     FILE   *tmp_fh;
+    char   *dir;
 
-    // segfaults if string is pre-allocated in stack
-    tmpfile_path = g_strdup ("rifiuti-XXXXXX");
+    g_return_val_if_fail (dest && *dest, false);
 
-    if (-1 == (fd = g_mkstemp(tmpfile_path))) {
-        e = errno;
-        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno(e),
-            _("Can not create temp file: %s"), g_strerror(e));
-        return false;
+    dir = g_path_get_dirname (dest);
+
+#if defined(__linux__) && defined(O_TMPFILE)
+    // Libraries like SQLite resolve /proc/self/fd symlink, which
+    // points to nowhere for anonymous file
+    if (! named)
+    {
+        fd = open (dir, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666);
+        if (fd != -1)
+        {
+            tmpfile_anon = true;
+            tmpfile_path = g_strdup_printf ("/proc/self/fd/%d", fd);
+        }
+        else
+            g_debug ("O_TMPFILE unusable in '%s': %s",
+                dir, g_strerror (errno));
+    }
+#else
+    (void) named;
+#endif
+
+    if (fd == -1)
+    {
+        // segfaults if string is pre-allocated in stack
+        tmpfile_path = g_build_filename (dir, "rifiuti-XXXXXX", NULL);
+
+        if (-1 == (fd = g_mkstemp (tmpfile_path))) {
+            e = errno;
+            g_set_error (error, G_FILE_ERROR, g_file_error_from_errno(e),
+                _("Can not create temp file: %s"), g_strerror(e));
+            g_free (dir);
+            g_clear_pointer (&tmpfile_path, g_free);
+            return false;
+        }
     }
+    g_free (dir);
+
+#ifdef __linux__
+    // Only a hint, output is written fine without it
+    if (size_hint >= PREALLOC_MIN_SIZE &&
+        0 != fallocate (fd, FALLOC_FL_KEEP_SIZE, 0, (off_t) size_hint))
+        g_debug ("Can't preallocate output space: %s", g_strerror (errno));
+#else
+    (void) size_hint;
+#endif
 
     if (NULL == (tmp_fh = fdopen (fd, "wb"))) {
         e = errno;
         g_set_error (error, G_FILE_ERROR, g_file_error_from_errno(e),
             _("Can not open temp file: %s"), g_strerror(e));
         g_close (fd, NULL);
+        if (! tmpfile_anon)
+            g_unlink (tmpfile_path);
+        tmpfile_anon = false;
+        g_clear_pointer (&tmpfile_path, g_free);
         return false;
     }
 
@@ -96,29 +295,104 @@ get_tempfile    (GError   **error)
 }
 
 
+/**
+ * @brief Path of temp file created by `get_tempfile()`
+ * @return The temp file path, or `NULL` if none is created
+ * @note For output written by external library, which must be
+ * opened by file name instead of using file handle. Temp file
+ * must be created with `named` argument set in this case.
+ */
+const char *
+get_tempfile_path   (void)
+{
+    return tmpfile_path;
+}
+
+
+#if defined(__linux__) && defined(O_TMPFILE)
+/*
+ * linkat() never overwrites existing file, so link to a unique
+ * name first, then rename it over destination atomically
+ */
+static int
+_link_anon_file   (const char   *src,
+                   const char   *dest)
+{
+    char  *dir, *tmp;
+    int    result;
+
+    if (0 == linkat (AT_FDCWD, src, AT_FDCWD, dest, AT_SYMLINK_FOLLOW))
+        return 0;
+    if (errno != EEXIST)
+        return -1;
+
+    dir = g_path_get_dirname (dest);
+    do
+    {
+        char *name = g_strdup_printf ("rifiuti-%08x",
+            (unsigned int) g_random_int ());
+        tmp = g_build_filename (dir, name, NULL);
+        g_free (name);
+        result = linkat (AT_FDCWD, src, AT_FDCWD, tmp, AT_SYMLINK_FOLLOW);
+        if (result != 0)
+            g_clear_pointer (&tmp, g_free);
+    }
+    while (result != 0 && errno == EEXIST);
+    g_free (dir);
+
+    if (result == 0 && 0 != (result = g_rename (tmp, dest)))
+    {
+        int e = errno;
+        g_unlink (tmp);
+        errno = e;
+    }
+    g_free (tmp);
+
+    return result;
+}
+#endif
+
+
 bool
 clean_tempfile   (char      *dest,
                   GError   **error)
 {
-    int result;
+    int result = 0;
 
     if (tmpfile_path == NULL)
         return true;
 
+#if defined(__linux__) && defined(O_TMPFILE)
+    // Anonymous file vanishes once closed, so link it beforehand.
+    // Linking via /proc doesn't need privilege as AT_EMPTY_PATH does.
+    if (tmpfile_anon)
+    {
+        fflush (out_fh);
+        if (0 != (result = _link_anon_file (tmpfile_path, dest)))
+        {
+            int e = errno;
+            g_set_error (error, G_FILE_ERROR, g_file_error_from_errno(e),
+                _("%s. Output can't be saved to destination."),
+                g_strerror(e));
+        }
+    }
+#endif
+
     if (prev_fh)
     {
         fclose (out_fh);
         out_fh = prev_fh;
     }
 
-    if (0 != (result = g_rename (tmpfile_path, dest)))
+    if (! tmpfile_anon && 0 != (result = g_rename (tmpfile_path, dest)))
     {
         int e = errno;
         g_set_error (error, G_FILE_ERROR, g_file_error_from_errno(e),
             _("%s. Temp file '%s' can't be moved to destination."),
             g_strerror(e), tmpfile_path);
     }
-    g_free (tmpfile_path);
+    g_clear_pointer (&tmpfile_path, g_free);
+    tmpfile_anon = false;
 
     return (result == 0);
 }
@@ -149,6 +423,7 @@ close_handles   (void)
 {
     if (out_fh != NULL) fclose (out_fh);
     if (err_fh != NULL) fclose (err_fh);
+    if (comp_stage != NULL) g_string_free (comp_stage, TRUE);
     return;
 }
 
@@ -9,8 +9,20 @@
 #include <stdbool.h>
 #include <glib.h>
 
+#include "utils-compress.h"
+
 void              init_handles               (void);
 void              close_handles              (void);
-bool              get_tempfile               (GError   **error);
+void              flush_out_buffer           (GString   *buf);
+void              flush_output               (void);
+bool              set_binary_output          (GError   **error);
+bool              start_compress             (compress_type  type,
+                                              GError       **error);
+bool              end_compress               (GError   **error);
+bool              get_tempfile               (const char *dest,
+                                              gsize       size_hint,
+                                              bool        named,
+                                              GError    **error);
+const char *      get_tempfile_path          (void);
 bool              clean_tempfile             (char      *dest,
                                               GError   **error);
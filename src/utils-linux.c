@@ -4,10 +4,34 @@
  * Please see LICENSE file for more info.
  */
 
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <glib/gi18n.h>
+
 #include "utils-conv.h"
 #include "utils-error.h"
 #include "utils-platform.h"
 
+/* Room for at least one event with longest file name */
+#define WATCH_BUF_SIZE  (64 * (sizeof (struct inotify_event) + NAME_MAX + 1))
+
+#define WATCH_MASK  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | \
+                     IN_DELETE | IN_MOVED_FROM | \
+                     IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+struct _dir_watch
+{
+    int          fd;
+    GHashTable  *dirs;      /* watch descriptor -> folder */
+    char        *gone_dir;  /* folder of last DIR_WATCH_GONE event */
+    gsize        pos;
+    gsize        len;
+    char         buf[WATCH_BUF_SIZE]
+                 __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+};
+
 
 G_DEFINE_QUARK (rifiuti-misc-error-quark, rifiuti_misc_error)
 
@@ -236,3 +260,173 @@ windows_product_name (void)
     g_clear_error (&error);
     return result;
 }
+
+
+/**
+ * @brief Create inotify based folder watcher
+ * @param error Location to store error upon problem
+ * @return Newly created watcher without any folder, or `NULL` upon failure
+ */
+dir_watch *
+dir_watch_new   (GError   **error)
+{
+    dir_watch  *w;
+    int         fd = inotify_init1 (IN_CLOEXEC);
+
+    if (fd < 0)
+    {
+        int e = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (e),
+            _("Can not watch folders: %s"), g_strerror (e));
+        return NULL;
+    }
+
+    w = g_malloc0 (sizeof (dir_watch));
+    w->fd = fd;
+    w->dirs = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+    return w;
+}
+
+
+/**
+ * @brief Start watching content change of a folder
+ * @param w The watcher
+ * @param dir Folder to be watched
+ * @param error Location to store error upon problem
+ * @return `true` on success, `false` otherwise
+ */
+bool
+dir_watch_add   (dir_watch    *w,
+                 const char   *dir,
+                 GError      **error)
+{
+    int wd = inotify_add_watch (w->fd, dir, WATCH_MASK);
+
+    if (wd < 0)
+    {
+        int e = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (e),
+            _("Can not watch folder '%s': %s"), dir, g_strerror (e));
+        return false;
+    }
+
+    g_hash_table_replace (w->dirs, GINT_TO_POINTER (wd), g_strdup (dir));
+    return true;
+}
+
+
+/**
+ * @brief Number of folders still being watched
+ */
+guint
+dir_watch_count   (const dir_watch   *w)
+{
+    return g_hash_table_size (w->dirs);
+}
+
+
+/**
+ * @brief Wait for next change inside watched folders
+ * @param w The watcher
+ * @param event Location to store type of change
+ * @param dir Location to store folder where change happens,
+ * or `NULL` upon `DIR_WATCH_RESCAN`
+ * @param name Location to store name of changed file, or `NULL`
+ * if the change is not about a file inside folder
+ * @param error Location to store error upon problem
+ * @return `true` if a change is found, `false` upon error
+ * @note Strings returned are only valid until next call. Events
+ * are lost when kernel queue overflows, and `DIR_WATCH_RESCAN`
+ * is reported, meaning all folders must be scanned again.
+ */
+bool
+dir_watch_next   (dir_watch         *w,
+                  dir_watch_event   *event,
+                  const char       **dir,
+                  const char       **name,
+                  GError           **error)
+{
+    g_clear_pointer (&w->gone_dir, g_free);
+
+    while (true)
+    {
+        const struct inotify_event  *e;
+        ssize_t                      n;
+
+        if (w->pos >= w->len)
+        {
+            n = read (w->fd, w->buf, sizeof (w->buf));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                int e = (n < 0) ? errno : EIO;
+                g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (e),
+                    _("Can not watch folders: %s"), g_strerror (e));
+                return false;
+            }
+            w->pos = 0;
+            w->len = (gsize) n;
+        }
+
+        e = (const struct inotify_event *) (w->buf + w->pos);
+        w->pos += sizeof (struct inotify_event) + e->len;
+
+        *dir = NULL;
+        *name = NULL;
+
+        if (e->mask & IN_Q_OVERFLOW)
+        {
+            *event = DIR_WATCH_RESCAN;
+            return true;
+        }
+
+        // Removed watch, either by kernel or below
+        if (e->mask & IN_IGNORED)
+        {
+            g_hash_table_remove (w->dirs, GINT_TO_POINTER (e->wd));
+            continue;
+        }
+
+        if (! g_hash_table_lookup_extended (w->dirs,
+            GINT_TO_POINTER (e->wd), NULL, (gpointer *) dir))
+            continue;
+
+        if (e->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+        {
+            // Folder moved away is not watched by its new name
+            g_hash_table_steal (w->dirs, GINT_TO_POINTER (e->wd));
+            inotify_rm_watch (w->fd, e->wd);
+            w->gone_dir = (char *) *dir;
+            *event = DIR_WATCH_GONE;
+            return true;
+        }
+
+        if (e->len == 0 || e->name[0] == '\0')
+            continue;
+
+        // Files are only reported after being written; creation
+        // is only interesting for folders, such as deleted folder
+        // moved inside recycle bin
+        if ((e->mask & IN_CREATE) && ! (e->mask & IN_ISDIR))
+            continue;
+
+        *name = e->name;
+        *event = (e->mask & (IN_DELETE | IN_MOVED_FROM)) ?
+            DIR_WATCH_REMOVED : DIR_WATCH_ADDED;
+        return true;
+    }
+}
+
+
+void
+dir_watch_free   (dir_watch   *w)
+{
+    if (w == NULL)
+        return;
+
+    close (w->fd);
+    g_hash_table_destroy (w->dirs);
+    g_free (w->gone_dir);
+    g_free (w);
+}
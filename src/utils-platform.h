@@ -26,3 +26,27 @@ GPtrArray *enumerate_drive_bins     (GError        **error);
 char *     windows_product_name     (void);
 #endif
 
+
+#ifdef __linux__
+typedef struct _dir_watch dir_watch;
+
+typedef enum
+{
+    DIR_WATCH_ADDED,    /*!< File created or finished writing */
+    DIR_WATCH_REMOVED,  /*!< File deleted or moved away */
+    DIR_WATCH_GONE,     /*!< Watched folder itself deleted or moved */
+    DIR_WATCH_RESCAN,   /*!< Events lost, all folders need rescanning */
+} dir_watch_event;
+
+dir_watch *dir_watch_new            (GError        **error);
+bool       dir_watch_add            (dir_watch      *w,
+                                     const char     *dir,
+                                     GError        **error);
+guint      dir_watch_count          (const dir_watch *w);
+bool       dir_watch_next           (dir_watch      *w,
+                                     dir_watch_event *event,
+                                     const char    **dir,
+                                     const char    **name,
+                                     GError        **error);
+void       dir_watch_free           (dir_watch      *w);
+#endif
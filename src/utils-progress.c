@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Progress of long runs, printed to stderr periodically. Parsers
+ * only bump counters with relaxed atomic increments; a separate
+ * thread wakes up at fixed interval to read counters and print
+ * throughput and estimated remaining time. Progress is estimated
+ * from number of index files, or from bytes processed when there is
+ * only one big file (INFO2 file or carved image).
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <glib.h>
+
+#ifdef G_OS_WIN32
+#include <io.h>
+#define isatty _isatty
+#define STDERR_FILENO 2
+#else
+#include <unistd.h>
+#endif
+
+#include "utils-progress.h"
+
+/* Time between progress updates, in microseconds */
+#define PROGRESS_INTERVAL   G_USEC_PER_SEC
+
+bool                    progress_on = false;
+atomic_uint_fast64_t    progress_counters[PROGRESS_N_COUNTERS];
+
+static GThread         *progress_thread    = NULL;
+static GMutex           progress_lock;
+static GCond            progress_cond;
+static bool             stopping           = false;
+static bool             on_tty             = false;
+static gint64           start_time         = 0;
+static gsize            last_len           = 0;
+
+
+static uint64_t
+_get   (progress_counter  counter)
+{
+    return atomic_load_explicit (&progress_counters[counter],
+        memory_order_relaxed);
+}
+
+
+/**
+ * @brief Print single progress line
+ * @param final Whether this is the last line, which is always
+ * terminated by newline
+ */
+static void
+_print_progress   (bool   final)
+{
+    GString  *s = g_string_new (NULL);
+    gint64    elapsed = g_get_monotonic_time () - start_time;
+    uint64_t  records     = _get (PROGRESS_RECORDS),
+              files_done  = _get (PROGRESS_FILES_DONE),
+              files_total = _get (PROGRESS_FILES_TOTAL),
+              bytes_done  = _get (PROGRESS_BYTES_DONE),
+              bytes_total = _get (PROGRESS_BYTES_TOTAL);
+    double    fraction = -1;
+
+    g_string_append_printf (s, "%" PRIu64 " records (%" PRIu64 "/s)",
+        records, records * G_USEC_PER_SEC / (uint64_t) MAX (elapsed, 1));
+
+    if (files_total)
+        g_string_append_printf (s, ", %" PRIu64 "/%" PRIu64 " files",
+            files_done, files_total);
+
+    // Size of INFO2 files is only known when each is opened
+    if (files_total > 1 || (files_total && ! bytes_total))
+        fraction = (double) MIN (files_done, files_total) / files_total;
+    else if (bytes_total)
+        fraction = (double) MIN (bytes_done, bytes_total) / bytes_total;
+
+    if (fraction >= 0)
+        g_string_append_printf (s, ", %d%%", (int) (fraction * 100));
+
+    if (! final && fraction > 0)
+    {
+        gint64 eta = (gint64) (elapsed * (1 - fraction) / fraction)
+            / G_USEC_PER_SEC;
+        g_string_append_printf (s, ", ETA %d:%02d:%02d",
+            (int) (eta / 3600), (int) (eta / 60 % 60), (int) (eta % 60));
+    }
+
+    if (on_tty)
+    {
+        // Wipe remnant of longer previous line
+        gsize len = s->len;
+        if (last_len > len)
+            g_string_append_printf (s, "%*s", (int) (last_len - len), "");
+        last_len = len;
+        g_string_prepend_c (s, '\r');
+        if (final)
+            g_string_append_c (s, '\n');
+    }
+    else
+        g_string_append_c (s, '\n');
+
+    fputs (s->str, stderr);
+    fflush (stderr);
+    g_string_free (s, TRUE);
+}
+
+
+static gpointer
+_progress_thread   (gpointer  data)
+{
+    gint64 next = start_time + PROGRESS_INTERVAL;
+
+    (void) data;
+
+    g_mutex_lock (&progress_lock);
+    while (! stopping)
+    {
+        if (g_cond_wait_until (&progress_cond, &progress_lock, next))
+            continue;
+        next += PROGRESS_INTERVAL;
+        _print_progress (false);
+    }
+    g_mutex_unlock (&progress_lock);
+    return NULL;
+}
+
+
+/**
+ * @brief Start showing progress periodically
+ * @param force Show progress even if stderr is not a terminal
+ */
+void
+progress_start   (bool   force)
+{
+    if (progress_on)
+        return;
+
+    on_tty = isatty (STDERR_FILENO);
+    if (! on_tty && ! force)
+        return;
+
+    start_time = g_get_monotonic_time ();
+    progress_on = true;
+    progress_thread = g_thread_new ("progress", _progress_thread, NULL);
+}
+
+
+/**
+ * @brief Stop showing progress, and print final counts if any
+ * progress has been shown
+ */
+void
+progress_stop   (void)
+{
+    if (progress_thread == NULL)
+        return;
+
+    g_mutex_lock (&progress_lock);
+    stopping = true;
+    g_cond_signal (&progress_cond);
+    g_mutex_unlock (&progress_lock);
+
+    g_thread_join (progress_thread);
+    progress_thread = NULL;
+    progress_on = false;
+
+    if (g_get_monotonic_time () - start_time >= PROGRESS_INTERVAL)
+        _print_progress (true);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <glib.h>
+
+typedef enum
+{
+    PROGRESS_RECORDS,       /*!< Records parsed or carved */
+    PROGRESS_FILES_DONE,    /*!< Index files parsed */
+    PROGRESS_FILES_TOTAL,   /*!< Index files found so far */
+    PROGRESS_BYTES_DONE,    /*!< Bytes of INFO2 file or image processed */
+    PROGRESS_BYTES_TOTAL,   /*!< Bytes of INFO2 file or image to process */
+    PROGRESS_N_COUNTERS,
+} progress_counter;
+
+extern bool                    progress_on;
+extern atomic_uint_fast64_t    progress_counters[PROGRESS_N_COUNTERS];
+
+/* Only costs a relaxed atomic increment when progress is shown */
+#define progress_add(counter, n)                                    \
+    do {                                                            \
+        if (G_UNLIKELY (progress_on))                               \
+            atomic_fetch_add_explicit (&progress_counters[counter], \
+                (n), memory_order_relaxed);                         \
+    } while (0)
+
+void              progress_start             (bool              force);
+void              progress_stop              (void);
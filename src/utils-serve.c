@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700  /* SA_RESTART */
+#endif
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+#include "utils.h"
+#include "utils-serve.h"
+
+/* Arguments of single request can't exceed this size */
+#define MAX_REQUEST_SIZE    (64 * 1024)
+
+/* Maximum amount of output relayed to client in one frame */
+#define RELAY_BUF_SIZE      (64 * 1024)
+
+
+static volatile sig_atomic_t stop_serving = 0;
+
+
+static void
+_stop_serving   (int   sig)
+{
+    UNUSED (sig);
+    stop_serving = 1;
+}
+
+
+static void
+_reap_children   (int   sig)
+{
+    int saved_errno = errno;
+
+    UNUSED (sig);
+    while (waitpid (-1, NULL, WNOHANG) > 0);
+    errno = saved_errno;
+}
+
+
+static bool
+_write_all   (int           fd,
+              const void   *buf,
+              gsize         len)
+{
+    const char *p = buf;
+
+    while (len > 0)
+    {
+        ssize_t n = write (fd, p, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+
+static bool
+_send_frame   (int           fd,
+               char          type,
+               const void   *data,
+               gsize         len)
+{
+    guint8   header[SERVE_FRAME_HEADER_SIZE];
+    uint32_t size = GUINT32_TO_LE ((uint32_t) len);
+
+    header[0] = (guint8) type;
+    memcpy (header + 1, &size, sizeof (size));
+
+    return _write_all (fd, header, sizeof (header)) &&
+        _write_all (fd, data, len);
+}
+
+
+/**
+ * @brief Send error message and exit code to client as sole reply
+ */
+static void
+_send_failure   (int           fd,
+                 const char   *msg,
+                 guint8        code)
+{
+    _send_frame (fd, SERVE_FRAME_ERROR, msg, strlen (msg));
+    _send_frame (fd, SERVE_FRAME_EXIT, &code, 1);
+}
+
+
+/**
+ * @brief Read arguments of single request from client
+ * @param fd Connection to client
+ * @param cwd Location to store working directory of client
+ * @return Argument vector with program name prepended, or `NULL` if
+ * request is too large, malformed or connection fails
+ * @note Client closing connection also marks end of request
+ */
+static char **
+_read_request   (int     fd,
+                 char  **cwd)
+{
+    GString   *s = g_string_new (NULL);
+    GPtrArray *args;
+    gsize      end = 0;
+    bool       found = false;
+
+    while (! found)
+    {
+        char    buf[4096];
+        ssize_t n = read (fd, buf, sizeof (buf));
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 || s->len + n > MAX_REQUEST_SIZE)
+        {
+            g_string_free (s, TRUE);
+            return NULL;
+        }
+        if (n == 0)
+            break;
+
+        g_string_append_len (s, buf, n);
+        for (; end < s->len; end++)
+        {
+            if (s->str[end] == '\0' && (end == 0 || s->str[end - 1] == '\0'))
+            {
+                found = true;
+                break;
+            }
+        }
+    }
+
+    // Relative paths in request would be meaningless otherwise
+    if (! g_path_is_absolute (s->str))
+    {
+        g_string_free (s, TRUE);
+        return NULL;
+    }
+    *cwd = g_strdup (s->str);
+
+    args = g_ptr_array_new ();
+    g_ptr_array_add (args, g_strdup (g_get_prgname ()));
+    for (gsize i = strlen (s->str) + 1; i < end; i += strlen (s->str + i) + 1)
+        g_ptr_array_add (args, g_strdup (s->str + i));
+    g_ptr_array_add (args, NULL);
+
+    g_string_free (s, TRUE);
+    return (char **) g_ptr_array_free (args, FALSE);
+}
+
+
+/**
+ * @brief Relay output and error messages of request to client
+ * @return `false` if client is gone, `true` otherwise
+ */
+static bool
+_relay_output   (int   conn,
+                 int   out_fd,
+                 int   err_fd)
+{
+    struct pollfd  fds[2] = {
+        { .fd = out_fd, .events = POLLIN },
+        { .fd = err_fd, .events = POLLIN },
+    };
+    const char     types[2] = { SERVE_FRAME_OUTPUT, SERVE_FRAME_ERROR };
+    char          *buf = g_malloc (RELAY_BUF_SIZE);
+    int            remaining = 2;
+    bool           ret = true;
+
+    while (remaining && ret)
+    {
+        if (poll (fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < 2 && ret; i++)
+        {
+            ssize_t n;
+
+            // Negative descriptors are ignored by poll()
+            if (fds[i].fd < 0 || fds[i].revents == 0)
+                continue;
+
+            n = read (fds[i].fd, buf, RELAY_BUF_SIZE);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                close (fds[i].fd);
+                fds[i].fd = -1;
+                remaining--;
+                continue;
+            }
+            ret = _send_frame (conn, types[i], buf, n);
+        }
+    }
+
+    g_free (buf);
+    return ret;
+}
+
+
+/**
+ * @brief Handle single connection inside its own process
+ * @note Request is processed in yet another process, so that
+ * its exit code can be reported even if it exits midway
+ * (such as printing help)
+ */
+static void G_GNUC_NORETURN
+_serve_conn   (int         conn,
+               ServeFunc   func,
+               gpointer    data)
+{
+    char  **args, *cwd = NULL;
+    int     out_pipe[2], err_pipe[2];
+    int     status;
+    pid_t   pid;
+    guint8  code;
+
+    if (NULL == (args = _read_request (conn, &cwd)))
+    {
+        _send_failure (conn, _("Request is malformed or too large.\n"),
+            EXIT_ERR_ARG);
+        _exit (EXIT_ERR_ARG);
+    }
+
+    if (pipe (out_pipe) < 0 || pipe (err_pipe) < 0 || (pid = fork ()) < 0)
+    {
+        char *msg = g_strdup_printf (
+            _("Can not start processing request: %s\n"), g_strerror (errno));
+        _send_failure (conn, msg, EXIT_ERR_UNHANDLED);
+        _exit (EXIT_ERR_UNHANDLED);
+    }
+
+    if (pid == 0)
+    {
+        close (conn);
+        close (out_pipe[0]);
+        close (err_pipe[0]);
+        dup2 (out_pipe[1], STDOUT_FILENO);
+        dup2 (err_pipe[1], STDERR_FILENO);
+        close (out_pipe[1]);
+        close (err_pipe[1]);
+
+        if (chdir (cwd) < 0)
+        {
+            g_printerr (_("Can not change to client directory '%s': %s\n"),
+                cwd, g_strerror (errno));
+            exit (EXIT_ERR_ARG);
+        }
+
+        // Flush standard output and error upon exit
+        exit (func (args, data));
+    }
+
+    g_strfreev (args);
+    g_free (cwd);
+    close (out_pipe[1]);
+    close (err_pipe[1]);
+
+    // No point continuing if nobody receives output
+    if (! _relay_output (conn, out_pipe[0], err_pipe[0]))
+        kill (pid, SIGTERM);
+
+    while (waitpid (pid, &status, 0) < 0 && errno == EINTR);
+
+    code = WIFEXITED (status) ? WEXITSTATUS (status) : EXIT_ERR_UNHANDLED;
+    _send_frame (conn, SERVE_FRAME_EXIT, &code, 1);
+    _exit (code);
+}
+
+
+/**
+ * @brief Check if socket file is left behind by server no longer
+ * running, so that it can be reused
+ */
+static bool
+_is_stale_socket   (const struct sockaddr_un   *addr)
+{
+    int   fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    bool  stale;
+
+    if (fd < 0)
+        return false;
+
+    stale = (connect (fd, (const struct sockaddr *) addr,
+        sizeof (*addr)) < 0 && errno == ECONNREFUSED);
+    close (fd);
+    return stale;
+}
+
+
+static int
+_open_socket   (const char   *path,
+                GError      **error)
+{
+    struct sockaddr_un  addr = { .sun_family = AF_UNIX };
+    int                 fd, e;
+
+    if (strlen (path) >= sizeof (addr.sun_path))
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NAMETOOLONG,
+            _("Socket path '%s' is too long."), path);
+        return -1;
+    }
+    strcpy (addr.sun_path, path);
+
+    if (0 > (fd = socket (AF_UNIX, SOCK_STREAM, 0)))
+        goto socket_fail;
+
+    if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0)
+    {
+        if (errno != EADDRINUSE || ! _is_stale_socket (&addr) ||
+            g_unlink (path) < 0 ||
+            bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0)
+            goto socket_fail;
+    }
+
+    // Requests can read anything readable by server
+    if (chmod (path, S_IRUSR | S_IWUSR) < 0 || listen (fd, SOMAXCONN) < 0)
+    {
+        e = errno;
+        g_unlink (path);
+        errno = e;
+        goto socket_fail;
+    }
+
+    return fd;
+
+    socket_fail:
+
+    e = errno;
+    if (fd >= 0)
+        close (fd);
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (e),
+        _("Can not listen on socket '%s': %s"), path, g_strerror (e));
+    return -1;
+}
+
+
+/**
+ * @brief Serve requests over Unix domain socket until interrupted
+ * @param path Location of socket to be created
+ * @param func Routine processing single request, whose return value
+ * is the exit code of request
+ * @param data Extra data passed to `func`
+ * @param error Location to store error if socket can't be used
+ * @return `true` if server is stopped by `SIGINT` or `SIGTERM`,
+ * `false` upon error
+ * @note Each request is processed in a process forked from server,
+ * so that requests run concurrently, and all resources prepared
+ * by server beforehand are available to every request without
+ * any setup. Requests can't affect each other nor the server.
+ */
+bool
+serve_requests   (const char   *path,
+                  ServeFunc     func,
+                  gpointer      data,
+                  GError      **error)
+{
+    struct sigaction  stop_sa = { .sa_handler = _stop_serving };
+    struct sigaction  chld_sa = { .sa_handler = _reap_children,
+                                  .sa_flags = SA_RESTART | SA_NOCLDSTOP };
+    int               listen_fd, e = 0;
+
+    g_return_val_if_fail (path && *path, false);
+    g_return_val_if_fail (func != NULL, false);
+
+    if (0 > (listen_fd = _open_socket (path, error)))
+        return false;
+
+    // Without SA_RESTART, so that accept() is interrupted
+    sigemptyset (&stop_sa.sa_mask);
+    sigaction (SIGINT, &stop_sa, NULL);
+    sigaction (SIGTERM, &stop_sa, NULL);
+    sigemptyset (&chld_sa.sa_mask);
+    sigaction (SIGCHLD, &chld_sa, NULL);
+    signal (SIGPIPE, SIG_IGN);
+
+    while (! stop_serving)
+    {
+        int    conn;
+        pid_t  pid;
+
+        if (0 > (conn = accept (listen_fd, NULL, NULL)))
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            e = errno;
+            break;
+        }
+
+        fflush (NULL);
+        if (0 == (pid = fork ()))
+        {
+            close (listen_fd);
+            signal (SIGINT, SIG_DFL);
+            signal (SIGTERM, SIG_DFL);
+            signal (SIGCHLD, SIG_DFL);
+            _serve_conn (conn, func, data);
+        }
+
+        if (pid < 0)
+            _send_failure (conn, _("Server is too busy.\n"),
+                EXIT_ERR_UNHANDLED);
+        close (conn);
+    }
+
+    close (listen_fd);
+    g_unlink (path);
+
+    if (e)
+    {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (e),
+            _("Can not accept connection on socket '%s': %s"),
+            path, g_strerror (e));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <glib.h>
+
+/*
+ * Protocol of served requests over Unix domain socket:
+ *
+ * Client sends its absolute working directory, followed by command
+ * line arguments (without program name), each terminated by NUL,
+ * and an empty argument marks end of request. Request is processed
+ * inside client working directory, so relative paths work as if
+ * program is run by client. Server replies with a series of frames, each one
+ * being a type byte, payload length as 32 bit little endian
+ * integer, then the payload:
+ *
+ * - 'O': Chunk of program output
+ * - 'E': Chunk of error message
+ * - 'X': Exit code as single byte, always the last frame
+ *
+ * Connection is closed afterwards.
+ */
+#define SERVE_FRAME_OUTPUT      'O'
+#define SERVE_FRAME_ERROR       'E'
+#define SERVE_FRAME_EXIT        'X'
+#define SERVE_FRAME_HEADER_SIZE 5
+
+typedef int (*ServeFunc)                  (char            **args,
+                                           gpointer          data);
+
+bool          serve_requests              (const char       *path,
+                                           ServeFunc         func,
+                                           gpointer          data,
+                                           GError          **error);
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * SQLite database output. Tables mirror JSON output: bin metadata
+ * in `metadata` table, one row per record in `records` table, plus
+ * unparsable index files (or INFO2 segments) in `errors` table.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sqlite3.h>
+#include <glib/gi18n.h>
+
+#include "utils-conv.h"
+#include "utils-sqlite.h"
+
+/* Records inserted per transaction */
+#define SQLITE_TXN_SIZE     50000
+
+struct _sqlite_writer
+{
+    sqlite3           *db;
+    sqlite3_stmt      *insert;
+    const metarecord  *meta;
+    GString           *path;  /* reused for path conversion */
+    guint              pending;
+};
+
+static const char schema_sql[] =
+    // Journal is of no use, since database is written to a temp
+    // file, which is only moved to destination upon success
+    "PRAGMA journal_mode = OFF;"
+    "PRAGMA synchronous = OFF;"
+    "CREATE TABLE metadata ("
+    "  format       TEXT NOT NULL,"
+    "  version      INTEGER,"
+    "  ever_existed INTEGER,"
+    "  path         TEXT NOT NULL);"
+    // index is integer for INFO2, file name for $Recycle.bin,
+    // and offset inside image for carved records
+    "CREATE TABLE records ("
+    "  \"index\"      NOT NULL,"
+    "  time         TEXT,"
+    "  gone         INTEGER,"
+    "  size         INTEGER,"
+    "  path         TEXT);"
+    "CREATE TABLE errors ("
+    "  entry        TEXT NOT NULL,"
+    "  message      TEXT NOT NULL);"
+    "BEGIN;";
+
+
+static void
+_set_db_error   (GError   **error,
+                 sqlite3   *db)
+{
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+        _("Failed to write database: %s"), sqlite3_errmsg (db));
+}
+
+
+static bool
+_insert_metadata   (sqlite_writer  *w,
+                    GError        **error)
+{
+    const metarecord  *meta = w->meta;
+    sqlite3_stmt      *stmt = NULL;
+    char              *rbin_path;
+    int                rc;
+
+    if (SQLITE_OK != sqlite3_prepare_v2 (w->db,
+        "INSERT INTO metadata VALUES (?, ?, ?, ?);", -1, &stmt, NULL))
+    {
+        _set_db_error (error, w->db);
+        return false;
+    }
+
+    sqlite3_bind_text (stmt, 1,
+        (meta->type == RECYCLE_BIN_TYPE_FILE) ? "file" : "dir",
+        -1, SQLITE_STATIC);
+
+    if (meta->version >= 0)  /* can be found and not error */
+        sqlite3_bind_int64 (stmt, 2, meta->version);
+
+    if (meta->type == RECYCLE_BIN_TYPE_FILE && meta->total_entry > 0)
+        sqlite3_bind_int64 (stmt, 3, meta->total_entry);
+
+    rbin_path = g_filename_display_name (meta->filename);
+    sqlite3_bind_text (stmt, 4, rbin_path, -1, SQLITE_TRANSIENT);
+    g_free (rbin_path);
+
+    if (SQLITE_DONE != (rc = sqlite3_step (stmt)))
+        _set_db_error (error, w->db);
+
+    sqlite3_finalize (stmt);
+    return (rc == SQLITE_DONE);
+}
+
+
+static int
+_compare_str   (const void   *a,
+                const void   *b)
+{
+    return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+
+static bool
+_insert_errors   (sqlite_writer  *w,
+                  GError        **error)
+{
+    sqlite3_stmt  *stmt = NULL;
+    gpointer      *keys;
+    guint          len;
+    bool           ret = true;
+
+    if (SQLITE_OK != sqlite3_prepare_v2 (w->db,
+        "INSERT INTO errors VALUES (?, ?);", -1, &stmt, NULL))
+    {
+        _set_db_error (error, w->db);
+        return false;
+    }
+
+    // Sorted for reproducible output
+    keys = g_hash_table_get_keys_as_array (w->meta->invalid_records, &len);
+    qsort (keys, len, sizeof (gpointer), _compare_str);
+
+    for (guint i = 0; i < len; i++)
+    {
+        const GError *e = g_hash_table_lookup (
+            w->meta->invalid_records, keys[i]);
+
+        sqlite3_bind_text (stmt, 1, keys[i], -1, SQLITE_STATIC);
+        sqlite3_bind_text (stmt, 2, e->message, -1, SQLITE_STATIC);
+
+        if (SQLITE_DONE != sqlite3_step (stmt))
+        {
+            _set_db_error (error, w->db);
+            ret = false;
+            break;
+        }
+        sqlite3_reset (stmt);
+    }
+
+    g_free (keys);
+    sqlite3_finalize (stmt);
+    return ret;
+}
+
+
+static void
+_writer_free   (sqlite_writer  *w)
+{
+    sqlite3_finalize (w->insert);
+    sqlite3_close (w->db);
+    g_string_free (w->path, TRUE);
+    g_free (w);
+}
+
+
+/**
+ * @brief Create database schema and fill in all data except records
+ * @param dbpath Path of database file, which is either empty or
+ * non-existent
+ * @param meta Recycle bin metadata
+ * @param error Location to store error upon problem
+ * @return Newly created writer, or `NULL` upon failure
+ * @note Errors are always in `G_FILE_ERROR` domain, just like other
+ * output problems
+ */
+sqlite_writer *
+sqlite_writer_new   (const char        *dbpath,
+                     const metarecord  *meta,
+                     GError           **error)
+{
+    sqlite_writer *w;
+
+    g_return_val_if_fail (dbpath && *dbpath, NULL);
+    g_return_val_if_fail (meta != NULL, NULL);
+
+    w = g_malloc0 (sizeof (sqlite_writer));
+    w->meta = meta;
+    w->path = g_string_sized_new (WIN_PATH_MAX);
+
+    if (SQLITE_OK != sqlite3_open_v2 (dbpath, &w->db,
+        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) ||
+        SQLITE_OK != sqlite3_exec (w->db, schema_sql, NULL, NULL, NULL) ||
+        SQLITE_OK != sqlite3_prepare_v2 (w->db,
+            "INSERT INTO records VALUES (?, ?, ?, ?, ?);",
+            -1, &w->insert, NULL))
+    {
+        _set_db_error (error, w->db);
+        _writer_free (w);
+        return NULL;
+    }
+
+    if (! _insert_metadata (w, error) || ! _insert_errors (w, error))
+    {
+        _writer_free (w);
+        return NULL;
+    }
+
+    return w;
+}
+
+
+/**
+ * @brief Insert a single record into database
+ * @param w The database writer
+ * @param record The record to be inserted
+ * @param deltime Formatted deletion time, same as JSON output
+ * @param error Location to store error upon problem
+ * @return `true` on success, `false` otherwise
+ * @note Records are committed in batches of `SQLITE_TXN_SIZE`
+ */
+bool
+sqlite_writer_add   (sqlite_writer  *w,
+                     rbin_struct    *record,
+                     const char     *deltime,
+                     GError        **error)
+{
+    sqlite3_stmt  *stmt;
+    GString       *src;
+    const char    *enc;
+
+    g_return_val_if_fail (w != NULL, false);
+    g_return_val_if_fail (record != NULL, false);
+
+    stmt = w->insert;
+    sqlite3_reset (stmt);
+    sqlite3_clear_bindings (stmt);
+
+    if (has_numeric_index (w->meta))
+        sqlite3_bind_int64 (stmt, 1, record->index_n);
+    else
+        sqlite3_bind_text (stmt, 1, record->index_s, -1, SQLITE_STATIC);
+
+    sqlite3_bind_text (stmt, 2, deltime, -1, SQLITE_STATIC);
+
+    if (record->gone != FILESTATUS_UNKNOWN)
+        sqlite3_bind_int (stmt, 3, record->gone == FILESTATUS_GONE);
+
+    if (record->filesize != G_MAXUINT64)  // faulty
+        sqlite3_bind_int64 (stmt, 4, (sqlite3_int64) record->filesize);
+
+    enc = r2_context_get_legacy_encoding (w->meta->ctx);
+    src = enc ? record->raw_legacy_path : record->raw_uni_path;
+    g_string_truncate (w->path, 0);
+    if (conv_path_to_utf8_with_tmpl (src, enc,
+        FORMAT_SQLITE, NULL, w->path, &record->error))
+        sqlite3_bind_text (stmt, 5, w->path->str, w->path->len,
+            SQLITE_STATIC);
+
+    if (SQLITE_DONE != sqlite3_step (stmt))
+    {
+        _set_db_error (error, w->db);
+        return false;
+    }
+
+    if (++w->pending == SQLITE_TXN_SIZE)
+    {
+        w->pending = 0;
+        if (SQLITE_OK != sqlite3_exec (w->db,
+            "COMMIT; BEGIN;", NULL, NULL, NULL))
+        {
+            _set_db_error (error, w->db);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * @brief Commit remaining records and close database
+ * @param w The database writer, which is freed afterwards
+ * @param error Location to store error upon problem
+ * @return `true` on success, `false` otherwise
+ * @note Should be called even after failure of other routines,
+ * with `error` set to `NULL`, so that resources are released
+ */
+bool
+sqlite_writer_finish   (sqlite_writer  *w,
+                        GError        **error)
+{
+    bool ret = true;
+
+    g_return_val_if_fail (w != NULL, false);
+
+    if (SQLITE_OK != sqlite3_exec (w->db, "COMMIT;", NULL, NULL, NULL))
+    {
+        _set_db_error (error, w->db);
+        ret = false;
+    }
+
+    _writer_free (w);
+    return ret;
+}
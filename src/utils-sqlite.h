@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <glib.h>
+
+#include "utils.h"
+
+typedef struct _sqlite_writer sqlite_writer;
+
+sqlite_writer *   sqlite_writer_new          (const char        *dbpath,
+                                              const metarecord  *meta,
+                                              GError           **error);
+bool              sqlite_writer_add          (sqlite_writer     *w,
+                                              rbin_struct       *record,
+                                              const char        *deltime,
+                                              GError           **error);
+bool              sqlite_writer_finish       (sqlite_writer     *w,
+                                              GError           **error);
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Persistent set of records emitted in previous runs. Each record is
+ * reduced to a 64-bit hash of its identity, and kept in an open
+ * addressing hash table with linear probing, so that lookup is O(1)
+ * and memory use stays at 8 bytes per slot even with millions of
+ * records. With 64-bit hashes, chance of collision stays negligible
+ * until billions of records are seen.
+ *
+ * State file consists of 8 byte magic, 64-bit entry count, then
+ * all entries; all numbers are little endian.
+ */
+
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include "utils-state.h"
+
+#define STATE_MAGIC         "R2STATE1"
+#define STATE_HEADER_SIZE   16
+#define STATE_MIN_SLOTS     1024
+
+/* 0 marks empty slot, thus never used as identity */
+#define EMPTY_SLOT          0
+
+struct _seen_set
+{
+    char      *path;
+    uint64_t  *slots;
+    gsize      n_slots;   /* always power of 2 */
+    gsize      count;
+    bool       dirty;
+};
+
+
+/**
+ * @brief Compute identity of a record
+ * @param key Data identifying record inside recycle bin, such as
+ * index file name or INFO2 index number
+ * @param len Length of `key`
+ * @param filetime Deletion time of record as FILETIME
+ * @return 64-bit identity, never zero
+ */
+uint64_t
+seen_set_identity   (const void   *key,
+                     gsize         len,
+                     int64_t       filetime)
+{
+    const guint8 *p = key;
+    uint64_t      h = 0xcbf29ce484222325ULL;  // FNV-1a
+    uint64_t      t = GUINT64_TO_LE ((uint64_t) filetime);
+
+    for (gsize i = 0; i < len; i++)
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+
+    p = (const guint8 *) &t;
+    for (gsize i = 0; i < sizeof (t); i++)
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+
+    // Final mix, so that low bits are usable as table index
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+
+    return (h == EMPTY_SLOT) ? 1 : h;
+}
+
+
+static void
+_insert_slot   (uint64_t   *slots,
+                gsize       n_slots,
+                uint64_t    id)
+{
+    gsize i = id & (n_slots - 1);
+
+    while (slots[i] != EMPTY_SLOT && slots[i] != id)
+        i = (i + 1) & (n_slots - 1);
+    slots[i] = id;
+}
+
+
+/* Keep load factor at or below one half */
+static void
+_reserve   (seen_set   *s,
+            gsize       count)
+{
+    uint64_t  *old = s->slots;
+    gsize      old_n = s->n_slots;
+    gsize      n = MAX (s->n_slots, STATE_MIN_SLOTS);
+
+    while (n < count * 2)
+        n *= 2;
+    if (n == s->n_slots)
+        return;
+
+    s->slots = g_new0 (uint64_t, n);
+    s->n_slots = n;
+    for (gsize i = 0; i < old_n; i++)
+        if (old[i] != EMPTY_SLOT)
+            _insert_slot (s->slots, n, old[i]);
+    g_free (old);
+}
+
+
+/**
+ * @brief Load set of seen records from state file
+ * @param path State file, which may not exist yet
+ * @param error Location to store error upon problem
+ * @return The set, or `NULL` if file exists but is not a state file
+ */
+seen_set *
+seen_set_load   (const char   *path,
+                 GError      **error)
+{
+    seen_set  *s;
+    char      *content = NULL;
+    gsize      len = 0;
+    uint64_t   count = 0, id;
+
+    g_return_val_if_fail (path && *path, NULL);
+
+    s = g_malloc0 (sizeof (seen_set));
+    s->path = g_strdup (path);
+
+    if (! g_file_test (path, G_FILE_TEST_EXISTS))
+    {
+        _reserve (s, 0);
+        return s;
+    }
+
+    if (! g_file_get_contents (path, &content, &len, error))
+        goto load_fail;
+
+    if (len >= STATE_HEADER_SIZE)
+    {
+        memcpy (&count, content + 8, sizeof (count));
+        count = GUINT64_FROM_LE (count);
+    }
+
+    if (len < STATE_HEADER_SIZE ||
+        memcmp (content, STATE_MAGIC, 8) != 0 ||
+        count != (len - STATE_HEADER_SIZE) / sizeof (uint64_t) ||
+        (len - STATE_HEADER_SIZE) % sizeof (uint64_t) != 0)
+    {
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+            _("'%s' is not a state file."), path);
+        goto load_fail;
+    }
+
+    _reserve (s, count);
+    for (gsize i = 0; i < count; i++)
+    {
+        memcpy (&id, content + STATE_HEADER_SIZE + i * sizeof (id),
+            sizeof (id));
+        id = GUINT64_FROM_LE (id);
+        if (id != EMPTY_SLOT)
+            _insert_slot (s->slots, s->n_slots, id);
+    }
+    s->count = count;
+
+    g_free (content);
+    return s;
+
+    load_fail:
+    g_free (content);
+    seen_set_free (s);
+    return NULL;
+}
+
+
+/**
+ * @brief Check if record was seen before
+ * @param s The set
+ * @param id Record identity from `seen_set_identity()`
+ */
+bool
+seen_set_contains   (const seen_set  *s,
+                     uint64_t         id)
+{
+    gsize i = id & (s->n_slots - 1);
+
+    while (s->slots[i] != EMPTY_SLOT)
+    {
+        if (s->slots[i] == id)
+            return true;
+        i = (i + 1) & (s->n_slots - 1);
+    }
+    return false;
+}
+
+
+/**
+ * @brief Add record to set
+ * @param s The set
+ * @param id Record identity from `seen_set_identity()`
+ */
+void
+seen_set_add   (seen_set   *s,
+                uint64_t    id)
+{
+    if (seen_set_contains (s, id))
+        return;
+
+    _reserve (s, s->count + 1);
+    _insert_slot (s->slots, s->n_slots, id);
+    s->count++;
+    s->dirty = true;
+}
+
+
+/**
+ * @brief Replace state file with current set, if changed
+ * @param s The set
+ * @param error Location to store error upon problem
+ * @return `true` on success, `false` otherwise
+ * @note File is replaced atomically, thus either previous or
+ * current state is kept upon failure
+ */
+bool
+seen_set_save   (seen_set   *s,
+                 GError    **error)
+{
+    GString  *buf;
+    uint64_t  v;
+    bool      ret;
+
+    if (! s->dirty)
+        return true;
+
+    buf = g_string_sized_new (STATE_HEADER_SIZE +
+        s->count * sizeof (uint64_t));
+    buf = g_string_append_len (buf, STATE_MAGIC, 8);
+    v = GUINT64_TO_LE ((uint64_t) s->count);
+    buf = g_string_append_len (buf, (const char *) &v, sizeof (v));
+
+    for (gsize i = 0; i < s->n_slots; i++)
+    {
+        if (s->slots[i] == EMPTY_SLOT)
+            continue;
+        v = GUINT64_TO_LE (s->slots[i]);
+        buf = g_string_append_len (buf, (const char *) &v, sizeof (v));
+    }
+
+    ret = g_file_set_contents (s->path, buf->str, buf->len, error);
+    if (ret)
+        s->dirty = false;
+
+    g_string_free (buf, TRUE);
+    return ret;
+}
+
+
+void
+seen_set_free   (seen_set   *s)
+{
+    if (s == NULL)
+        return;
+
+    g_free (s->slots);
+    g_free (s->path);
+    g_free (s);
+}
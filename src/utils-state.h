@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <glib.h>
+
+typedef struct _seen_set seen_set;
+
+uint64_t          seen_set_identity          (const void       *key,
+                                              gsize             len,
+                                              int64_t           filetime);
+seen_set *        seen_set_load              (const char       *path,
+                                              GError          **error);
+bool              seen_set_contains          (const seen_set   *s,
+                                              uint64_t          id);
+void              seen_set_add               (seen_set         *s,
+                                              uint64_t          id);
+bool              seen_set_save              (seen_set         *s,
+                                              GError          **error);
+void              seen_set_free              (seen_set         *s);
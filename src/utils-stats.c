@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Statistics of program run, printed to stderr upon exit when
+ * requested. Time is accumulated per processing phase, with wall
+ * clock time from monotonic clock and CPU time of calling thread.
+ * When inputs are parsed on multiple threads, time of each phase is
+ * summed over threads, thus may exceed total time, which is counted
+ * from the moment statistics are requested.
+ *
+ * Spans are only taken around whole phases and counters are only
+ * updated once per file, never per record, and everything returns
+ * immediately when statistics are not requested. Phase spans are
+ * recorded in trace as well, if requested.
+ */
+
+#include <stdio.h>
+#include <glib.h>
+
+#ifdef G_OS_WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+#include "utils-conv.h"
+#include "utils-stats.h"
+#include "utils-trace.h"
+
+static const char *phase_names[STATS_N_PHASES] = {
+    "enumerate",
+    "parse",
+    "sort",
+    "output",
+};
+
+static stats_fmt    report_fmt               = STATS_NONE;
+static gint64       start_wall               = 0;
+static gint64       start_cpu                = 0;
+static gint64       phase_wall[STATS_N_PHASES];
+static gint64       phase_cpu[STATS_N_PHASES];
+static uint64_t     counters[STATS_N_COUNTERS];
+static GMutex       stats_lock;
+
+
+#ifdef G_OS_WIN32
+static gint64
+_filetime_to_usec   (const FILETIME  *ft)
+{
+    return (gint64) (((uint64_t) ft->dwHighDateTime << 32) |
+        ft->dwLowDateTime) / 10;
+}
+#endif
+
+
+/**
+ * @brief Fetch CPU time consumed by calling thread
+ * @return CPU time in microseconds
+ * @note Falls back to CPU time of whole process where per
+ * thread clock is unavailable
+ */
+static gint64
+_thread_cpu_time   (void)
+{
+#ifdef G_OS_WIN32
+    FILETIME c, e, k, u;
+
+    if (! GetThreadTimes (GetCurrentThread (), &c, &e, &k, &u))
+        return 0;
+    return _filetime_to_usec (&k) + _filetime_to_usec (&u);
+#elif defined CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if (0 != clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts))
+        return 0;
+    return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+#else
+    return (gint64) clock () * G_USEC_PER_SEC / CLOCKS_PER_SEC;
+#endif
+}
+
+
+/**
+ * @brief Fetch CPU time and peak memory usage of whole process
+ * @param cpu Location to store CPU time in microseconds
+ * @param peak_rss Location to store peak resident memory in KiB
+ */
+static void
+_process_usage   (gint64    *cpu,
+                  uint64_t  *peak_rss)
+{
+#ifdef G_OS_WIN32
+    FILETIME                 c, e, k, u;
+    PROCESS_MEMORY_COUNTERS  pmc;
+
+    *cpu = *peak_rss = 0;
+    if (GetProcessTimes (GetCurrentProcess (), &c, &e, &k, &u))
+        *cpu = _filetime_to_usec (&k) + _filetime_to_usec (&u);
+    if (K32GetProcessMemoryInfo (GetCurrentProcess (), &pmc, sizeof (pmc)))
+        *peak_rss = pmc.PeakWorkingSetSize / 1024;
+#else
+    struct rusage ru;
+
+    *cpu = *peak_rss = 0;
+    if (0 != getrusage (RUSAGE_SELF, &ru))
+        return;
+    *cpu = (gint64) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) *
+        G_USEC_PER_SEC + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+#ifdef __APPLE__
+    *peak_rss = ru.ru_maxrss / 1024;  // bytes on macOS
+#else
+    *peak_rss = ru.ru_maxrss;
+#endif
+#endif
+}
+
+
+/**
+ * @brief Start collecting statistics
+ * @param fmt Format of report printed by `stats_report()`
+ */
+void
+stats_enable   (stats_fmt   fmt)
+{
+    g_return_if_fail (fmt != STATS_NONE);
+
+    uint64_t peak_rss;
+
+    if (report_fmt == STATS_NONE)
+    {
+        start_wall = g_get_monotonic_time ();
+        _process_usage (&start_cpu, &peak_rss);
+        enable_conv_stats ();
+    }
+    report_fmt = fmt;
+}
+
+
+bool
+stats_enabled   (void)
+{
+    return report_fmt != STATS_NONE;
+}
+
+
+/**
+ * @brief Mark start of a timed span
+ * @param span Location to store starting time
+ */
+void
+stats_span_begin   (stats_span  *span)
+{
+    if (report_fmt == STATS_NONE && ! trace_enabled ())
+        return;
+
+    span->wall = g_get_monotonic_time ();
+    span->cpu  = (report_fmt == STATS_NONE) ? 0 : _thread_cpu_time ();
+}
+
+
+/**
+ * @brief Mark end of a timed span, adding time spent to phase
+ * @param span Span started with `stats_span_begin()` on same thread
+ * @param phase The phase where time spent is accounted
+ */
+void
+stats_span_end   (const stats_span  *span,
+                  stats_phase        phase)
+{
+    gint64 wall, cpu;
+
+    if (trace_enabled ())
+        trace_end (span->wall, phase_names[phase], NULL);
+
+    if (report_fmt == STATS_NONE)
+        return;
+
+    wall = g_get_monotonic_time () - span->wall;
+    cpu  = _thread_cpu_time () - span->cpu;
+
+    g_mutex_lock (&stats_lock);
+    phase_wall[phase] += wall;
+    phase_cpu[phase]  += cpu;
+    g_mutex_unlock (&stats_lock);
+}
+
+
+/**
+ * @brief Increment a counter
+ * @param counter The counter to update
+ * @param n Amount to add
+ */
+void
+stats_count   (stats_counter  counter,
+               uint64_t       n)
+{
+    if (report_fmt == STATS_NONE)
+        return;
+
+    g_mutex_lock (&stats_lock);
+    counters[counter] += n;
+    g_mutex_unlock (&stats_lock);
+}
+
+
+/* Format microseconds as milliseconds without locale dependency */
+static const char *
+_msec_str   (char    *buf,
+             gsize    len,
+             gint64   usec)
+{
+    snprintf (buf, len, "%" PRId64 ".%03d",
+        usec / 1000, (int) (usec % 1000));
+    return buf;
+}
+
+
+static void
+_report_text   (const conv_stats  *cs,
+                gint64             wall,
+                gint64             cpu,
+                uint64_t           peak_rss)
+{
+    char w[32], c[32];
+
+    g_printerr ("Statistics:\n");
+    g_printerr ("  %-14s %12s %12s\n", "Phase", "Wall (ms)", "CPU (ms)");
+    for (int i = 0; i < STATS_N_PHASES; i++)
+        g_printerr ("  %-14s %12s %12s\n", phase_names[i],
+            _msec_str (w, sizeof (w), phase_wall[i]),
+            _msec_str (c, sizeof (c), phase_cpu[i]));
+    g_printerr ("  %-14s %12s %12s\n", "(convert)",
+        _msec_str (w, sizeof (w), cs->wall), "-");
+    g_printerr ("  %-14s %12s %12s\n", "total",
+        _msec_str (w, sizeof (w), wall),
+        _msec_str (c, sizeof (c), cpu));
+
+    g_printerr ("  Files opened: %" PRIu64 ", bytes read: %" PRIu64 "\n",
+        counters[STATS_FILES_OPENED], counters[STATS_BYTES_READ]);
+    g_printerr ("  Records parsed: %" PRIu64 ", emitted: %" PRIu64
+        ", invalid: %" PRIu64 "\n", counters[STATS_RECORDS_PARSED],
+        counters[STATS_RECORDS_EMITTED], counters[STATS_RECORDS_INVALID]);
+    g_printerr ("  Paths converted: %" PRIu64 ", fallback chars: %"
+        PRIu64 "\n", cs->paths, cs->fallbacks);
+    g_printerr ("  Peak RSS: %" PRIu64 " KiB\n", peak_rss);
+}
+
+
+static void
+_report_json   (const conv_stats  *cs,
+                gint64             wall,
+                gint64             cpu,
+                uint64_t           peak_rss)
+{
+    GString *s = g_string_new ("{\"phases\": {");
+
+    for (int i = 0; i < STATS_N_PHASES; i++)
+        g_string_append_printf (s, "\"%s\": {\"wall_us\": %"
+            PRId64 ", \"cpu_us\": %" PRId64 "}, ",
+            phase_names[i], phase_wall[i], phase_cpu[i]);
+    g_string_append_printf (s, "\"convert\": {\"wall_us\": %"
+        PRId64 "}}, ", cs->wall);
+
+    g_string_append_printf (s, "\"total\": {\"wall_us\": %" PRId64
+        ", \"cpu_us\": %" PRId64 "}, ", wall, cpu);
+    g_string_append_printf (s, "\"files_opened\": %" PRIu64 ", "
+        "\"bytes_read\": %" PRIu64 ", ",
+        counters[STATS_FILES_OPENED], counters[STATS_BYTES_READ]);
+    g_string_append_printf (s, "\"records\": {\"parsed\": %" PRIu64 ", "
+        "\"emitted\": %" PRIu64 ", \"invalid\": %" PRIu64 "}, ",
+        counters[STATS_RECORDS_PARSED], counters[STATS_RECORDS_EMITTED],
+        counters[STATS_RECORDS_INVALID]);
+    g_string_append_printf (s, "\"conversion\": {\"paths\": %" PRIu64 ", "
+        "\"fallback_chars\": %" PRIu64 "}, ", cs->paths, cs->fallbacks);
+    g_string_append_printf (s, "\"peak_rss_kib\": %" PRIu64 "}", peak_rss);
+
+    g_printerr ("%s\n", s->str);
+    g_string_free (s, TRUE);
+}
+
+
+/**
+ * @brief Print collected statistics to stderr, if requested
+ * @note Path conversion happens during output, so its time is
+ * part of output phase as well
+ */
+void
+stats_report   (void)
+{
+    gint64    wall, cpu;
+    uint64_t  peak_rss;
+
+    if (report_fmt == STATS_NONE)
+        return;
+
+    wall = g_get_monotonic_time () - start_wall;
+    _process_usage (&cpu, &peak_rss);
+    cpu -= start_cpu;
+
+    if (report_fmt == STATS_JSON)
+        _report_json (get_conv_stats (), wall, cpu, peak_rss);
+    else
+        _report_text (get_conv_stats (), wall, cpu, peak_rss);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <glib.h>
+
+typedef enum
+{
+    STATS_NONE,
+    STATS_TEXT,
+    STATS_JSON,
+} stats_fmt;
+
+typedef enum
+{
+    STATS_PHASE_ENUMERATE,  /*!< Checking inputs, finding index files */
+    STATS_PHASE_PARSE,      /*!< Reading and parsing index files */
+    STATS_PHASE_SORT,       /*!< Post processing, such as sorting */
+    STATS_PHASE_OUTPUT,     /*!< Formatting and writing records */
+    STATS_N_PHASES,
+} stats_phase;
+
+typedef enum
+{
+    STATS_FILES_OPENED,
+    STATS_BYTES_READ,
+    STATS_RECORDS_PARSED,
+    STATS_RECORDS_EMITTED,
+    STATS_RECORDS_INVALID,
+    STATS_N_COUNTERS,
+} stats_counter;
+
+/* Start of a timed span, see stats_span_begin() */
+typedef struct _stats_span
+{
+    gint64   wall;
+    gint64   cpu;
+} stats_span;
+
+void              stats_enable               (stats_fmt         fmt);
+bool              stats_enabled              (void);
+void              stats_span_begin           (stats_span       *span);
+void              stats_span_end             (const stats_span *span,
+                                              stats_phase       phase);
+void              stats_count                (stats_counter     counter,
+                                              uint64_t          n);
+void              stats_report               (void);
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Timeline of program run in Chrome trace event format, viewable
+ * with Perfetto or chrome://tracing. Each thread records completed
+ * spans into its own ring buffer without any locking, so that
+ * tracing barely disturbs what is being traced; oldest spans are
+ * overwritten when a thread records too many. All buffers are only
+ * written out upon exit.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <inttypes.h>
+
+#include "utils-trace.h"
+
+/* Maximum spans kept for each thread */
+#define TRACE_RING_SIZE     (1 << 16)
+
+/* Longer span details only keep their tail, which is the more
+ * distinctive part of file paths */
+#define TRACE_DETAIL_MAX    96
+
+typedef struct _trace_event
+{
+    gint64       ts;
+    gint64       dur;
+    const char  *name;
+    char         detail[TRACE_DETAIL_MAX];
+} trace_event;
+
+typedef struct _trace_buf
+{
+    guint        tid;
+    bool         is_main;
+    trace_event *events;
+    gsize        alloc;     /* grows on demand up to TRACE_RING_SIZE */
+    gsize        len;
+    gsize        head;      /* oldest event once ring is full */
+    uint64_t     dropped;
+} trace_buf;
+
+static char        *trace_path               = NULL;
+static gint64       start_time               = 0;
+static GThread     *main_thread              = NULL;
+static GPtrArray   *all_bufs                 = NULL;
+static GMutex       bufs_lock;
+
+/* Buffers are owned by all_bufs, since threads of pool may
+ * exit before trace is written */
+static GPrivate     thread_buf               = G_PRIVATE_INIT (NULL);
+
+
+/**
+ * @brief Start recording spans
+ * @param path File where trace is written by `trace_finish()`
+ */
+void
+trace_start   (const char  *path)
+{
+    g_return_if_fail (path && *path);
+
+    g_free (trace_path);
+    trace_path = g_strdup (path);
+    if (all_bufs)
+        return;
+
+    start_time = g_get_monotonic_time ();
+    main_thread = g_thread_self ();
+    all_bufs = g_ptr_array_new ();
+}
+
+
+bool
+trace_enabled   (void)
+{
+    return trace_path != NULL;
+}
+
+
+/**
+ * @brief Mark start of a span
+ * @return Starting time to be passed to `trace_end()`, or 0
+ * if not tracing
+ */
+gint64
+trace_begin   (void)
+{
+    if (trace_path == NULL)
+        return 0;
+    return g_get_monotonic_time ();
+}
+
+
+static trace_buf *
+_get_thread_buf   (void)
+{
+    trace_buf *b = g_private_get (&thread_buf);
+
+    if (b)
+        return b;
+
+    b = g_new0 (trace_buf, 1);
+    b->is_main = (g_thread_self () == main_thread);
+
+    g_mutex_lock (&bufs_lock);
+    b->tid = all_bufs->len + 1;
+    g_ptr_array_add (all_bufs, b);
+    g_mutex_unlock (&bufs_lock);
+
+    g_private_set (&thread_buf, b);
+    return b;
+}
+
+
+/**
+ * @brief Record a completed span on calling thread
+ * @param start Starting time returned by `trace_begin()`
+ * @param name Name of span, must be a static string
+ * @param detail_fmt `printf` style format of span detail, or `NULL`
+ */
+void
+trace_end   (gint64       start,
+             const char  *name,
+             const char  *detail_fmt,
+             ...)
+{
+    trace_buf   *b;
+    trace_event *e;
+    gint64       now;
+
+    if (trace_path == NULL)
+        return;
+
+    now = g_get_monotonic_time ();
+    b = _get_thread_buf ();
+
+    if (b->len < b->alloc)
+        e = &b->events[b->len++];
+    else if (b->alloc < TRACE_RING_SIZE)
+    {
+        b->alloc = b->alloc ? b->alloc * 2 : 256;
+        b->events = g_renew (trace_event, b->events, b->alloc);
+        e = &b->events[b->len++];
+    }
+    else
+    {
+        e = &b->events[b->head];
+        b->head = (b->head + 1) % TRACE_RING_SIZE;
+        b->dropped++;
+    }
+
+    e->ts   = start - start_time;
+    e->dur  = now - start;
+    e->name = name;
+    e->detail[0] = '\0';
+
+    if (detail_fmt)
+    {
+        char    tmp[1024];
+        va_list args;
+        int     n;
+
+        va_start (args, detail_fmt);
+        n = vsnprintf (tmp, sizeof (tmp), detail_fmt, args);
+        va_end (args);
+
+        n = CLAMP (n, 0, (int) sizeof (tmp) - 1);
+        g_strlcpy (e->detail,
+            tmp + MAX (0, n - (TRACE_DETAIL_MAX - 1)), TRACE_DETAIL_MAX);
+    }
+}
+
+
+static void
+_append_json_str   (GString     *s,
+                    const char  *str)
+{
+    g_string_append_c (s, '"');
+    for (const char *p = str; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            g_string_append_c (s, '\\');
+        if ((guchar) *p < 0x20)
+            g_string_append_printf (s, "\\u%04x", (guchar) *p);
+        else
+            g_string_append_c (s, *p);
+    }
+    g_string_append_c (s, '"');
+}
+
+
+static void
+_append_events   (GString          *s,
+                  const trace_buf  *b)
+{
+    g_string_append_printf (s, "{\"name\": \"thread_name\", \"ph\": \"M\", "
+        "\"pid\": 1, \"tid\": %u, \"args\": {\"name\": ", b->tid);
+    if (b->is_main)
+        g_string_append (s, "\"main\"}},\n");
+    else
+        g_string_append_printf (s, "\"worker %u\"}},\n", b->tid);
+
+    for (gsize i = 0; i < b->len; i++)
+    {
+        const trace_event *e = &b->events[(b->head + i) % b->len];
+
+        g_string_append (s, "{\"name\": ");
+        _append_json_str (s, e->name);
+        g_string_append_printf (s, ", \"cat\": \"rifiuti\", \"ph\": \"X\", "
+            "\"ts\": %" PRId64 ", \"dur\": %" PRId64 ", \"pid\": 1, "
+            "\"tid\": %u", (int64_t) e->ts, (int64_t) e->dur, b->tid);
+        if (e->detail[0])
+        {
+            char *detail = g_filename_display_name (e->detail);
+
+            g_string_append (s, ", \"args\": {\"detail\": ");
+            _append_json_str (s, detail);
+            g_string_append_c (s, '}');
+            g_free (detail);
+        }
+        g_string_append (s, "},\n");
+    }
+}
+
+
+/**
+ * @brief Write all recorded spans to trace file and stop tracing
+ * @param error Location to store error upon failure
+ * @return `true` if trace is written or not requested at all,
+ * `false` otherwise
+ * @note Must only be called after all other threads are done
+ */
+bool
+trace_finish   (GError  **error)
+{
+    GString  *s;
+    uint64_t  dropped = 0;
+    bool      ret;
+
+    if (trace_path == NULL)
+        return true;
+
+    s = g_string_new ("{\"traceEvents\": [\n");
+    for (guint i = 0; i < all_bufs->len; i++)
+    {
+        trace_buf *b = all_bufs->pdata[i];
+
+        _append_events (s, b);
+        dropped += b->dropped;
+        g_free (b->events);
+        g_free (b);
+    }
+
+    // Trailing comma is not allowed in JSON
+    if (s->str[s->len - 2] == ',')
+        g_string_truncate (s, s->len - 2);
+    g_string_append_printf (s, "\n], \"displayTimeUnit\": \"ms\", "
+        "\"otherData\": {\"dropped_events\": \"%" PRIu64 "\"}}\n", dropped);
+
+    ret = g_file_set_contents (trace_path, s->str, (gssize) s->len, error);
+
+    g_string_free (s, TRUE);
+    g_ptr_array_free (all_bufs, TRUE);
+    all_bufs = NULL;
+    g_clear_pointer (&trace_path, g_free);
+    return ret;
+}
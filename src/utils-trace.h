@@ -0,0 +1,19 @@
+/*
+ * Copyright (C) 2024, Abel Cheung.
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <glib.h>
+
+void              trace_start                (const char       *path);
+bool              trace_enabled              (void);
+gint64            trace_begin                (void);
+void              trace_end                  (gint64            start,
+                                              const char       *name,
+                                              const char       *detail_fmt,
+                                              ...) G_GNUC_PRINTF (3, 4);
+bool              trace_finish               (GError          **error);
@@ -7,18 +7,38 @@
 #include "config.h"
 
 #include <locale.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
 #include <glib/gi18n.h>
 
+#include "utils-arrow.h"
+#include "utils-cache.h"
 #include "utils-conv.h"
+#include "utils-debug.h"
 #include "utils-error.h"
 #include "utils-io.h"
+#include "utils-state.h"
+#include "utils-progress.h"
+#include "utils-stats.h"
+#include "utils-trace.h"
 #include "utils.h"
 #include "utils-platform.h"
+#include "librifiuti-private.h"
 
-/* Our own error domain */
+#ifdef HAVE_SQLITE
+#include "utils-sqlite.h"
+#endif
+
+#ifdef G_OS_UNIX
+#include "utils-serve.h"
+#endif
+
+/* Formatted records are written out when buffer grows beyond this size */
+#define OUT_BUFFER_FLUSH_SIZE   (64 * 1024)
 
-G_DEFINE_QUARK (rifiuti-fatal-error-quark, rifiuti_fatal_error)
-G_DEFINE_QUARK (rifiuti-record-error-quark, rifiuti_record_error)
+/* Time between checks of INFO2 file being followed, in microseconds */
+#define FOLLOW_INTERVAL         (G_USEC_PER_SEC / 2)
 
 /* Common function signature for option callbacks */
 #define DECL_OPT_CALLBACK(func)          \
@@ -30,6 +50,10 @@ static gboolean func (       \
 
 DECL_OPT_CALLBACK(_check_legacy_encoding);
 DECL_OPT_CALLBACK(_set_output_path);
+DECL_OPT_CALLBACK(_set_opt_compress);
+DECL_OPT_CALLBACK(_set_opt_progress);
+DECL_OPT_CALLBACK(_set_opt_stats);
+DECL_OPT_CALLBACK(_set_opt_trace);
 DECL_OPT_CALLBACK(_option_deprecated);
 DECL_OPT_CALLBACK(_set_opt_delim);
 DECL_OPT_CALLBACK(_set_opt_noheading);
@@ -45,6 +69,12 @@ _check_file_args (const char  *path,
                   bool        *isolated_index,
                   GError     **error);
 
+static bool
+_find_bins_recursive (const char  *root,
+                      rbin_type    type,
+                      GPtrArray   *list,
+                      GError     **error);
+
 
 /**
  * @brief More detailed OS version guess from artifacts
@@ -89,13 +119,38 @@ static out_fmt      output_format      = FORMAT_UNKNOWN;
 static bool         no_heading         = false;
 static gboolean     use_localtime      = FALSE;
 static gboolean     live_mode          = FALSE;
+#ifdef __linux__
+static gboolean     watch_mode         = FALSE;
+#endif
 static char        *delim              = NULL;
 static char        *output_loc         = NULL;
+static compress_type compress_method   = COMPRESS_NONE;
+static bool         compress_set       = false;
 static char       **fileargs           = NULL;
-       GPtrArray   *allidxfiles        = NULL;
-       bool         isolated_index     = false;
-       char        *legacy_encoding    = NULL; /*!< INFO2 only, or upon request */
+static char        *files_from         = NULL;
+static char        *recursive_root     = NULL;
+static char        *carve_path         = NULL;
+static char        *cache_dir          = NULL;
+static char        *state_path         = NULL;
+static gboolean     follow_mode        = FALSE;
+static seen_set    *seen_records       = NULL;
+static GPtrArray   *inputs             = NULL;
+static bool         batch_mode         = false;
+static exitcode     batch_status       = EXIT_OK;
+static GString     *out_buffer         = NULL;
+static arrow_writer *arrow_out         = NULL;
+#ifdef G_OS_UNIX
+static char        *serve_path         = NULL;
+static char        *serve_encoding     = NULL;
+static bool         in_request         = false;
+static char        *usage_param_str    = NULL;
+static char        *usage_summary_str  = NULL;
+#endif
+static GPtrArray   *allidxfiles        = NULL;
+static char        *legacy_encoding    = NULL; /*!< INFO2 only, or upon request */
        metarecord  *meta               = NULL;
+static r2_context  *parse_ctx          = NULL; /*!< settings seen by parsers */
+static rbin_cache  *idx_cache          = NULL; /*!< $Recycle.bin only */
 
 
 /* Options controlling output format */
@@ -118,7 +173,7 @@ static const GOptionEntry out_options[] = {
     {
         "format", 'f', 0,
         G_OPTION_ARG_CALLBACK, _set_opt_format,
-        N_("'text' (default), 'xml' or 'json'"), N_("FORMAT")
+        N_("'text' (default), 'xml', 'json', 'jsonl', 'arrow' or 'sqlite'"), N_("FORMAT")
     },
     { 0 }
 };
@@ -130,12 +185,56 @@ static const GOptionEntry main_options[] = {
         G_OPTION_ARG_CALLBACK, _set_output_path,
         N_("Write output to FILE"), N_("FILE")
     },
+    {
+        "compress", 0, 0,
+        G_OPTION_ARG_CALLBACK, _set_opt_compress,
+        N_("Compress output with 'gzip', 'zstd' or 'none' [guessed from "
+           "output file extension if not given]"), N_("METHOD")
+    },
     {
         "localtime", 'z', 0,
         G_OPTION_ARG_NONE, &use_localtime,
         N_("Present deletion time in time zone of local system (default is UTC)"),
         NULL
     },
+    {
+        "files-from", 0, 0,
+        G_OPTION_ARG_FILENAME, &files_from,
+        N_("Read NUL-delimited list of inputs from FILE ('-' for "
+           "standard input)"), N_("FILE")
+    },
+    {
+        "recursive", 0, 0,
+        G_OPTION_ARG_FILENAME, &recursive_root,
+        N_("Search all recycle bins under ROOT folder, such as a "
+           "mounted disk image"), N_("ROOT")
+    },
+    {
+        "since-state", 0, 0,
+        G_OPTION_ARG_FILENAME, &state_path,
+        N_("Only output records not seen in previous runs, and "
+           "remember them in state FILE"), N_("FILE")
+    },
+    {
+        "progress", 0, G_OPTION_FLAG_OPTIONAL_ARG,
+        G_OPTION_ARG_CALLBACK, _set_opt_progress,
+        N_("Show progress periodically on stderr; WHEN can be 'auto' "
+           "(default, only if stderr is a terminal) or 'always'"),
+        N_("WHEN")
+    },
+    {
+        "stats", 0, G_OPTION_FLAG_OPTIONAL_ARG,
+        G_OPTION_ARG_CALLBACK, _set_opt_stats,
+        N_("Print time spent in each processing phase and other "
+           "statistics to stderr upon exit, in 'text' (default) "
+           "or 'json' FORMAT"), N_("FORMAT")
+    },
+    {
+        "trace", 0, G_OPTION_FLAG_FILENAME,
+        G_OPTION_ARG_CALLBACK, _set_opt_trace,
+        N_("Record timeline of processing in Chrome trace event "
+           "format, and write to FILE upon exit"), N_("FILE")
+    },
     {
         "version", 'v', G_OPTION_FLAG_NO_ARG,
         G_OPTION_ARG_CALLBACK, _show_ver_and_exit,
@@ -157,6 +256,55 @@ static const GOptionEntry rbinfile_options[] = {
         N_("Show legacy (8.3) path if available and specify its CODEPAGE"),
         N_("CODEPAGE")
     },
+    {
+        "follow", 0, 0,
+        G_OPTION_ARG_NONE, &follow_mode,
+        N_("Keep checking INFO2 file after output, and output "
+           "records as soon as they are appended"), NULL
+    },
+    { 0 }
+};
+
+/* Options only intended for $Recycle.bin reader */
+static const GOptionEntry rbindir_options[] = {
+    {
+        "cache", 0, 0,
+        G_OPTION_ARG_FILENAME, &cache_dir,
+        N_("Keep parsed index files in DIR, so that unchanged ones "
+           "are not parsed again in later runs"), N_("DIR")
+    },
+#ifdef __linux__
+    {
+        "watch", 0, 0,
+        G_OPTION_ARG_NONE, &watch_mode,
+        N_("Keep watching folders after initial scan, and output "
+           "records as soon as they change"), NULL
+    },
+#endif
+    { 0 }
+};
+
+#ifdef G_OS_UNIX
+/* Options for resident process serving other clients */
+static const GOptionEntry serve_options[] = {
+    {
+        "serve", 0, 0,
+        G_OPTION_ARG_FILENAME, &serve_path,
+        N_("Keep running and parse recycle bins upon request from "
+           "clients connecting to Unix domain SOCKET"), N_("SOCKET")
+    },
+    { 0 }
+};
+#endif
+
+/* Options for recovering records without intact recycle bin */
+static const GOptionEntry carve_options[] = {
+    {
+        "carve", 0, 0,
+        G_OPTION_ARG_FILENAME, &carve_path,
+        N_("Carve index records from raw disk IMAGE or memory dump, "
+           "instead of reading recycle bin"), N_("IMAGE")
+    },
     { 0 }
 };
 
@@ -214,6 +362,22 @@ _set_opt_format   (const gchar *opt_name,
         return _set_out_format (FORMAT_XML, error);
     else if (g_strcmp0 (format, "json") == 0)
         return _set_out_format (FORMAT_JSON, error);
+    else if (g_strcmp0 (format, "jsonl") == 0)
+        return _set_out_format (FORMAT_JSONL, error);
+    else if (g_strcmp0 (format, "ndjson") == 0)
+        return _set_out_format (FORMAT_JSONL, error);
+    else if (g_strcmp0 (format, "arrow") == 0)
+        return _set_out_format (FORMAT_ARROW, error);
+    else if (g_strcmp0 (format, "sqlite") == 0)
+    {
+#ifdef HAVE_SQLITE
+        return _set_out_format (FORMAT_SQLITE, error);
+#else
+        g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+            _("SQLite output is not supported in this build"));
+        return FALSE;
+#endif
+    }
     else {
         g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
             "Illegal output format '%s'", format);
@@ -255,15 +419,14 @@ _set_opt_delim (const gchar *opt_name,
     UNUSED(opt_name);
     UNUSED(data);
 
-    static bool seen = false;
-
-    if (seen)
+    // Not a static flag, which would outlive reset done for
+    // each served request
+    if (delim)
     {
         g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
             _("Multiple delimiter options disallowed."));
         return FALSE;
     }
-    seen = true;
 
     delim = (*value) ? filter_escapes (value) : g_strdup ("");
 
@@ -274,7 +437,7 @@ _set_opt_delim (const gchar *opt_name,
 /**
  * @brief Option callback to set output file location
  * @return `FALSE` if duplicate options are found, or
- * output file location already exists. `TRUE` otherwise.
+ * output file location already exists as a file. `TRUE` otherwise.
  */
 static gboolean
 _set_output_path (const gchar *opt_name,
@@ -285,15 +448,12 @@ _set_output_path (const gchar *opt_name,
     UNUSED(opt_name);
     UNUSED(data);
 
-    static bool seen = false;
-
-    if (seen)
+    if (output_loc)
     {
         g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
             _("Multiple output destinations disallowed."));
         return FALSE;
     }
-    seen = true;
 
     if ( *value == '\0' )
     {
@@ -302,7 +462,10 @@ _set_output_path (const gchar *opt_name,
         return FALSE;
     }
 
-    if (g_file_test (value, G_FILE_TEST_EXISTS)) {
+    // Existing folder is fine when there are multiple inputs,
+    // which is only known after all arguments are handled
+    if (g_file_test (value, G_FILE_TEST_EXISTS) &&
+        ! g_file_test (value, G_FILE_TEST_IS_DIR)) {
         g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
             _("Output destinations already exists."));
         return FALSE;
@@ -313,6 +476,110 @@ _set_output_path (const gchar *opt_name,
 }
 
 
+/**
+ * @brief Option callback to set output compression method
+ * @return `FALSE` if compression method is unknown, `TRUE` otherwise
+ */
+static gboolean
+_set_opt_compress (const gchar *opt_name,
+                   const gchar *value,
+                   gpointer     data,
+                   GError     **error)
+{
+    UNUSED(opt_name);
+    UNUSED(data);
+
+    if (g_strcmp0 (value, "none") == 0)
+        compress_method = COMPRESS_NONE;
+    else if (g_strcmp0 (value, "gzip") == 0 || g_strcmp0 (value, "gz") == 0)
+        compress_method = COMPRESS_GZIP;
+    else if (g_strcmp0 (value, "zstd") == 0 || g_strcmp0 (value, "zst") == 0)
+        compress_method = COMPRESS_ZSTD;
+    else
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+            _("Illegal compression method '%s'"), value);
+        return FALSE;
+    }
+
+    compress_set = true;
+    return TRUE;
+}
+
+
+/**
+ * @brief Option callback to show progress during processing
+ * @return `FALSE` if argument is unknown, `TRUE` otherwise
+ */
+static gboolean
+_set_opt_progress (const gchar *opt_name,
+                   const gchar *value,
+                   gpointer     data,
+                   GError     **error)
+{
+    UNUSED(opt_name);
+    UNUSED(data);
+
+    if (value == NULL || g_strcmp0 (value, "auto") == 0)
+        progress_start (false);
+    else if (g_strcmp0 (value, "always") == 0)
+        progress_start (true);
+    else
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+            _("Illegal progress option '%s'"), value);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+/**
+ * @brief Option callback to request statistics upon exit
+ * @return `FALSE` if report format is unknown, `TRUE` otherwise
+ */
+static gboolean
+_set_opt_stats (const gchar *opt_name,
+                const gchar *value,
+                gpointer     data,
+                GError     **error)
+{
+    UNUSED(opt_name);
+    UNUSED(data);
+
+    if (value == NULL || g_strcmp0 (value, "text") == 0)
+        stats_enable (STATS_TEXT);
+    else if (g_strcmp0 (value, "json") == 0)
+        stats_enable (STATS_JSON);
+    else
+    {
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+            _("Illegal statistics format '%s'"), value);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+/**
+ * @brief Option callback to record trace of processing
+ * @return Always `TRUE`; trace file is only written upon exit
+ */
+static gboolean
+_set_opt_trace (const gchar *opt_name,
+                const gchar *value,
+                gpointer     data,
+                GError     **error)
+{
+    UNUSED(opt_name);
+    UNUSED(data);
+    UNUSED(error);
+
+    trace_start (value);
+    return TRUE;
+}
+
+
 /**
  * @brief Emits warning when an argument is marked as deprecated
  * @return Always `TRUE`
@@ -348,16 +615,14 @@ _check_legacy_encoding (const gchar *opt_name,
     UNUSED(opt_name);
     UNUSED(data);
 
-    static bool seen     = false;
     GError     *conv_err = NULL;
 
-    if (seen)
+    if (legacy_encoding)
     {
         g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
             _("Multiple encoding options disallowed."));
         return FALSE;
     }
-    seen = true;
 
     if ( *enc == '\0' )
     {
@@ -366,6 +631,15 @@ _check_legacy_encoding (const gchar *opt_name,
         return FALSE;
     }
 
+#ifdef G_OS_UNIX
+    // Already tried out when server starts
+    if (g_strcmp0 (enc, serve_encoding) == 0)
+    {
+        legacy_encoding = g_strdup (enc);
+        return TRUE;
+    }
+#endif
+
     if (enc_is_ascii_compatible (enc, &conv_err))
     {
         legacy_encoding = g_strdup (enc);
@@ -428,10 +702,72 @@ _show_ver_and_exit (const gchar *opt_name,
 }
 
 
+/**
+ * @brief Append NUL-delimited list of inputs stored in file
+ * @param path File containing list, or `-` for standard input
+ * @param list Array to append inputs to
+ * @param error Location to store error upon problem
+ * @return `TRUE` if list is read successfully, `FALSE` otherwise
+ * @note Empty entries are skipped, so that list can be terminated
+ * with NUL character or not
+ */
+static bool
+_read_files_from   (const char   *path,
+                    GPtrArray    *list,
+                    GError      **error)
+{
+    char   *content = NULL, *p, *end;
+    gsize   len = 0;
+
+    if (g_strcmp0 (path, "-") == 0)
+    {
+        GString *buf = g_string_new (NULL);
+        char     chunk[4096];
+        size_t   n;
+
+        while ((n = fread (chunk, 1, sizeof (chunk), stdin)) > 0)
+            g_string_append_len (buf, chunk, n);
+
+        if (ferror (stdin))
+        {
+            g_set_error_literal (error, G_OPTION_ERROR,
+                G_OPTION_ERROR_FAILED,
+                _("Failed to read input list from standard input"));
+            g_string_free (buf, TRUE);
+            return false;
+        }
+        len = buf->len;
+        content = g_string_free (buf, FALSE);
+    }
+    else
+    {
+        GError *err = NULL;
+
+        if (! g_file_get_contents (path, &content, &len, &err))
+        {
+            g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+                _("Can not read input list: %s"), err->message);
+            g_error_free (err);
+            return false;
+        }
+    }
+
+    for (p = content, end = content + len; p < end; p += strlen (p) + 1)
+        if (*p != '\0')
+            g_ptr_array_add (list, g_strdup (p));
+
+    g_free (content);
+    return true;
+}
+
+
 /**
  * @brief File argument check callback, after handling all arguments
- * @return `TRUE` if a unique file argument is used under common scenario,
- * or no file argument is provided in live mode. `FALSE` otherwise.
+ * @return `TRUE` if at least one file argument is used under common
+ * scenario, or no file argument is provided in live mode.
+ * `FALSE` otherwise.
+ * @note When there are multiple inputs, they are only checked
+ * during processing, since each one is handled independently.
  */
 static gboolean
 _fileargs_handler (GOptionContext *context,
@@ -442,23 +778,183 @@ _fileargs_handler (GOptionContext *context,
     UNUSED (context);
     UNUSED (group);
 
-    gsize fileargs_len = fileargs ? g_strv_length (fileargs) : 0;
+    gsize      fileargs_len = fileargs ? g_strv_length (fileargs) : 0;
+    stats_span span;
+    gboolean   ret;
+
+#ifdef G_OS_UNIX
+    if (in_request && (serve_path || output_loc))
+    {
+        g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+            _("Output of request can only be sent back to client."));
+        return FALSE;
+    }
+
+    if (serve_path)
+    {
+        if (fileargs_len || files_from || recursive_root || carve_path ||
+#ifdef __linux__
+            watch_mode ||
+#endif
+            live_mode || follow_mode || output_loc || state_path ||
+            use_localtime || progress_on || stats_enabled () ||
+            trace_enabled ())
+        {
+            g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+                _("Serve mode only accepts inputs and output options "
+                "from each request."));
+            return FALSE;
+        }
+
+        // Shared by all requests
+        if (cache_dir &&
+            NULL == (idx_cache = rbin_cache_open (cache_dir, error)))
+            return FALSE;
+        return TRUE;
+    }
+#endif
+
+#ifdef __linux__
+    if (watch_mode &&
+        (carve_path || live_mode || recursive_root || output_loc || state_path))
+    {
+        g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+            _("Watch mode only accepts folder arguments, and only "
+            "writes to standard output."));
+        return FALSE;
+    }
+#endif
+
+    if (follow_mode && (carve_path || recursive_root || output_loc ||
+        state_path || files_from || fileargs_len != 1))
+    {
+        g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+            _("Follow mode only accepts single file argument, and only "
+            "writes to standard output."));
+        return FALSE;
+    }
+
+    if (state_path && NULL == (seen_records = seen_set_load (state_path, error)))
+        return FALSE;
+
+    if (carve_path)
+    {
+        if (live_mode || fileargs_len || files_from || recursive_root)
+        {
+            g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+                _("Carving must not be used together with other inputs."));
+            return FALSE;
+        }
+
+        if (output_loc && g_file_test (output_loc, G_FILE_TEST_EXISTS))
+        {
+            g_set_error_literal (error, G_OPTION_ERROR,
+                G_OPTION_ERROR_BAD_VALUE,
+                _("Output destinations already exists."));
+            return FALSE;
+        }
+
+        // Image is only mapped upon processing
+        meta->filename = g_strdup (carve_path);
+        meta->carved = true;
+        return TRUE;
+    }
+
+    // Cache of server takes precedence over that of request
+    if (cache_dir && idx_cache == NULL &&
+        NULL == (idx_cache = rbin_cache_open (cache_dir, error)))
+        return FALSE;
+
+#ifdef __linux__
+    // Folders are only scanned when watch starts, so that
+    // nothing changed in between is missed
+    if (watch_mode)
+    {
+        inputs = g_ptr_array_new_with_free_func (g_free);
+        for (gsize i = 0; i < fileargs_len; i++)
+            g_ptr_array_add (inputs, g_strdup (fileargs[i]));
+
+        if (files_from && ! _read_files_from (files_from, inputs, error))
+            return FALSE;
+
+        if (inputs->len == 0)
+        {
+            g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+                _("Must specify at least one file or folder argument."));
+            return FALSE;
+        }
+
+        for (guint i = 0; i < inputs->len; i++)
+        {
+            if (g_file_test (inputs->pdata[i], G_FILE_TEST_IS_DIR))
+                continue;
+            g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOTDIR,
+                _("'%s' is not a folder."), (char *) inputs->pdata[i]);
+            return FALSE;
+        }
+
+        meta->filename = (inputs->len == 1) ?
+            g_strdup (inputs->pdata[0]) : g_strdup (_("(multiple folders)"));
+        return TRUE;
+    }
+#endif
 
     if (!live_mode)
     {
-        if (fileargs_len != 1)
+        inputs = g_ptr_array_new_with_free_func (g_free);
+        for (gsize i = 0; i < fileargs_len; i++)
+            g_ptr_array_add (inputs, g_strdup (fileargs[i]));
+
+        if (files_from && ! _read_files_from (files_from, inputs, error))
+            return FALSE;
+
+        if (recursive_root && ! _find_bins_recursive (recursive_root,
+            meta->type, inputs, error))
+            return FALSE;
+
+        if (inputs->len == 0)
         {
             g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
-                _("Must specify exactly one file or folder argument."));
+                _("Must specify at least one file or folder argument."));
+            return FALSE;
+        }
+
+        // Recursive search always uses output folder, even if only
+        // one recycle bin is found, so that output location is
+        // predictable for automation
+        if (inputs->len > 1 || recursive_root)
+        {
+            // One output file per input, placed inside output folder
+            if (output_loc == NULL)
+            {
+                g_set_error_literal (error, G_OPTION_ERROR,
+                    G_OPTION_ERROR_FAILED,
+                    _("Multiple inputs require output folder "
+                    "('-o' option)."));
+                return FALSE;
+            }
+            batch_mode = true;
+            return TRUE;
+        }
+
+        if (output_loc && g_file_test (output_loc, G_FILE_TEST_EXISTS))
+        {
+            g_set_error_literal (error, G_OPTION_ERROR,
+                G_OPTION_ERROR_BAD_VALUE,
+                _("Output destinations already exists."));
             return FALSE;
         }
-        meta->filename = g_strdup (fileargs[0]);
 
-        return _check_file_args (meta->filename, allidxfiles,
-            meta->type, &isolated_index, error);
+        meta->filename = g_strdup (inputs->pdata[0]);
+
+        stats_span_begin (&span);
+        ret = _check_file_args (meta->filename, allidxfiles,
+            meta->type, &meta->isolated_index, error);
+        stats_span_end (&span, STATS_PHASE_ENUMERATE);
+        return ret;
     }
 
-    if (fileargs_len)
+    if (fileargs_len || files_from || recursive_root)
     {
         g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
             _("Live system probation must not be used together "
@@ -484,6 +980,7 @@ _fileargs_handler (GOptionContext *context,
             return FALSE;
         }
 
+        stats_span_begin (&span);
         for (gsize i = 0; i < bindirs->len; i++)
         {
             // Ignore errors, pretty common that some folders don't
@@ -491,6 +988,7 @@ _fileargs_handler (GOptionContext *context,
             _check_file_args ((const char *)(bindirs->pdata[i]),
                 allidxfiles, meta->type, NULL, NULL);
         }
+        stats_span_end (&span, STATS_PHASE_ENUMERATE);
         g_ptr_array_free (bindirs, TRUE);
     }
 #endif
@@ -512,7 +1010,19 @@ _set_def_output_opts    (GOptionContext *context,
     UNUSED (context);
     UNUSED (group);
     UNUSED (data);
-    UNUSED (error);
+
+#ifdef G_OS_UNIX
+    // Server state is inherited by every request, so output
+    // options are only accepted from requests
+    if (serve_path && ! in_request && (delim || no_heading ||
+        compress_set || output_format != FORMAT_UNKNOWN))
+    {
+        g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+            _("Serve mode only accepts inputs and output options "
+            "from each request."));
+        return FALSE;
+    }
+#endif
 
     /* Fallback values after successful option parsing */
     if (delim == NULL)
@@ -521,6 +1031,34 @@ _set_def_output_opts    (GOptionContext *context,
     if (output_format == FORMAT_UNKNOWN)
         output_format = FORMAT_TEXT;
 
+    /* Database can't be written to stdout */
+    if (output_format == FORMAT_SQLITE && output_loc == NULL)
+    {
+        g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+            _("SQLite output requires output file ('-o' option)"));
+        return FALSE;
+    }
+
+    if (! compress_set && output_loc != NULL)
+    {
+        if (g_str_has_suffix (output_loc, ".gz"))
+            compress_method = COMPRESS_GZIP;
+        else if (g_str_has_suffix (output_loc, ".zst"))
+            compress_method = COMPRESS_ZSTD;
+    }
+
+    if (compress_method != COMPRESS_NONE)
+    {
+        if (output_format == FORMAT_SQLITE)
+        {
+            g_set_error_literal (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
+                _("SQLite output can not be compressed"));
+            return FALSE;
+        }
+        if (! compress_type_supported (compress_method, error))
+            return FALSE;
+    }
+
     return TRUE;
 }
 
@@ -538,7 +1076,7 @@ win_filetime_to_gdatetime (int64_t win_filetime)
     /* Let's assume we don't need subsecond time resolution */
     t = (win_filetime - 116444736000000000LL) / 10000000;
 
-    g_debug ("FileTime -> Epoch: %" PRId64
+    r2_debug ("FileTime -> Epoch: %" PRId64
         " -> %" PRId64, win_filetime, t);
 
     return g_date_time_new_from_unix_utc (t);
@@ -558,9 +1096,6 @@ _opt_ctxt_setup (GOptionContext **context,
     char         *desc_str;
     GOptionGroup *main_group, *output_group;
 
-    /* FIXME Sneaky metadata modification! Think about cleaner way */
-    meta->type = type;
-
     desc_str = g_strdup_printf (
         _("Usage help: %s\nBug report: %s\nMore info : %s"),
         PROJECT_TOOL_USAGE_URL,
@@ -573,12 +1108,17 @@ _opt_ctxt_setup (GOptionContext **context,
     main_group = g_option_group_new (NULL, NULL, NULL, meta, NULL);
 
     g_option_group_add_entries (main_group, main_options);
+    g_option_group_add_entries (main_group, carve_options);
+#ifdef G_OS_UNIX
+    g_option_group_add_entries (main_group, serve_options);
+#endif
     switch (type)
     {
         case RECYCLE_BIN_TYPE_FILE:
             g_option_group_add_entries (main_group, rbinfile_options);
             break;
         case RECYCLE_BIN_TYPE_DIR:
+            g_option_group_add_entries (main_group, rbindir_options);
 #if (defined G_OS_WIN32 || defined __linux__)
             g_option_group_add_entries (main_group, live_options);
 #else
@@ -605,13 +1145,38 @@ _opt_ctxt_setup (GOptionContext **context,
     g_option_context_set_help_enabled (*context, TRUE);
 }
 
+
 /**
- * @brief Process command line arguments
- * @param context Reference of option context pointer
- * @param argv Reference of command line `argv`
+ * @brief Create parsing context from options just parsed
  * @param error Reference of `GError` pointer to store errors
- * @return `TRUE` if argument parsing succeeds.
- * `FALSE` on failure, and sets `error` as well.
+ * @return `TRUE` on success, `FALSE` if encoding is unusable
+ * @note Served request replaces context of server, but keeps
+ * converters opened by server if encoding is the same
+ */
+static bool
+_setup_parse_ctx (GError **error)
+{
+    r2_context *ctx = r2_context_new ();
+
+    if (! r2_context_set_legacy_encoding (ctx, legacy_encoding, error))
+    {
+        r2_context_free (ctx);
+        return false;
+    }
+    r2_decoder_rebind (meta->dec, ctx);
+    r2_context_free (parse_ctx);
+    meta->ctx = parse_ctx = ctx;
+    meta->cache = idx_cache;
+    return true;
+}
+
+/**
+ * @brief Process command line arguments
+ * @param context Reference of option context pointer
+ * @param argv Reference of command line `argv`
+ * @param error Reference of `GError` pointer to store errors
+ * @return `TRUE` if argument parsing succeeds.
+ * `FALSE` on failure, and sets `error` as well.
  */
 static bool
 _opt_ctxt_parse (GOptionContext **context,
@@ -638,6 +1203,24 @@ _opt_ctxt_parse (GOptionContext **context,
 #endif
     }
 
+    // glib would take next argument (usually input file) as value
+    // of option with optional value, unless value is attached
+    for (gsize i = 1; i < argc; i++)
+    {
+        if (0 == strcmp (argv_u8[i], "--"))
+            break;
+        if (0 == strcmp (argv_u8[i], "--stats"))
+        {
+            g_free (argv_u8[i]);
+            argv_u8[i] = g_strdup ("--stats=text");
+        }
+        else if (0 == strcmp (argv_u8[i], "--progress"))
+        {
+            g_free (argv_u8[i]);
+            argv_u8[i] = g_strdup ("--progress=auto");
+        }
+    }
+
     {
         char *args_str = g_strjoinv("|", argv_u8);
         g_debug("Calling argv_u8 (%zu): %s", argc, args_str);
@@ -648,7 +1231,7 @@ _opt_ctxt_parse (GOptionContext **context,
     g_option_context_free (*context);
     g_strfreev (argv_u8);
 
-    return (*error == NULL);
+    return (*error == NULL) && _setup_parse_ctx (error);
 }
 
 
@@ -656,8 +1239,8 @@ _opt_ctxt_parse (GOptionContext **context,
  * @brief Free all fields used in a single recycle bin record
  * @param record Pointer to the record structure
  */
-static void
-_free_record_cb (rbin_struct *record)
+void
+free_record (rbin_struct *record)
 {
     g_free (record->index_s);
     g_date_time_unref (record->deltime);
@@ -670,6 +1253,51 @@ _free_record_cb (rbin_struct *record)
 }
 
 
+/**
+ * @brief Allocate empty metadata structure for a recycle bin
+ * @param type Recycle bin type
+ * @param from Metadata whose parsing context and cache are shared,
+ * or `NULL` if they are not available yet
+ * @return Newly allocated metadata, to be freed with `_free_meta()`
+ */
+static metarecord *
+_new_meta   (rbin_type           type,
+             const metarecord   *from)
+{
+    metarecord *m = g_malloc0 (sizeof (metarecord));
+
+    m->type = type;
+    if (from)
+    {
+        m->ctx = from->ctx;
+        m->cache = from->cache;
+    }
+    m->dec = g_malloc (sizeof (r2_decoder));
+    r2_decoder_init (m->dec, m->ctx);
+    m->records = g_ptr_array_new ();
+    g_ptr_array_set_free_func (m->records, (GDestroyNotify) free_record);
+    m->invalid_records = g_hash_table_new_full (
+        g_str_hash,
+        g_str_equal,
+        (GDestroyNotify) g_free,
+        (GDestroyNotify) g_error_free
+    );
+    return m;
+}
+
+
+static void
+_free_meta   (metarecord  *m)
+{
+    r2_decoder_clear (m->dec);
+    g_free (m->dec);
+    g_ptr_array_unref (m->records);
+    g_hash_table_destroy (m->invalid_records);
+    g_free (m->filename);
+    g_free (m);
+}
+
+
 /**
  * @brief Initialize program setup
  */
@@ -686,19 +1314,17 @@ rifiuti_init (rbin_type  type,
     init_handles ();
 
     /* Initialize metadata struct */
-    meta = g_malloc0 (sizeof (metarecord));
-    meta->records = g_ptr_array_new ();
-    g_ptr_array_set_free_func (meta->records, (GDestroyNotify) _free_record_cb);
-    meta->invalid_records = g_hash_table_new_full (
-        g_str_hash,
-        g_str_equal,
-        (GDestroyNotify) g_free,
-        (GDestroyNotify) g_error_free
-    );
+    meta = _new_meta (type, NULL);
 
     // Other global structures
     allidxfiles = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
 
+#ifdef G_OS_UNIX
+    // Served requests have their own arguments parsed
+    usage_param_str = usage_param;
+    usage_summary_str = usage_summary;
+#endif
+
     /* Parse command line arguments and generate help */
     context = g_option_context_new (usage_param);
     g_option_context_set_summary (context, usage_summary);
@@ -722,7 +1348,9 @@ _populate_index_file_list (GPtrArray   *list,
 {
     GDir           *dir;
     const char     *direntry;
-    GPatternSpec   *pattern1, *pattern2;
+    GPtrArray      *names;
+    GStatBuf        st;
+    bool            use_cache;
 
     // g_dir_open() returns cryptic error message or even succeeds on Windows,
     // when in fact the directory content is inaccessible.
@@ -732,61 +1360,278 @@ _populate_index_file_list (GPtrArray   *list,
     }
 #endif
 
+    // Unchanged folder needs not be scanned again. Folder status
+    // must be taken before scanning, so any change during scan is
+    // noticed next time.
+    use_cache = (idx_cache && 0 == g_stat (path, &st));
+    if (use_cache &&
+        NULL != (names = rbin_cache_lookup_dir (idx_cache, path, &st)))
+    {
+        r2_debug ("Using cached file list of '%s'", path);
+        for (guint i = 0; i < names->len; i++)
+            g_ptr_array_add (list,
+                g_build_filename (path, names->pdata[i], NULL));
+        g_ptr_array_free (names, TRUE);
+        return true;
+    }
+
     if (NULL == (dir = g_dir_open (path, 0, error)))
         return false;
 
-    pattern1 = g_pattern_spec_new ("$I??????.*");
-    pattern2 = g_pattern_spec_new ("$I??????");
+    names = g_ptr_array_new_with_free_func (g_free);
 
     while ((direntry = g_dir_read_name (dir)) != NULL)
     {
-#if GLIB_CHECK_VERSION (2, 70, 0)
-        if (!g_pattern_spec_match_string (pattern1, direntry) &&
-            !g_pattern_spec_match_string (pattern2, direntry))
+        if (! r2_is_index_name (direntry))
             continue;
-#else /* glib < 2.70 */
-        if (!g_pattern_match_string (pattern1, direntry) &&
-            !g_pattern_match_string (pattern2, direntry))
-            continue;
-#endif
         g_ptr_array_add (list,
             g_build_filename (path, direntry, NULL));
+        g_ptr_array_add (names, g_strdup (direntry));
     }
 
     g_dir_close (dir);
 
-    g_pattern_spec_free (pattern1);
-    g_pattern_spec_free (pattern2);
+    if (use_cache)
+        rbin_cache_store_dir (idx_cache, path, &st, names);
+
+    g_ptr_array_free (names, TRUE);
 
     return true;
 }
 
 
+/* State of parallel recycle bin search */
+typedef struct _walk_ctx
+{
+    GThreadPool  *pool;
+    GMutex        lock;
+    GCond         cond;
+    guint         pending;    /* folders queued but not yet searched */
+    GPtrArray    *found[3];   /* indexed by rbin_type */
+} walk_ctx;
+
+
+static void
+_walk_add_found   (walk_ctx    *ctx,
+                   rbin_type    type,
+                   char        *path)
+{
+    g_mutex_lock (&ctx->lock);
+    g_ptr_array_add (ctx->found[type], path);
+    g_mutex_unlock (&ctx->lock);
+}
+
+
+static void
+_walk_push_folder   (walk_ctx  *ctx,
+                     char      *path)
+{
+    g_mutex_lock (&ctx->lock);
+    ctx->pending++;
+    g_mutex_unlock (&ctx->lock);
+    g_thread_pool_push (ctx->pool, path, NULL);
+}
+
+
+/**
+ * @brief Check if `$Recycle.bin` subfolder is a usable recycle bin
+ * @note Same criteria as `_check_file_args()`: either index
+ * files exist, or `desktop.ini` identifies it as empty recycle bin
+ */
+static bool
+_is_rbin_dir   (const char  *path)
+{
+    GDir           *dir;
+    const char     *direntry;
+    bool            found = false;
+
+    if (NULL == (dir = g_dir_open (path, 0, NULL)))
+        return false;
+
+    while (! found && (direntry = g_dir_read_name (dir)) != NULL)
+        found = r2_is_index_name (direntry);
+
+    g_dir_close (dir);
+
+    return found || r2_found_desktop_ini (path);
+}
+
+
+/**
+ * @brief Search single folder for recycle bins, queueing subfolders
+ * for other workers
+ * @param path Folder to search, freed afterwards
+ * @param ctx Search state
+ * @note Recognized layouts are `$Recycle.bin\<SID>` folders,
+ * `RECYCLER\<SID>\INFO2` (or `INFO` on NT 4.0) and
+ * `RECYCLED\INFO2` (or `INFO` on Windows 95). Recycle bins are
+ * not descended into, and symbolic links are never followed.
+ */
+static void
+_walk_folder   (char      *path,
+                walk_ctx  *ctx)
+{
+    GDir        *dir;
+    const char  *direntry;
+    char        *name = g_path_get_basename (path);
+    bool         in_vista_bin, in_legacy_bin;
+    gint64       start = trace_begin ();
+
+    in_vista_bin  = (0 == g_ascii_strcasecmp (name, "$Recycle.bin"));
+    in_legacy_bin = (0 == g_ascii_strcasecmp (name, "RECYCLER") ||
+                     0 == g_ascii_strcasecmp (name, "RECYCLED"));
+    g_free (name);
+
+    if (NULL == (dir = g_dir_open (path, 0, NULL)))
+        r2_debug ("Can't search folder '%s', skipped", path);
+
+    while (dir && (direntry = g_dir_read_name (dir)) != NULL)
+    {
+        char *child = g_build_filename (path, direntry, NULL);
+
+        if (g_file_test (child, G_FILE_TEST_IS_SYMLINK))
+            g_free (child);
+
+        else if (g_file_test (child, G_FILE_TEST_IS_DIR))
+        {
+            if (in_vista_bin)
+            {
+                if (_is_rbin_dir (child))
+                    _walk_add_found (ctx, RECYCLE_BIN_TYPE_DIR, child);
+                else
+                    g_free (child);
+            }
+            else if (in_legacy_bin)
+            {
+                // Per user folder, then the index file itself
+                char *idx = g_build_filename (child, "INFO2", NULL);
+                if (! g_file_test (idx, G_FILE_TEST_IS_REGULAR))
+                {
+                    g_free (idx);
+                    idx = g_build_filename (child, "INFO", NULL);
+                }
+                if (g_file_test (idx, G_FILE_TEST_IS_REGULAR))
+                    _walk_add_found (ctx, RECYCLE_BIN_TYPE_FILE, idx);
+                else
+                    g_free (idx);
+                g_free (child);
+            }
+            else
+                _walk_push_folder (ctx, child);
+        }
+
+        else if (in_legacy_bin &&
+            (0 == g_ascii_strcasecmp (direntry, "INFO2") ||
+             0 == g_ascii_strcasecmp (direntry, "INFO")) &&
+            g_file_test (child, G_FILE_TEST_IS_REGULAR))
+            _walk_add_found (ctx, RECYCLE_BIN_TYPE_FILE, child);
+
+        else
+            g_free (child);
+    }
+
+    if (dir)
+        g_dir_close (dir);
+    trace_end (start, "search folder", "%s", path);
+    g_free (path);
+
+    g_mutex_lock (&ctx->lock);
+    if (--ctx->pending == 0)
+        g_cond_signal (&ctx->cond);
+    g_mutex_unlock (&ctx->lock);
+}
+
+
+static int
+_compare_path   (gconstpointer  a,
+                 gconstpointer  b)
+{
+    return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+
 /**
- * @brief Search for desktop.ini in folder for hint of recycle bin
- * @param path The searched path
- * @return `TRUE` if `desktop.ini` found to contain recycle bin
- *         identifier, `FALSE` otherwise
+ * @brief Search recycle bins of both `INFO2` and `$Recycle.bin`
+ * layouts under a folder, using a thread pool
+ * @param root Folder to search from
+ * @param type Recycle bin type handled by current program
+ * @param list Array to append found recycle bins of `type` to
+ * @param error Location to store error upon problem
+ * @return `TRUE` if any recycle bin of `type` is found, `FALSE` otherwise
+ * @note Found recycle bins are sorted by path, so that output
+ * is reproducible. Those of the other type are only listed on
+ * stderr, since their parsing and validation routines live in
+ * the other program.
  */
 static bool
-_found_desktop_ini (const char *path)
+_find_bins_recursive (const char  *root,
+                      rbin_type    type,
+                      GPtrArray   *list,
+                      GError     **error)
 {
-    char *filename = NULL, *content = NULL, *found = NULL;
+    walk_ctx   ctx = { 0 };
+    rbin_type  other = (type == RECYCLE_BIN_TYPE_DIR) ?
+        RECYCLE_BIN_TYPE_FILE : RECYCLE_BIN_TYPE_DIR;
+    guint      count;
+    stats_span span;
 
-    filename = g_build_filename (path, "desktop.ini", NULL);
-    if (!g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+    if (! g_file_test (root, G_FILE_TEST_IS_DIR))
     {
-        g_free (filename);
+        g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+            _("'%s' is not a folder."), root);
         return false;
     }
 
-    if (g_file_get_contents (filename, &content, NULL, NULL))
-        /* Don't bother parsing, we don't use the content at all */
-        found = strstr (content, RECYCLE_BIN_CLSID);
+    stats_span_begin (&span);
+    g_mutex_init (&ctx.lock);
+    g_cond_init (&ctx.cond);
+    for (int i = 0; i < 3; i++)
+        ctx.found[i] = g_ptr_array_new_with_free_func (g_free);
 
-    g_free (content);
-    g_free (filename);
-    return (found != NULL);
+    ctx.pool = g_thread_pool_new ((GFunc) _walk_folder, &ctx,
+        (gint) g_get_num_processors (), FALSE, NULL);
+
+    _walk_push_folder (&ctx, g_strdup (root));
+
+    g_mutex_lock (&ctx.lock);
+    while (ctx.pending > 0)
+        g_cond_wait (&ctx.cond, &ctx.lock);
+    g_mutex_unlock (&ctx.lock);
+
+    g_thread_pool_free (ctx.pool, FALSE, TRUE);
+
+    g_ptr_array_sort (ctx.found[type], _compare_path);
+    count = ctx.found[type]->len;
+    for (guint i = 0; i < count; i++)
+        g_ptr_array_add (list, g_strdup (ctx.found[type]->pdata[i]));
+
+    if (ctx.found[other]->len)
+    {
+        g_ptr_array_sort (ctx.found[other], _compare_path);
+        g_printerr (_("%u recycle bin(s) of %s format found, "
+            "which should be parsed with '%s' program:\n"),
+            ctx.found[other]->len,
+            (other == RECYCLE_BIN_TYPE_FILE) ? "INFO2" : "$Recycle.bin",
+            (other == RECYCLE_BIN_TYPE_FILE) ? "rifiuti" : "rifiuti-vista");
+        for (guint i = 0; i < ctx.found[other]->len; i++)
+        {
+            char *p = g_filename_display_name (ctx.found[other]->pdata[i]);
+            g_printerr ("  %s\n", p);
+            g_free (p);
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+        g_ptr_array_free (ctx.found[i], TRUE);
+    g_mutex_clear (&ctx.lock);
+    g_cond_clear (&ctx.cond);
+    stats_span_end (&span, STATS_PHASE_ENUMERATE);
+
+    if (count == 0)
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+            _("No recycle bin is found under '%s'."), root);
+
+    return (count > 0);
 }
 
 
@@ -814,6 +1659,10 @@ _guess_windows_ver (const metarecord *meta)
 
     /* INFO2 only below */
 
+    // Carved records have no INFO2 header
+    if (meta->version < 0)
+        return OS_GUESS_UNKNOWN;
+
     switch (meta->version)
     {
         case VERSION_WIN95: return OS_GUESS_95;
@@ -860,7 +1709,9 @@ _check_file_args (const char  *path,
                   bool        *isolated_index,
                   GError     **error)
 {
-    g_debug ("Start checking path '%s'...", path);
+    guint old_len = list ? list->len : 0;
+
+    r2_debug ("Start checking path '%s'...", path);
 
     g_return_val_if_fail (path != NULL, FALSE);
     g_return_val_if_fail (list != NULL, FALSE);
@@ -875,13 +1726,18 @@ _check_file_args (const char  *path,
     if ((type == RECYCLE_BIN_TYPE_DIR) &&
         g_file_test (path, G_FILE_TEST_IS_DIR))
     {
-        if ( ! _populate_index_file_list (list, path, error) )
+        gint64 start = trace_begin ();
+        bool   scanned = _populate_index_file_list (list, path, error);
+
+        trace_end (start, "scan folder", "%s", path);
+        if (! scanned)
             return FALSE;
+        progress_add (PROGRESS_FILES_TOTAL, list->len - old_len);
         /*
          * last ditch effort: search for desktop.ini. Just print empty content
          * representing empty recycle bin if found.
          */
-        if (list->len == 0 && ! _found_desktop_ini (path))
+        if (list->len == 0 && ! r2_found_desktop_ini (path))
         {
             g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
                 _("No files with name pattern '%s' "
@@ -893,10 +1749,11 @@ _check_file_args (const char  *path,
     {
         if (isolated_index && (type == RECYCLE_BIN_TYPE_DIR)) {
             char *parent_dir = g_path_get_dirname (path);
-            *isolated_index = ! _found_desktop_ini (parent_dir);
+            *isolated_index = ! r2_found_desktop_ini (parent_dir);
             g_free (parent_dir);
         }
         g_ptr_array_add (list, g_strdup (path));
+        progress_add (PROGRESS_FILES_TOTAL, 1);
     }
     else
     {
@@ -909,10 +1766,31 @@ _check_file_args (const char  *path,
     return TRUE;
 }
 
+/**
+ * @brief Parse single index file, recording it in trace
+ */
+static void
+_parse_index_file   (ParseIdxFunc   func,
+                     const char    *path,
+                     metarecord    *m)
+{
+    gint64 start = trace_begin ();
+
+    func (path, m);
+    trace_end (start, "parse file", "%s", path);
+    progress_add (PROGRESS_FILES_DONE, 1);
+}
+
+
 void
 do_parse_records (ParseIdxFunc func)
 {
-    g_ptr_array_foreach (allidxfiles, (GFunc) func, meta);
+    stats_span span;
+
+    stats_span_begin (&span);
+    for (guint i = 0; i < allidxfiles->len; i++)
+        _parse_index_file (func, allidxfiles->pdata[i], meta);
+    stats_span_end (&span, STATS_PHASE_PARSE);
 }
 
 
@@ -930,7 +1808,10 @@ _print_text_header (const metarecord *meta)
     }
 
     if (meta->version == VERSION_NOT_FOUND) {
-        g_print ("%s\n", _("Version: ??? (empty folder)"));
+        g_print ("%s\n", meta->carved ? _("Version: ???") :
+            _("Version: ??? (empty folder)"));
+    } else if (meta->version == VERSION_INCONSISTENT) {
+        g_print ("%s\n", _("Version: ??? (mixed)"));
     } else {
         g_print (_("Version: %" PRIu64 "\n"), meta->version);
     }
@@ -1066,209 +1947,498 @@ _print_json_header (const metarecord *meta)
 
     {
         char *s = g_filename_display_name (meta->filename);
-        char *rbin_path = json_escape (s);
-        g_print ("  \"path\": \"%s\",\n", rbin_path);
+        GString *rbin_path = g_string_new (NULL);
+        json_escape (rbin_path, s);
+        g_print ("  \"path\": \"%s\",\n", rbin_path->str);
         g_free (s);
-        g_free (rbin_path);
+        g_string_free (rbin_path, TRUE);
     }
 
     g_print ("  \"records\": [\n");
 }
 
 
+/**
+ * @brief Print metadata line for JSON Lines output
+ * @param meta Pointer to metadata structure
+ * @note Unlike JSON, metadata is a self-contained object on the
+ * first line, and each record follows on its own line.
+ */
 static void
-_print_text_record   (rbin_struct        *record,
-                      const metarecord   *meta)
+_print_jsonl_header (const metarecord *meta)
 {
-    char         *output, **header;
-    GString      *src;
-    GDateTime    *dt;
-    extern struct _fmt_data fmt[];
+    GString *s = g_string_new ("{\"format\": \"");
 
-    g_return_if_fail (record != NULL);
+    s = g_string_append (s,
+        (meta->type == RECYCLE_BIN_TYPE_FILE) ? "file" : "dir");
 
-    header = (char **) g_malloc0_n (6, sizeof(gpointer));
+    if (meta->version >= 0)  /* can be found and not error */
+        g_string_append_printf (s, "\", \"version\": %" PRId64,
+            meta->version);
+    else
+        s = g_string_append (s, "\", \"version\": null");
 
-    header[0] = (meta->type == RECYCLE_BIN_TYPE_FILE) ?
-        g_strdup_printf ("%" PRIu32, record->index_n) :
-        g_strdup (record->index_s);
+    if (meta->type == RECYCLE_BIN_TYPE_FILE && meta->total_entry > 0)
+        g_string_append_printf (s, ", \"ever_existed\": %" PRIu32,
+            meta->total_entry);
 
-    dt = use_localtime ? g_date_time_to_local (record->deltime):
-                         g_date_time_ref      (record->deltime);
-    header[1] = g_date_time_format (dt, "%F %T");
+    {
+        char *rbin_path = g_filename_display_name (meta->filename);
+        s = g_string_append (s, ", \"path\": \"");
+        json_escape (s, rbin_path);
+        s = g_string_append (s, "\"}\n");
+        g_free (rbin_path);
+    }
 
-    header[2] = g_strdup(fmt[FORMAT_TEXT].gone_outtext[record->gone]);
+    g_print ("%s", s->str);
+    g_string_free (s, TRUE);
+}
 
-    header[3] = (record->filesize == G_MAXUINT64) ?  // faulty
-        g_strdup ("???") :
-        g_strdup_printf ("%" PRIu64, record->filesize);
 
-    src = legacy_encoding ? record->raw_legacy_path :
-                            record->raw_uni_path    ;
-    header[4] = conv_path_to_utf8_with_tmpl (src,
-        legacy_encoding, FORMAT_TEXT, NULL, &record->error);
-    if (! header[4])
-        header[4] = g_strdup ("???");
+/**
+ * @brief Append unsigned integer to output buffer
+ * @param out The output buffer
+ * @param val Number to be appended
+ * @param width Minimum width, padded with zero
+ * @note Avoids temporary string allocation inherent in
+ * `g_string_append_printf()`
+ */
+static void
+_append_uint   (GString    *out,
+                uint64_t    val,
+                unsigned    width)
+{
+    char   buf[24];
+    int    n = 0;
 
-    output = g_strjoinv (delim, header);
-    g_print ("%s\n", output);
+    do
+    {
+        buf[n++] = '0' + (char) (val % 10);
+        val /= 10;
+    }
+    while (val);
 
-    g_free (output);
-    g_date_time_unref (dt);
-    g_strfreev (header);
+    for (unsigned i = (unsigned) n; i < width; i++)
+        out = g_string_append_c (out, '0');
+    while (n)
+        out = g_string_append_c (out, buf[--n]);
 }
 
 
-static void
-_print_xml_record   (rbin_struct        *record,
-                     const metarecord   *meta)
+/**
+ * @brief Number of days since Unix epoch for specified date
+ * @note Algorithm from http://howardhinnant.github.io/date_algorithms.html
+ */
+static int64_t
+_days_from_civil   (int64_t    y,
+                    unsigned   m,
+                    unsigned   d)
 {
-    extern struct _fmt_data fmt[];
-    char         *path, *dt_str;
-    GDateTime    *dt;
-    GString      *s, *src;
+    int64_t   era;
+    unsigned  yoe, doy, doe;
 
-    g_return_if_fail (record != NULL);
+    y  -= (m <= 2);
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = (unsigned) (y - era * 400);
+    doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
 
-    s = g_string_new ("  <record");
+    return era * 146097 + (int64_t) doe - 719468;
+}
 
-    if (meta->type == RECYCLE_BIN_TYPE_FILE)
-        g_string_append_printf (s, " index=\"%" PRIu32 "\"", record->index_n);
-    else
-        g_string_append_printf (s, " index=\"%s\"", record->index_s);
+
+/**
+ * @brief Append trash item deletion time to output buffer
+ * @param out The output buffer
+ * @param dt Deletion time of record, in UTC
+ * @param iso8601 If `true`, use ISO 8601 format with time zone
+ * (`%FT%TZ` or `%FT%T%z`), otherwise `%F %T` is used
+ * @note This is a hand crafted equivalent of `g_date_time_format()`,
+ * which does not allocate any memory
+ */
+static void
+_append_deltime   (GString     *out,
+                   GDateTime   *dt,
+                   bool         iso8601)
+{
+    int        year, month, day, hour, min, sec;
+    int64_t    offset = 0;
+    struct tm  tm;
+    time_t     t = (time_t) g_date_time_to_unix (dt);
+    bool       have_tm = false;
 
     if (use_localtime)
+#ifdef G_OS_WIN32
+        have_tm = (0 == localtime_s (&tm, &t));
+#else
+        have_tm = (NULL != localtime_r (&t, &tm));
+#endif
+
+    if (have_tm)
     {
-        dt = g_date_time_to_local (record->deltime);
-        dt_str = g_date_time_format (dt, "%FT%T%z");
+        year  = tm.tm_year + 1900;
+        month = tm.tm_mon + 1;
+        day   = tm.tm_mday;
+        hour  = tm.tm_hour;
+        min   = tm.tm_min;
+        sec   = tm.tm_sec;
+
+        // struct tm member for UTC offset is not portable
+        offset = _days_from_civil (year, month, day) * 86400 +
+            hour * 3600 + min * 60 + sec - (int64_t) t;
     }
     else
     {
-        dt = g_date_time_ref (record->deltime);
-        dt_str = g_date_time_format (dt, "%FT%TZ");
+        // Either UTC is wanted, or time is beyond range of struct tm,
+        // where glib can still handle local time in most cases
+        GDateTime *local = use_localtime ? g_date_time_to_local (dt) : NULL;
+
+        if (local)
+        {
+            dt = local;
+            offset = g_date_time_get_utc_offset (dt) / G_USEC_PER_SEC;
+        }
+        g_date_time_get_ymd (dt, &year, &month, &day);
+        hour  = g_date_time_get_hour   (dt);
+        min   = g_date_time_get_minute (dt);
+        sec   = g_date_time_get_second (dt);
+        if (local)
+            g_date_time_unref (local);
+    }
+
+    _append_uint (out, year , 4);  out = g_string_append_c (out, '-');
+    _append_uint (out, month, 2);  out = g_string_append_c (out, '-');
+    _append_uint (out, day  , 2);
+    out = g_string_append_c (out, iso8601 ? 'T' : ' ');
+    _append_uint (out, hour , 2);  out = g_string_append_c (out, ':');
+    _append_uint (out, min  , 2);  out = g_string_append_c (out, ':');
+    _append_uint (out, sec  , 2);
+
+    if (! iso8601)
+        return;
+
+    if (! use_localtime)
+    {
+        out = g_string_append_c (out, 'Z');
+        return;
     }
-    g_string_append_printf (s, " time=\"%s\"", dt_str);
 
-    g_string_append_printf (s, " gone=\"%s\"",
-        fmt[FORMAT_XML].gone_outtext[record->gone]);
+    out = g_string_append_c (out, (offset < 0) ? '-' : '+');
+    offset = (offset < 0) ? -offset : offset;
+    _append_uint (out, offset / 3600, 2);
+    _append_uint (out, offset % 3600 / 60, 2);
+}
+
 
-    if (record->filesize == G_MAXUINT64)  // faulty
-        g_string_append_printf (s, " size=\"-1\"");
+static void
+_print_text_record   (rbin_struct        *record,
+                      const metarecord   *meta,
+                      GString            *out)
+{
+    GString      *src;
+    const char   *enc = r2_context_get_legacy_encoding (meta->ctx);
+    extern struct _fmt_data fmt[];
+
+    g_return_if_fail (record != NULL);
+
+    if (has_numeric_index (meta))
+        _append_uint (out, record->index_n, 0);
     else
-        g_string_append_printf (s,
-            " size=\"%" PRIu64 "\"", record->filesize);
+        out = g_string_append (out, record->index_s);
+    out = g_string_append (out, delim);
 
-    // Still need to be converted despite using CDATA,
-    // otherwise could be writing garbage output
-    src = legacy_encoding ? record->raw_legacy_path :
-                            record->raw_uni_path    ;
-    path = conv_path_to_utf8_with_tmpl (src,
-        legacy_encoding, FORMAT_XML, NULL, &record->error);
-
-    if (path)
-        g_string_append_printf (s, ">\n"
-            "    <path><![CDATA[%s]]></path>\n"
-            "  </record>\n", path);
+    _append_deltime (out, record->deltime, false);
+    out = g_string_append (out, delim);
+
+    out = g_string_append (out, fmt[FORMAT_TEXT].gone_outtext[record->gone]);
+    out = g_string_append (out, delim);
+
+    if (record->filesize == G_MAXUINT64)  // faulty
+        out = g_string_append (out, "???");
     else
-        s = g_string_append (s, ">\n    <path/>\n  </record>\n");
+        _append_uint (out, record->filesize, 0);
+    out = g_string_append (out, delim);
 
-    g_print ("%s", s->str);
-    g_string_free (s, TRUE);
+    src = enc ? record->raw_legacy_path : record->raw_uni_path;
+    if (! conv_path_to_utf8_with_tmpl (src, enc,
+        FORMAT_TEXT, NULL, out, &record->error))
+        out = g_string_append (out, "???");
 
-    g_date_time_unref (dt);
-    g_free (path);
-    g_free (dt_str);
+    out = g_string_append_c (out, '\n');
 }
 
 
 static void
-_print_json_record   (rbin_struct        *record,
-                      const metarecord   *meta)
+_print_xml_record   (rbin_struct        *record,
+                     const metarecord   *meta,
+                     GString            *out)
 {
     extern struct _fmt_data fmt[];
-    char         *path, *dt_str;
-    GDateTime    *dt;
-    GString      *src, *s;
+    GString      *src;
+    const char   *enc = r2_context_get_legacy_encoding (meta->ctx);
 
     g_return_if_fail (record != NULL);
 
-    s = g_string_new ("    {");
+    out = g_string_append (out, "  <record index=\"");
+    if (has_numeric_index (meta))
+        _append_uint (out, record->index_n, 0);
+    else
+        out = g_string_append (out, record->index_s);
+
+    out = g_string_append (out, "\" time=\"");
+    _append_deltime (out, record->deltime, true);
+
+    out = g_string_append (out, "\" gone=\"");
+    out = g_string_append (out, fmt[FORMAT_XML].gone_outtext[record->gone]);
 
-    if (meta->type == RECYCLE_BIN_TYPE_FILE)
-        g_string_append_printf (s, "\"index\": %" PRIu32, record->index_n);
+    out = g_string_append (out, "\" size=\"");
+    if (record->filesize == G_MAXUINT64)  // faulty
+        out = g_string_append (out, "-1");
     else
-        g_string_append_printf (s, "\"index\": \"%s\"", record->index_s);
+        _append_uint (out, record->filesize, 0);
 
-    if (use_localtime)
+    // Still need to be converted despite using CDATA,
+    // otherwise could be writing garbage output
+    out = g_string_append (out, "\">\n    <path><![CDATA[");
+    src = enc ? record->raw_legacy_path : record->raw_uni_path;
+    if (conv_path_to_utf8_with_tmpl (src, enc,
+        FORMAT_XML, NULL, out, &record->error))
+        out = g_string_append (out, "]]></path>\n  </record>\n");
+    else
     {
-        dt = g_date_time_to_local (record->deltime);
-        dt_str = g_date_time_format (dt, "%FT%T%z");
+        g_string_truncate (out, out->len - strlen ("<path><![CDATA["));
+        out = g_string_append (out, "<path/>\n  </record>\n");
     }
+}
+
+
+/**
+ * @brief Append single record as JSON object, without trailing newline
+ * @note Shared by JSON and JSON Lines output
+ */
+static void
+_append_json_object   (rbin_struct        *record,
+                       const metarecord   *meta,
+                       GString            *out)
+{
+    extern struct _fmt_data fmt[];
+    GString      *src;
+    const char   *enc = r2_context_get_legacy_encoding (meta->ctx);
+
+    out = g_string_append (out, "{\"index\": ");
+    if (has_numeric_index (meta))
+        _append_uint (out, record->index_n, 0);
     else
     {
-        dt = g_date_time_ref (record->deltime);
-        dt_str = g_date_time_format (dt, "%FT%TZ");
+        out = g_string_append_c (out, '"');
+        out = g_string_append (out, record->index_s);
+        out = g_string_append_c (out, '"');
     }
-    g_string_append_printf (s, ", \"time\": \"%s\"", dt_str);
 
-    g_string_append_printf (s, ", \"gone\": %s",
-        fmt[FORMAT_JSON].gone_outtext[record->gone]);
+    out = g_string_append (out, ", \"time\": \"");
+    _append_deltime (out, record->deltime, true);
+
+    out = g_string_append (out, "\", \"gone\": ");
+    out = g_string_append (out, fmt[FORMAT_JSON].gone_outtext[record->gone]);
 
+    out = g_string_append (out, ", \"size\": ");
     if (record->filesize == G_MAXUINT64)  // faulty
-        g_string_append_printf (s, ", \"size\": null");
+        out = g_string_append (out, "null");
     else
-        g_string_append_printf (s,
-            ", \"size\": %" PRIu64, record->filesize);
+        _append_uint (out, record->filesize, 0);
 
-    src = legacy_encoding ? record->raw_legacy_path :
-                            record->raw_uni_path    ;
-    path = conv_path_to_utf8_with_tmpl (src, legacy_encoding,
-        FORMAT_JSON, &json_escape, &record->error);
-
-    if (path)
-        g_string_append_printf (s, ", \"path\": \"%s\"},\n", path);
+    out = g_string_append (out, ", \"path\": \"");
+    src = enc ? record->raw_legacy_path : record->raw_uni_path;
+    if (conv_path_to_utf8_with_tmpl (src, enc,
+        FORMAT_JSON, &json_escape, out, &record->error))
+        out = g_string_append (out, "\"}");
     else
-        s = g_string_append (s, ", \"path\": null},\n");
-
-    g_print ("%s", s->str);
-
-    g_date_time_unref (dt);
-    g_free (path);
-    g_free (dt_str);
-    g_string_free (s, TRUE);
+    {
+        g_string_truncate (out, out->len - 1);
+        out = g_string_append (out, "null}");
+    }
 }
 
 
 static void
-_print_xml_footer (void)
+_print_json_record   (rbin_struct        *record,
+                      const metarecord   *meta,
+                      GString            *out)
 {
-    g_print ("%s", "</recyclebin>\n");
+    g_return_if_fail (record != NULL);
+
+    out = g_string_append (out, "    ");
+    _append_json_object (record, meta, out);
+    out = g_string_append (out, ",\n");
 }
 
 
 static void
-_print_json_footer (void)
+_print_jsonl_record   (rbin_struct        *record,
+                       const metarecord   *meta,
+                       GString            *out)
+{
+    g_return_if_fail (record != NULL);
+
+    _append_json_object (record, meta, out);
+    out = g_string_append_c (out, '\n');
+}
+
+
+/**
+ * @brief Start Arrow IPC stream with schema message
+ * @note Unlike other formats, all Arrow output is written into output
+ * buffer, since it is binary data and must not be touched by `g_print()`
+ */
+static void
+_print_arrow_header (const metarecord *meta)
+{
+    arrow_out = arrow_writer_new (meta, out_buffer);
+}
+
+
+static void
+_print_arrow_record   (rbin_struct        *record,
+                       const metarecord   *meta,
+                       GString            *out)
+{
+    UNUSED (meta);
+    UNUSED (out);
+
+    arrow_writer_add (arrow_out, record);
+}
+
+
+static void
+_print_xml_footer (void)
+{
+    g_print ("%s", "</recyclebin>\n");
+}
+
+
+static void
+_print_json_footer (void)
 {
     g_print ("  ]\n}\n");
 }
 
 
+static void
+_print_arrow_footer (void)
+{
+    arrow_writer_finish (arrow_out);
+    arrow_out = NULL;
+    flush_out_buffer (out_buffer);
+}
+
+
+#ifdef HAVE_SQLITE
+/**
+ * @brief Write all records into SQLite database
+ * @param error Reference of `GError` pointer to store potential problem
+ * @return `TRUE` if database is written successfully, `FALSE` otherwise
+ * @note Database is created on the temp file, which is moved to
+ * destination afterwards, just like other formats
+ */
+static bool
+_dump_sqlite (GError **error)
+{
+    sqlite_writer  *w;
+    GString        *t;
+    bool            ret = true;
+
+    w = sqlite_writer_new (get_tempfile_path (), meta, error);
+    if (w == NULL)
+        return false;
+
+    t = g_string_sized_new (32);
+    for (guint i = 0; i < meta->records->len && ret; i++)
+    {
+        rbin_struct *record = g_ptr_array_index (meta->records, i);
+
+        g_string_truncate (t, 0);
+        _append_deltime (t, record->deltime, true);
+        ret = sqlite_writer_add (w, record, t->str, error);
+    }
+    g_string_free (t, TRUE);
+
+    if (! ret)
+    {
+        sqlite_writer_finish (w, NULL);
+        return false;
+    }
+    return sqlite_writer_finish (w, error);
+}
+#endif
+
+
+/**
+ * @brief Estimate lower bound of output size, for preallocating
+ * disk space of output file
+ * @return Estimated size in bytes, or 0 if it can't be estimated
+ */
+static gsize
+_estimate_output_size (void)
+{
+    // Least number of bytes needed for each record excluding path
+    static const gsize rec_size[] = {
+        [FORMAT_TEXT]  = 30,
+        [FORMAT_XML]   = 100,
+        [FORMAT_JSON]  = 80,
+        [FORMAT_JSONL] = 75,
+        [FORMAT_ARROW] = 20,
+    };
+    gsize total = 0;
+    const char *enc = r2_context_get_legacy_encoding (meta->ctx);
+
+    // Database size has nothing to do with record size
+    if (compress_method != COMPRESS_NONE || output_format == FORMAT_SQLITE)
+        return 0;
+
+    for (guint i = 0; i < meta->records->len; i++)
+    {
+        rbin_struct *record = g_ptr_array_index (meta->records, i);
+
+        total += rec_size[output_format];
+        if (enc && record->raw_legacy_path)
+            total += strnlen (record->raw_legacy_path->str,
+                record->raw_legacy_path->len);
+        else if (record->raw_uni_path)
+            total += ucs2_bytelen (record->raw_uni_path->str,
+                record->raw_uni_path->len) / 2;
+    }
+    return total;
+}
+
+
 /**
  * @brief Dump all results to screen or designated output file
  * @param error Reference of `GError` pointer to store potential problem
  * @return `TRUE` if output writing is successful, `FALSE` otherwise
+ * @note Records are formatted into a reusable buffer, which is only
+ * written out when it grows beyond `OUT_BUFFER_FLUSH_SIZE`, so
+ * that no memory allocation is needed for each record.
  */
 bool
 dump_content (GError **error)
 {
     void (*print_header_func)(const metarecord *);
-    void (*print_record_func)(rbin_struct *, const metarecord *);
+    void (*print_record_func)(rbin_struct *, const metarecord *, GString *);
     void (*print_footer_func)();
+    gint64  chunk_start;
+    guint   chunk_first = 0;
 
     // TODO use g_file_set_contents_full in glib 2.66
-    if (output_loc && ! get_tempfile (error))
+    if (output_loc &&
+        ! get_tempfile (output_loc, _estimate_output_size (),
+            output_format == FORMAT_SQLITE, error))
             return false;
 
+#ifdef HAVE_SQLITE
+    if (output_format == FORMAT_SQLITE)
+        return _dump_sqlite (error) && clean_tempfile (output_loc, error);
+#endif
+
     switch (output_format)
     {
         case FORMAT_TEXT:
@@ -1287,16 +2457,56 @@ dump_content (GError **error)
             print_record_func = &_print_json_record;
             print_footer_func = &_print_json_footer;
             break;
+        case FORMAT_JSONL:
+            print_header_func = &_print_jsonl_header;
+            print_record_func = &_print_jsonl_record;
+            print_footer_func = NULL;
+            break;
+        case FORMAT_ARROW:
+            print_header_func = &_print_arrow_header;
+            print_record_func = &_print_arrow_record;
+            print_footer_func = &_print_arrow_footer;
+            if (! set_binary_output (error))
+                return false;
+            break;
 
         default: g_assert_not_reached();
     }
 
+    if (! start_compress (compress_method, error))
+        return false;
+
+    if (out_buffer == NULL)
+        out_buffer = g_string_sized_new (OUT_BUFFER_FLUSH_SIZE * 2);
+
     if (print_header_func != NULL)
         (*print_header_func) (meta);
-    g_ptr_array_foreach (meta->records, (GFunc) print_record_func, meta);
+
+    chunk_start = trace_begin ();
+    for (guint i = 0; i < meta->records->len; i++)
+    {
+        (*print_record_func) (g_ptr_array_index (meta->records, i),
+            meta, out_buffer);
+        if (out_buffer->len >= OUT_BUFFER_FLUSH_SIZE)
+        {
+            flush_out_buffer (out_buffer);
+            trace_end (chunk_start, "output chunk", "records %u-%u",
+                chunk_first, i);
+            chunk_start = trace_begin ();
+            chunk_first = i + 1;
+        }
+    }
+    flush_out_buffer (out_buffer);
+    if (chunk_first < meta->records->len)
+        trace_end (chunk_start, "output chunk", "records %u-%u",
+            chunk_first, meta->records->len - 1);
+
     if (print_footer_func != NULL)
         (*print_footer_func) ();
 
+    if (! end_compress (error))
+        return false;
+
     if (output_loc)
         return clean_tempfile (output_loc, error);
     else
@@ -1305,8 +2515,24 @@ dump_content (GError **error)
 
 
 static void
-_dump_rec_error   (rbin_struct  *record,
-                   bool         *flag)
+_print_rec_error_headline   (const metarecord  *meta)
+{
+    if (batch_mode)
+    {
+        char *rbin_path = g_filename_display_name (meta->filename);
+        g_printerr (_("Error occurred in following record of '%s':\n"),
+            rbin_path);
+        g_free (rbin_path);
+    }
+    else
+        g_printerr ("%s\n", _("Error occurred in following record:"));
+}
+
+
+static void
+_dump_rec_error   (rbin_struct       *record,
+                   const metarecord  *meta,
+                   bool              *flag)
 {
     g_return_if_fail (record);
 
@@ -1316,10 +2542,11 @@ _dump_rec_error   (rbin_struct  *record,
     if (! *flag)
     {
         *flag = true;
-        g_printerr ("\n%s\n", _("Error occurred in following record:"));
+        g_printerr ("\n");
+        _print_rec_error_headline (meta);
     }
 
-    if (record->index_n)
+    if (has_numeric_index (meta))
         g_printerr ("%2u: %s\n", record->index_n,
                 record->error->message);
     else
@@ -1368,8 +2595,8 @@ _get_exit_code   (const GError   *error)
 }
 
 
-bool
-_has_record_error   (void)
+static bool
+_has_record_error   (const metarecord  *meta)
 {
     bool flag = false;  // Determine occasion to print headline
     GHashTableIter iter;
@@ -1379,7 +2606,7 @@ _has_record_error   (void)
     {
         flag = true;
         g_hash_table_iter_init (&iter, meta->invalid_records);
-        g_printerr ("%s\n", _("Error occurred in following record:"));
+        _print_rec_error_headline (meta);
 
         while (g_hash_table_iter_next (&iter, &key, &val))
         {
@@ -1398,13 +2625,872 @@ _has_record_error   (void)
         }
     }
 
-    g_ptr_array_foreach (meta->records,
-            (GFunc) _dump_rec_error, &flag);
+    for (guint i = 0; i < meta->records->len; i++)
+        _dump_rec_error (g_ptr_array_index (meta->records, i), meta, &flag);
 
     return flag;
 }
 
 
+/**
+ * @brief Identity of record remembered across runs
+ * @param m Metadata of recycle bin
+ * @param record The record
+ * @return Hash of record index (or index file name) and deletion time
+ */
+static uint64_t
+_record_identity   (const metarecord   *m,
+                    const rbin_struct  *record)
+{
+    uint32_t idx;
+
+    if (has_numeric_index (m))
+    {
+        idx = GUINT32_TO_LE (record->index_n);
+        return seen_set_identity (&idx, sizeof (idx), record->winfiletime);
+    }
+    return seen_set_identity (record->index_s, strlen (record->index_s),
+        record->winfiletime);
+}
+
+
+/**
+ * @brief Drop records which were output in previous runs
+ * @param m Metadata of recycle bin
+ * @return Identities of remaining records, which should only be
+ * remembered after records are written successfully
+ */
+static uint64_t *
+_drop_seen_records   (metarecord  *m)
+{
+    GPtrArray  *r = m->records;
+    uint64_t   *ids = g_new (uint64_t, r->len + 1);
+    guint       kept = 0;
+
+    // Records are moved around, must not be freed by array
+    g_ptr_array_set_free_func (r, NULL);
+    for (guint i = 0; i < r->len; i++)
+    {
+        uint64_t id = _record_identity (m, r->pdata[i]);
+
+        if (seen_set_contains (seen_records, id))
+            free_record (r->pdata[i]);
+        else
+        {
+            ids[kept] = id;
+            r->pdata[kept++] = r->pdata[i];
+        }
+    }
+    g_ptr_array_set_size (r, kept);
+    g_ptr_array_set_free_func (r, (GDestroyNotify) free_record);
+
+    return ids;
+}
+
+
+/**
+ * @brief Run post processing of parsed recycle bin, accounting
+ * time spent and records found in statistics
+ */
+static bool
+_post_parse   (PostParseFunc   post_func,
+               metarecord     *m,
+               GError        **error)
+{
+    stats_span span;
+    bool       ret;
+
+    stats_span_begin (&span);
+    ret = post_func (m, error);
+    stats_span_end (&span, STATS_PHASE_SORT);
+
+    stats_count (STATS_RECORDS_PARSED, m->records->len);
+    stats_count (STATS_RECORDS_INVALID,
+        g_hash_table_size (m->invalid_records));
+    return ret;
+}
+
+
+/**
+ * @brief Dump content of current recycle bin, converting output
+ * problem to fatal error
+ */
+static bool
+_dump_bin   (GError  **error)
+{
+    GError     *err = NULL;
+    uint64_t   *ids = NULL;
+    stats_span  span;
+    bool        ret;
+
+    if (seen_records)
+        ids = _drop_seen_records (meta);
+
+    stats_span_begin (&span);
+    ret = dump_content (&err);
+    stats_span_end (&span, STATS_PHASE_OUTPUT);
+
+    if (ret)
+    {
+        stats_count (STATS_RECORDS_EMITTED, meta->records->len);
+        for (guint i = 0; ids && i < meta->records->len; i++)
+            seen_set_add (seen_records, ids[i]);
+        g_free (ids);
+        return true;
+    }
+
+    g_free (ids);
+
+    g_assert (err->domain == G_FILE_ERROR);
+    g_set_error_literal (error, R2_FATAL_ERROR,
+        R2_FATAL_ERROR_TEMPFILE, err->message);
+    g_error_free (err);
+    return false;
+}
+
+
+/* A single input among multiple ones */
+typedef struct _bin_job
+{
+    metarecord   *meta;
+    GPtrArray    *idxfiles;
+    GError       *error;  /* fatal problem of this input */
+    bool          done;
+} bin_job;
+
+/* Shared by all workers handling multiple inputs */
+typedef struct _batch_ctx
+{
+    ParseIdxFunc   parse_func;
+    PostParseFunc  post_func;
+    GMutex         lock;
+    GCond          cond;
+} batch_ctx;
+
+
+/**
+ * @brief Worker routine checking and parsing single input
+ * @note Each input has its own metadata and index file list,
+ * only read-only global settings are shared among workers
+ */
+static void
+_parse_bin_job   (bin_job    *job,
+                  batch_ctx  *ctx)
+{
+    metarecord *m = job->meta;
+    stats_span  span;
+    bool        found;
+
+    stats_span_begin (&span);
+    found = _check_file_args (m->filename, job->idxfiles, m->type,
+        &m->isolated_index, &job->error);
+    stats_span_end (&span, STATS_PHASE_ENUMERATE);
+
+    if (found)
+    {
+        stats_span_begin (&span);
+        for (guint i = 0; i < job->idxfiles->len; i++)
+            _parse_index_file (ctx->parse_func,
+                job->idxfiles->pdata[i], m);
+        stats_span_end (&span, STATS_PHASE_PARSE);
+        _post_parse (ctx->post_func, m, &job->error);
+    }
+
+    g_mutex_lock (&ctx->lock);
+    job->done = true;
+    g_cond_broadcast (&ctx->cond);
+    g_mutex_unlock (&ctx->lock);
+}
+
+
+/**
+ * @brief Write output of single input among multiple ones
+ * @param job The input, which must have been parsed
+ * @param seq Sequence number of input, starting from 1
+ * @return Exit code for this input
+ * @note Output file is placed inside output folder, named after
+ * sequence number and base name of input
+ */
+static exitcode
+_dump_bin_job   (bin_job   *job,
+                 guint      seq)
+{
+    extern struct _fmt_data fmt[];
+    metarecord  *saved_meta = meta;
+    char        *saved_loc  = output_loc;
+    char        *basename, *name;
+    exitcode     code;
+
+    basename = g_path_get_basename (job->meta->filename);
+    name = g_strdup_printf ("%04u-%s.%s%s", seq, basename,
+        fmt[output_format].file_ext,
+        (compress_method == COMPRESS_GZIP) ? ".gz"  :
+        (compress_method == COMPRESS_ZSTD) ? ".zst" : "");
+    output_loc = g_build_filename (saved_loc, name, NULL);
+    g_free (basename);
+    g_free (name);
+
+    // Not overwriting anything, just like single input
+    if (job->error == NULL &&
+        g_file_test (output_loc, G_FILE_TEST_EXISTS))
+        g_set_error (&job->error, R2_FATAL_ERROR, R2_FATAL_ERROR_TEMPFILE,
+            _("Output file '%s' already exists."), output_loc);
+
+    if (job->error == NULL)
+    {
+        meta = job->meta;
+        _dump_bin (&job->error);
+        meta = saved_meta;
+    }
+
+    g_free (output_loc);
+    output_loc = saved_loc;
+
+    if (job->error)
+    {
+        char *rbin_path = g_filename_display_name (job->meta->filename);
+        g_prefix_error (&job->error, "%s: ", rbin_path);
+        g_free (rbin_path);
+    }
+
+    code = _get_exit_code (job->error);
+    if (_has_record_error (job->meta) && code == EXIT_OK)
+        code = EXIT_ERR_DUBIOUS_DATA;
+
+    return code;
+}
+
+
+/**
+ * @brief Process multiple inputs, each writing to its own output file
+ * @return `FALSE` if output folder can't be created, `TRUE` otherwise.
+ * Problem of each input is reported separately, and first problem
+ * encountered determines exit code of program.
+ * @note Inputs are parsed on a thread pool, while output is written
+ * in input order by main thread as soon as each input is ready
+ */
+static bool
+_process_batch   (ParseIdxFunc    parse_func,
+                  PostParseFunc   post_func,
+                  GError        **error)
+{
+    batch_ctx     ctx = { .parse_func = parse_func, .post_func = post_func };
+    GThreadPool  *pool;
+    bin_job      *jobs;
+
+    if (0 != g_mkdir_with_parents (output_loc, 0755))
+    {
+        int e = errno;
+        g_set_error (error, R2_FATAL_ERROR, R2_FATAL_ERROR_TEMPFILE,
+            _("Can not create output folder '%s': %s"),
+            output_loc, g_strerror (e));
+        return false;
+    }
+
+    g_mutex_init (&ctx.lock);
+    g_cond_init (&ctx.cond);
+    jobs = g_new0 (bin_job, inputs->len);
+
+    pool = g_thread_pool_new ((GFunc) _parse_bin_job, &ctx,
+        (gint) g_get_num_processors (), FALSE, NULL);
+
+    for (guint i = 0; i < inputs->len; i++)
+    {
+        jobs[i].meta = _new_meta (meta->type, meta);
+        jobs[i].meta->filename = g_strdup (inputs->pdata[i]);
+        jobs[i].idxfiles = g_ptr_array_new_with_free_func (g_free);
+        g_thread_pool_push (pool, &jobs[i], NULL);
+    }
+
+    for (guint i = 0; i < inputs->len; i++)
+    {
+        exitcode code;
+
+        g_mutex_lock (&ctx.lock);
+        while (! jobs[i].done)
+            g_cond_wait (&ctx.cond, &ctx.lock);
+        g_mutex_unlock (&ctx.lock);
+
+        code = _dump_bin_job (&jobs[i], i + 1);
+        if (batch_status == EXIT_OK)
+            batch_status = code;
+
+        // Release memory early, there can be thousands of inputs
+        _free_meta (jobs[i].meta);
+        g_ptr_array_free (jobs[i].idxfiles, TRUE);
+        g_clear_error (&jobs[i].error);
+    }
+
+    g_thread_pool_free (pool, FALSE, TRUE);
+    g_free (jobs);
+    g_mutex_clear (&ctx.lock);
+    g_cond_clear (&ctx.cond);
+
+    return true;
+}
+
+
+typedef void (*PrintRecordFunc) (rbin_struct *, const metarecord *,
+                                 GString *);
+
+
+/**
+ * @brief Determine how records are output when recycle bin
+ * keeps being monitored
+ * @param error Location to store error if output is not suitable
+ * @return Record printing routine, or `NULL` upon error
+ * @note Only line based output formats are supported, so that each
+ * change can be consumed as soon as it is written
+ */
+static PrintRecordFunc
+_get_stream_print_func   (GError   **error)
+{
+    if (compress_method != COMPRESS_NONE)
+    {
+        g_set_error_literal (error, G_OPTION_ERROR,
+            G_OPTION_ERROR_BAD_VALUE,
+            _("Monitored output can not be compressed."));
+        return NULL;
+    }
+
+    switch (output_format)
+    {
+        case FORMAT_TEXT:
+            return &_print_text_record;
+        case FORMAT_JSONL:
+            return &_print_jsonl_record;
+        default:
+            g_set_error_literal (error, G_OPTION_ERROR,
+                G_OPTION_ERROR_BAD_VALUE,
+                _("Monitoring only supports 'text' or 'jsonl' format."));
+            return NULL;
+    }
+}
+
+
+static void
+_print_stream_header   (void)
+{
+    if (out_buffer == NULL)
+        out_buffer = g_string_sized_new (OUT_BUFFER_FLUSH_SIZE * 2);
+
+    if (output_format == FORMAT_JSONL)
+        _print_jsonl_header (meta);
+    else if (! no_heading)
+        _print_text_header (meta);
+    flush_output ();
+}
+
+
+/**
+ * @brief Report problems found in recycle bin being monitored
+ * @param m Metadata receiving parse result, whose invalid records
+ * are cleared afterwards
+ * @param source Index file being parsed
+ * @note Problems are reported immediately, since monitoring
+ * may never finish
+ */
+static void
+_report_stream_errors   (metarecord   *m,
+                         const char   *source)
+{
+    GHashTableIter  iter;
+    gpointer        val;
+
+    g_hash_table_iter_init (&iter, m->invalid_records);
+    while (g_hash_table_iter_next (&iter, NULL, &val))
+    {
+        char *display = g_filename_display_name (source);
+        g_printerr ("%s: %s\n", display, ((GError *) val)->message);
+        g_free (display);
+        batch_status = EXIT_ERR_DUBIOUS_DATA;
+    }
+    g_hash_table_remove_all (m->invalid_records);
+}
+
+
+/**
+ * @brief Output single record of recycle bin being monitored,
+ * and deliver it immediately
+ */
+static void
+_print_stream_record   (PrintRecordFunc   func,
+                        rbin_struct      *record)
+{
+    if (record->error)
+    {
+        if (has_numeric_index (meta))
+            g_printerr ("%u: %s\n", record->index_n, record->error->message);
+        else
+            g_printerr ("%s: %s\n", record->index_s, record->error->message);
+        batch_status = EXIT_ERR_DUBIOUS_DATA;
+    }
+
+    func (record, meta, out_buffer);
+    flush_out_buffer (out_buffer);
+    flush_output ();
+}
+
+
+static volatile sig_atomic_t stop_following = 0;
+
+
+static void
+_stop_following   (int   sig)
+{
+    UNUSED (sig);
+    stop_following = 1;
+}
+
+
+/**
+ * @brief Output records of `INFO2` file, then keep checking the file
+ * and output records appended afterwards
+ * @note Runs until interrupted by `SIGINT`, after which it returns
+ * normally, so that statistics, trace and cleanup are still done
+ */
+static bool
+_process_follow   (ParseIdxFunc    parse_func,
+                   PostParseFunc   post_func,
+                   GError        **error)
+{
+    PrintRecordFunc  func;
+    GStatBuf         st, prev_st;
+    GError          *err = NULL;
+
+    if (NULL == (func = _get_stream_print_func (error)))
+        return false;
+
+    meta->follow = true;
+    do_parse_records (parse_func);
+    _report_stream_errors (meta, meta->filename);
+
+    // Only for validation and version detection
+    post_func (meta, &err);
+    g_clear_error (&err);
+
+    _print_stream_header ();
+
+    memset (&prev_st, 0, sizeof (prev_st));
+    g_stat (meta->filename, &prev_st);
+
+    signal (SIGINT, _stop_following);
+
+    while (! stop_following)
+    {
+        for (guint i = 0; i < meta->records->len; i++)
+            _print_stream_record (func, meta->records->pdata[i]);
+        g_ptr_array_set_size (meta->records, 0);
+
+        // Only parse again when file changes, which is nearly
+        // free on local disk but not network share or disk image
+        do
+        {
+            g_usleep (FOLLOW_INTERVAL);
+            if (0 != g_stat (meta->filename, &st))
+                memset (&st, 0, sizeof (st));
+        }
+        while (! stop_following &&
+            st.st_size == prev_st.st_size &&
+            st.st_mtime == prev_st.st_mtime &&
+            st.st_ino == prev_st.st_ino);
+
+        if (stop_following)
+            break;
+
+        // A replaced or emptied INFO2 may have grown past previous
+        // offset already, so size alone can't tell it was reset;
+        // parse from first record again
+        if (st.st_ino != prev_st.st_ino || st.st_size < prev_st.st_size)
+            meta->parsed_size = 0;
+        prev_st = st;
+
+        g_debug ("'%s' changed, now %" PRId64 " bytes", meta->filename,
+            (int64_t) st.st_size);
+        if (st.st_size == 0)
+            continue;
+
+        do_parse_records (parse_func);
+        _report_stream_errors (meta, meta->filename);
+    }
+
+    signal (SIGINT, SIG_DFL);
+    return true;
+}
+
+
+#ifdef __linux__
+/* State of watch mode */
+typedef struct _watch_ctx
+{
+    ParseIdxFunc     parse_func;
+    PrintRecordFunc  print_record_func;
+    metarecord      *scratch;   /* receives result of single index file */
+    GHashTable      *known;     /* index file path -> last output record */
+} watch_ctx;
+
+
+/**
+ * @brief Parse single index file in watch mode
+ * @param ctx Watch mode state
+ * @param path The index file
+ * @return Newly parsed record, or `NULL` if index file is invalid
+ * @note Problems are reported immediately, since watch mode may
+ * never finish
+ */
+static rbin_struct *
+_watch_parse   (watch_ctx    *ctx,
+                const char   *path)
+{
+    metarecord     *m = ctx->scratch;
+    rbin_struct    *record = NULL;
+
+    ctx->parse_func (path, m);
+
+    if (m->records->len)
+    {
+        g_ptr_array_set_free_func (m->records, NULL);
+        record = m->records->pdata[0];
+        g_ptr_array_set_size (m->records, 0);
+        g_ptr_array_set_free_func (m->records, (GDestroyNotify) free_record);
+
+        // Same index file name can appear in multiple folders
+        if (inputs->len > 1)
+        {
+            g_free (record->index_s);
+            record->index_s = g_strdup (path);
+        }
+    }
+
+    _report_stream_errors (m, path);
+    return record;
+}
+
+
+/**
+ * @brief Output change of a deleted item in watch mode
+ * @param ctx Watch mode state
+ * @param dir Folder containing the changed file
+ * @param name Index file (`$I...`) or trash file (`$R...`) changed
+ * @note Record is output again whenever index file is replaced, or
+ * the trash file disappears (item restored or purged) or reappears
+ */
+static void
+_watch_sync   (watch_ctx    *ctx,
+               const char   *dir,
+               const char   *name)
+{
+    char         *idx_name = g_strdup (name);
+    char         *path;
+    rbin_struct  *old, *record;
+
+    if (g_str_has_prefix (idx_name, "$R"))
+        idx_name[1] = 'I';
+    if (! r2_is_index_name (idx_name))
+    {
+        g_free (idx_name);
+        return;
+    }
+
+    path = g_build_filename (dir, idx_name, NULL);
+    g_free (idx_name);
+    old = g_hash_table_lookup (ctx->known, path);
+
+    if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+    {
+        if (NULL == (record = _watch_parse (ctx, path)))
+            g_free (path);
+        else if (old && old->winfiletime == record->winfiletime &&
+            old->gone == record->gone)
+        {
+            free_record (record);
+            g_free (path);
+        }
+        else
+        {
+            _print_stream_record (ctx->print_record_func, record);
+            g_hash_table_replace (ctx->known, path, record);
+        }
+        return;
+    }
+
+    // Index file gone, item no more recoverable from recycle bin
+    if (old)
+    {
+        if (old->gone != FILESTATUS_GONE)
+        {
+            old->gone = FILESTATUS_GONE;
+            _print_stream_record (ctx->print_record_func, old);
+        }
+        g_hash_table_remove (ctx->known, path);
+    }
+    g_free (path);
+}
+
+
+/**
+ * @brief Check all files again after change events are lost
+ */
+static void
+_watch_rescan   (watch_ctx   *ctx)
+{
+    guint      n;
+    char     **paths;
+    GPtrArray *list = g_ptr_array_new_with_free_func (g_free);
+
+    paths = (char **) g_hash_table_get_keys_as_array (ctx->known, &n);
+    for (guint i = 0; i < n; i++)
+        g_ptr_array_add (list, g_strdup (paths[i]));
+    g_free (paths);
+
+    for (guint i = 0; i < inputs->len; i++)
+        _populate_index_file_list (list, inputs->pdata[i], NULL);
+
+    for (guint i = 0; i < list->len; i++)
+    {
+        char *dir  = g_path_get_dirname (list->pdata[i]);
+        char *name = g_path_get_basename (list->pdata[i]);
+        _watch_sync (ctx, dir, name);
+        g_free (dir);
+        g_free (name);
+    }
+    g_ptr_array_free (list, TRUE);
+}
+
+
+/**
+ * @brief Output all records of folders, then keep outputting
+ * changes until all folders are removed
+ * @return `TRUE` when all watched folders are gone, `FALSE` upon error
+ */
+static bool
+_process_watch   (ParseIdxFunc    parse_func,
+                  PostParseFunc   post_func,
+                  GError        **error)
+{
+    watch_ctx        ctx = { .parse_func = parse_func };
+    dir_watch       *w;
+    dir_watch_event  event;
+    const char      *dir, *name;
+    bool             ret = false;
+
+    if (NULL == (ctx.print_record_func = _get_stream_print_func (error)))
+        return false;
+
+    if (NULL == (w = dir_watch_new (error)))
+        return false;
+
+    // Watch before scanning, so nothing happening in between is lost
+    for (guint i = 0; i < inputs->len; i++)
+        if (! dir_watch_add (w, inputs->pdata[i], error))
+            goto watch_fail;
+
+    ctx.scratch = _new_meta (meta->type, meta);
+    ctx.known = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, (GDestroyNotify) free_record);
+
+    for (guint i = 0; i < inputs->len; i++)
+    {
+        GPtrArray *list = g_ptr_array_new_with_free_func (g_free);
+        rbin_struct *record;
+
+        if (! _populate_index_file_list (list, inputs->pdata[i], error))
+        {
+            g_ptr_array_free (list, TRUE);
+            goto watch_fail;
+        }
+        for (guint j = 0; j < list->len; j++)
+            if (NULL != (record = _watch_parse (&ctx, list->pdata[j])))
+                g_ptr_array_add (meta->records, record);
+        g_ptr_array_free (list, TRUE);
+    }
+
+    // Only for sorting and version detection, where mixed versions
+    // are fine since new files can come from anywhere
+    {
+        GError *err = NULL;
+        post_func (meta, &err);
+        g_clear_error (&err);
+    }
+
+    _print_stream_header ();
+
+    // Records now belong to watch state
+    g_ptr_array_set_free_func (meta->records, NULL);
+    for (guint i = 0; i < meta->records->len; i++)
+    {
+        rbin_struct *record = meta->records->pdata[i];
+
+        _print_stream_record (ctx.print_record_func, record);
+        g_hash_table_replace (ctx.known, (inputs->len > 1) ?
+            g_strdup (record->index_s) :
+            g_build_filename (inputs->pdata[0], record->index_s, NULL),
+            record);
+    }
+    g_ptr_array_set_size (meta->records, 0);
+    g_ptr_array_set_free_func (meta->records, (GDestroyNotify) free_record);
+
+    while (dir_watch_count (w) > 0)
+    {
+        if (! dir_watch_next (w, &event, &dir, &name, error))
+            goto watch_fail;
+
+        switch (event)
+        {
+            case DIR_WATCH_ADDED:
+            case DIR_WATCH_REMOVED:
+                _watch_sync (&ctx, dir, name);
+                break;
+            case DIR_WATCH_RESCAN:
+                _watch_rescan (&ctx);
+                break;
+            case DIR_WATCH_GONE:
+                g_debug ("Folder '%s' no more watched", dir);
+                break;
+        }
+    }
+    ret = true;
+
+    watch_fail:
+
+    if (ctx.scratch)
+    {
+        _free_meta (ctx.scratch);
+        g_hash_table_destroy (ctx.known);
+    }
+    dir_watch_free (w);
+    return ret;
+}
+#endif
+
+
+#ifdef G_OS_UNIX
+
+/* Routines needed for parsing recycle bin upon each request */
+typedef struct _serve_ctx
+{
+    ParseIdxFunc   parse_func;
+    PostParseFunc  post_func;
+    CarveScanFunc  carve_func;
+} serve_ctx;
+
+
+/**
+ * @brief Process single request, inside process forked from server
+ * @param args Arguments of request, with program name prepended
+ * @param ctx Parsing routines
+ * @return Exit code of request
+ * @note Options given to server are dropped, but resources prepared
+ * beforehand (converters and cache) are used as is. Cache is never
+ * written back by request, see `rifiuti_cleanup()`.
+ */
+static int
+_serve_request   (char       **args,
+                  serve_ctx   *ctx)
+{
+    GOptionContext *context;
+    GError         *error = NULL;
+
+    in_request = true;
+    g_clear_pointer (&serve_path, g_free);
+    g_clear_pointer (&delim, g_free);
+    g_clear_pointer (&legacy_encoding, g_free);
+    output_format = FORMAT_UNKNOWN;
+
+    context = g_option_context_new (usage_param_str);
+    g_option_context_set_summary (context, usage_summary_str);
+    _opt_ctxt_setup (&context, meta->type);
+
+    if (_opt_ctxt_parse (&context, &args, &error))
+        process_bins (ctx->parse_func, ctx->post_func, ctx->carve_func,
+            &error);
+    g_strfreev (args);
+
+    return rifiuti_cleanup (&error);
+}
+
+
+/**
+ * @brief Keep serving requests from clients connecting to socket
+ * @note Path converters, for decoding records as well as for output,
+ * are opened before serving, so that requests using same encoding
+ * as server need not pay for loading conversion modules
+ */
+static bool
+_process_serve   (ParseIdxFunc    parse_func,
+                  PostParseFunc   post_func,
+                  CarveScanFunc   carve_func,
+                  GError        **error)
+{
+    serve_ctx ctx = {
+        .parse_func = parse_func,
+        .post_func  = post_func,
+        .carve_func = carve_func,
+    };
+
+    serve_encoding = g_strdup (legacy_encoding);
+    preload_conv_cache (legacy_encoding);
+    r2_decoder_preload (meta->dec);
+
+    return serve_requests (serve_path, (ServeFunc) _serve_request,
+        &ctx, error);
+}
+
+#endif
+
+
+/**
+ * @brief Parse and dump all inputs
+ * @param parse_func Routine parsing single index file
+ * @param post_func Routine validating recycle bin after all
+ * its index files are parsed
+ * @param carve_func Routine scanning image chunk for records,
+ * or `NULL` if carving is unsupported
+ * @param error Location to store fatal error
+ * @return `TRUE` on success, `FALSE` otherwise
+ */
+bool
+process_bins   (ParseIdxFunc    parse_func,
+                PostParseFunc   post_func,
+                CarveScanFunc   carve_func,
+                GError        **error)
+{
+#ifdef G_OS_UNIX
+    if (serve_path)
+        return _process_serve (parse_func, post_func, carve_func, error);
+#endif
+
+    if (batch_mode)
+        return _process_batch (parse_func, post_func, error);
+
+#ifdef __linux__
+    if (watch_mode)
+        return _process_watch (parse_func, post_func, error);
+#endif
+
+    if (follow_mode)
+        return _process_follow (parse_func, post_func, error);
+
+    if (meta->carved)
+    {
+        stats_span span;
+        bool       ret;
+
+        g_return_val_if_fail (carve_func != NULL, false);
+        stats_span_begin (&span);
+        ret = carve_image (meta->filename, carve_func, meta,
+            meta->records, error);
+        stats_span_end (&span, STATS_PHASE_PARSE);
+        return ret && _post_parse (post_func, meta, error) &&
+            _dump_bin (error);
+    }
+
+    do_parse_records (parse_func);
+
+    return _post_parse (post_func, meta, error) && _dump_bin (error);
+}
+
+
 /**
  * @brief Dump error and perform final cleanup
  * @param error The global `GError` to process
@@ -1417,24 +3503,74 @@ rifiuti_cleanup   (GError   **error)
 
     g_return_val_if_fail (error != NULL, EXIT_ERR_UNHANDLED);
 
+    progress_stop ();
     code = _get_exit_code ((const GError *) (*error));
     g_clear_error (error);
 
-    if (_has_record_error () && code == EXIT_OK)
+    if (code == EXIT_OK)
+        code = batch_status;
+
+    if (_has_record_error (meta) && code == EXIT_OK)
         code = EXIT_ERR_DUBIOUS_DATA;
 
     g_debug ("Final cleanup...");
 
-    g_ptr_array_unref (meta->records);
-    g_hash_table_destroy (meta->invalid_records);
-    g_free (meta->filename);
-    g_free (meta);
+    // Records would be output again next time, must be noticed
+    if (seen_records)
+    {
+        if (! seen_set_save (seen_records, error))
+        {
+            g_printerr (_("Failed to update state file: %s\n"),
+                (*error)->message);
+            g_clear_error (error);
+            if (code == EXIT_OK)
+                code = EXIT_ERR_WRITE_FILE;
+        }
+        seen_set_free (seen_records);
+    }
+    g_free (state_path);
+
+#ifdef G_OS_UNIX
+    // Cache file is owned by server; were requests saving their
+    // copies, they would overwrite each other's and server's one
+    if (in_request)
+        rbin_cache_free (idx_cache);
+    else
+#endif
+    // Cache is merely an optimization, failure doesn't affect result
+    if (! rbin_cache_close (idx_cache, error))
+    {
+        g_printerr (_("Failed to update cache: %s\n"), (*error)->message);
+        g_clear_error (error);
+    }
+
+    _free_meta (meta);
+    r2_context_free (parse_ctx);
 
     g_ptr_array_free (allidxfiles, TRUE);
+    if (inputs)
+        g_ptr_array_free (inputs, TRUE);
     g_strfreev (fileargs);
+    g_free (files_from);
+    g_free (carve_path);
+    g_free (cache_dir);
     g_free (output_loc);
     g_free (legacy_encoding);
     g_free (delim);
+#ifdef G_OS_UNIX
+    g_free (serve_path);
+    g_free (serve_encoding);
+#endif
+    if (out_buffer)
+        g_string_free (out_buffer, TRUE);
+
+    stats_report ();
+    if (! trace_finish (error))
+    {
+        g_printerr (_("Failed to write trace file: %s\n"), (*error)->message);
+        g_clear_error (error);
+    }
+    free_conv_cache ();
 
     close_handles ();
 
@@ -1450,8 +3586,13 @@ void
 hexdump    (void     *start,
             size_t    size)
 {
-    GString *s = g_string_new ("");
+    GString *s;
     size_t i = 0;
+
+    if (! r2_debug_enabled ())
+        return;
+
+    s = g_string_new ("");
     while (true)
     {
         if (i % 16 == 0)
@@ -20,6 +20,9 @@
 #include <stdio.h>
 #include <glib.h>
 
+#include "utils-carve.h"
+#include "librifiuti.h"
+
 // https://stackoverflow.com/a/3599170
 #define UNUSED(x) (void)(x)
 
@@ -83,6 +86,24 @@ typedef struct _rbin_meta
 {
     rbin_type type;  /* `INFO2` or `$Recycle.bin` format */
     char *filename;  /* File or dir name of trash can itself */
+    /**
+     * @brief Parsing settings shared with librifiuti
+     * @note Owned by program, the same context is used by all
+     * recycle bins being parsed
+     */
+    const r2_context *ctx;
+    /**
+     * @brief Record decoder kept for all index files of recycle bin
+     * @note Only used by thread parsing this recycle bin, thus not
+     * for carving, where chunks are scanned concurrently
+     */
+    struct _r2_decoder *dec;
+    /**
+     * @brief Cache of parsed index files, or `NULL` if not in use
+     * @note Owned by program, shared by all recycle bins
+     * @attention For `$Recycle.bin` only
+     */
+    struct _rbin_cache *cache;
     /**
      * @brief The global recycle bin version
      * @note For `INFO2`, the value is stored in certain bytes of `INFO2` index file.
@@ -111,6 +132,32 @@ typedef struct _rbin_meta
      * @attention For `INFO2` only
      */
     bool fill_junk;
+    /**
+     * @brief Whether input is a single index file taken out of its
+     * original folder, so that existence of trashed file is unknown
+     * @attention For `$Recycle.bin` only
+     */
+    bool isolated_index;
+    /**
+     * @brief Whether records are carved from raw image, instead
+     * of being read from recycle bin
+     * @note Carved records may come from different recycle bins,
+     * thus versions can be mixed and file status is unknown
+     */
+    bool carved;
+    /**
+     * @brief Whether `INFO2` file is being followed while it grows,
+     * so that incomplete record at end of file is left for later
+     * @attention For `INFO2` only
+     */
+    bool follow;
+    /**
+     * @brief Size of `INFO2` file already parsed, up to end of last
+     * complete record. Next parse only reads records after this point,
+     * unless the file is truncated or its header changes.
+     * @attention For `INFO2` only
+     */
+    gsize parsed_size;
     /**
      * @brief List of trash file records pointer
      */
@@ -210,12 +257,20 @@ typedef struct _rbin_struct
 #define copy_field(field, buf, off1, off2) \
     memcpy(&(field), (buf) + (off1), (off2) - (off1))
 
+/* INFO2 records are identified by index number, carved records by
+   offset inside image, and all others by index file name */
+#define has_numeric_index(meta) \
+    ((meta)->type == RECYCLE_BIN_TYPE_FILE && ! (meta)->carved)
+
 /*! Every Windows use this GUID in recycle bin desktop.ini */
 #define RECYCLE_BIN_CLSID "645FF040-5081-101B-9F08-00AA002F954E"
 
 typedef void (*ParseIdxFunc)              (const char       *path,
                                            metarecord       *meta);
 
+typedef bool (*PostParseFunc)             (metarecord       *meta,
+                                           GError          **error);
+
 /* shared functions */
 bool          rifiuti_init                (rbin_type         type,
                                            char             *usage_param,
@@ -229,8 +284,15 @@ bool          dump_content                (GError          **error);
 
 exitcode      rifiuti_cleanup             (GError          **error);
 
+void          free_record                 (rbin_struct      *record);
+
 void          hexdump                     (void             *start,
                                            size_t            size);
 
 void          do_parse_records            (ParseIdxFunc      func);
 
+bool          process_bins                (ParseIdxFunc      parse_func,
+                                           PostParseFunc     post_func,
+                                           CarveScanFunc     carve_func,
+                                           GError          **error);
+
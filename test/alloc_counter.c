@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Counts heap allocations by overriding malloc() family, forwarding
+ * to glibc internal implementation. Shared by test_alloc_count and
+ * the preloaded alloc_counter library.
+ */
+
+#include <stdlib.h>
+
+#include "alloc_counter.h"
+
+extern void *__libc_malloc  (size_t size);
+extern void *__libc_calloc  (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void  __libc_free    (void *ptr);
+
+atomic_bool    alloc_counting = false;
+atomic_size_t  alloc_count    = 0;
+
+#define COUNT()                                                     \
+    do {                                                            \
+        if (atomic_load_explicit (&alloc_counting,                  \
+            memory_order_relaxed))                                  \
+            atomic_fetch_add_explicit (&alloc_count, 1,             \
+                memory_order_relaxed);                              \
+    } while (0)
+
+
+void *
+malloc (size_t size)
+{
+    COUNT();
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+    COUNT();
+    return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+    COUNT();
+    return __libc_realloc (ptr, size);
+}
+
+void
+free (void *ptr)
+{
+    __libc_free (ptr);
+}
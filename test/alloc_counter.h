@@ -0,0 +1,18 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Heap allocations made by malloc() family while counting is
+ * enabled, see alloc_counter.c
+ */
+extern atomic_bool    alloc_counting;
+extern atomic_size_t  alloc_count;
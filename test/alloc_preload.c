@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Preloaded into program to count heap allocations during whole
+ * program lifetime. Count is written to file descriptor specified
+ * in ALLOC_COUNT_FD environment variable upon exit.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "alloc_counter.h"
+
+
+__attribute__((constructor))
+static void
+_start_counting (void)
+{
+    atomic_store (&alloc_counting, true);
+}
+
+
+__attribute__((destructor))
+static void
+_report_count (void)
+{
+    const char *fd_str = getenv ("ALLOC_COUNT_FD");
+    char        buf[32];
+    int         len;
+
+    if (fd_str == NULL)
+        return;
+
+    len = snprintf (buf, sizeof (buf), "%zu\n",
+        atomic_load_explicit (&alloc_count, memory_order_relaxed));
+    if (write (atoi (fd_str), buf, (size_t) len) < 0)
+        return;
+}
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+#
+
+"""
+Reads Arrow IPC stream from stdin with pyarrow, which is independent
+from our own writer, and compares it against JSON Lines output of
+the same recycle bin.
+
+Usage: rifiuti -f arrow BIN | arrow_check.py BIN.jsonl
+
+Exit code is 77 (test skipped) when pyarrow is unavailable.
+"""
+
+import json
+import sys
+
+try:
+    import pyarrow.ipc
+except ImportError:
+    print("pyarrow is not available")
+    sys.exit(77)
+
+
+def main():
+    with open(sys.argv[1], encoding="utf-8") as f:
+        lines = [json.loads(line) for line in f]
+    expected = dict(lines[0], records=lines[1:])
+
+    reader = pyarrow.ipc.open_stream(sys.stdin.buffer.read())
+    table = reader.read_all()
+    meta = {k.decode(): v.decode() for k, v in reader.schema.metadata.items()}
+    problems = []
+
+    for key in ("format", "version", "path"):
+        if meta.get(key) != str(expected[key]):
+            problems.append("metadata %s: %r != %r"
+                            % (key, meta.get(key), expected[key]))
+
+    rows = table.to_pylist()
+    if len(rows) != len(expected["records"]):
+        problems.append("%d records, expected %d"
+                        % (len(rows), len(expected["records"])))
+
+    for row, rec in zip(rows, expected["records"]):
+        # JSON Lines output has no sub-second deletion time
+        if row["time"] is not None:
+            row["time"] = row["time"].strftime("%Y-%m-%dT%H:%M:%SZ")
+        for key in ("index", "time", "gone", "size", "path"):
+            if row[key] != rec.get(key):
+                problems.append("record %s, %s: %r != %r"
+                                % (rec["index"], key, row[key], rec.get(key)))
+
+    for p in problems:
+        print(p)
+    return 1 if problems else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,97 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Output routines must not allocate memory for each record,
+# regardless of output format
+#
+
+if(NOT TARGET test_alloc_count)
+    return()
+endif()
+
+function(addAllocCountTest id)
+    foreach(type "file" "dir")
+        if(type STREQUAL "file")
+            set(prefix f_${id})
+            set(input INFO2-empty)
+        else()
+            set(prefix d_${id})
+            set(input dir-empty)
+        endif()
+        add_test(NAME ${prefix}
+            COMMAND test_alloc_count ${type}
+                -o ${bindir}/${prefix}.output ${ARGN} ${input}
+            WORKING_DIRECTORY ${sample_dir})
+        set_tests_properties(${prefix}
+            PROPERTIES LABELS "alloc")
+        add_bintype_label(${prefix})
+    endforeach()
+endfunction()
+
+addAllocCountTest(AllocOutputText   -f text      )
+addAllocCountTest(AllocOutputXml    -f xml       )
+addAllocCountTest(AllocOutputJson   -f json      )
+addAllocCountTest(AllocOutputJsonl  -f jsonl     )
+addAllocCountTest(AllocOutputArrow  -f arrow     )
+addAllocCountTest(AllocOutputLocal  -f json -z   )
+addAllocCountTest(AllocOutputSep    -t "\\n\\t"  )
+
+# SQLite output is exempt: SQLite itself allocates a record buffer
+# and a table cursor for every inserted row, since both are released
+# whenever the prepared statement is reset. Instead, its allocations
+# are kept within budget by AllocParseSqlite below.
+
+add_test(NAME f_AllocOutputLegacy
+    COMMAND test_alloc_count file -o ${bindir}/f_AllocOutputLegacy.output
+        -l ASCII INFO2-empty
+    WORKING_DIRECTORY ${sample_dir})
+set_tests_properties(f_AllocOutputLegacy
+    PROPERTIES LABELS "info2;alloc")
+
+
+#
+# Whole program, parsing included, must not allocate more for each
+# record than a fixed budget. Generated recycle bins of N and 10N
+# records are parsed, while alloc_counter library is preloaded to
+# count allocations.
+#
+# Current budget is what parsing needs for record data itself
+# (record structure, index name, path strings, deletion time). Lower
+# it whenever per-record allocations are eliminated.
+#
+
+if(NOT TARGET alloc_counter)
+    return()
+endif()
+
+foreach(fmt text xml json jsonl arrow)
+    string(SUBSTRING ${fmt} 0 1 first)
+    string(TOUPPER ${first} first)
+    string(SUBSTRING ${fmt} 1 -1 rest)
+    add_scaling_test(AllocParse${first}${rest} xp
+        "" "-n|200" "-n|2000" 10 -f ${fmt}
+        SCALING_ARGS -r 1 -n 200 -a 4.5 LABELS alloc)
+    add_scaling_test(AllocParse${first}${rest} win10
+        "" "-n|200" "-n|2000" 10 -f ${fmt}
+        SCALING_ARGS -r 1 -n 200 -a 18.5 LABELS alloc)
+endforeach()
+
+# SQLite database can't be written to stdout. Besides, SQLite itself
+# allocates about 2 more times for each inserted row, even though
+# bound values are never copied.
+if(SQLITE_FOUND)
+    add_scaling_test(AllocParseSqlite xp
+        "" "-n|200" "-n|2000" 10 -f sqlite
+        SCALING_ARGS -r 1 -n 200 -a 6.5
+            -o ${bindir}/f_AllocParseSqlite.db LABELS alloc)
+    add_scaling_test(AllocParseSqlite win10
+        "" "-n|200" "-n|2000" 10 -f sqlite
+        SCALING_ARGS -r 1 -n 200 -a 20.5
+            -o ${bindir}/d_AllocParseSqlite.db LABELS alloc)
+endif()
+
+add_scaling_test(AllocParseLegacy win98
+    "" "-n|200" "-n|2000" 10 -l CP1252
+    SCALING_ARGS -r 1 -n 200 -a 3.5 LABELS alloc)
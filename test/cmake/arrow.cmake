@@ -0,0 +1,63 @@
+#
+# Verify Arrow IPC stream output against known good binary files.
+# Besides, stream is decoded by pyarrow (if available), which is
+# independent from our writer, and compared with JSON Lines output.
+#
+
+find_package(Python3 COMPONENTS Interpreter)
+
+function(createArrowOutputTests)
+
+set(ids
+    "ArrowInfo2Empty" "ArrowInfo2WinXP" "ArrowInfo2Win98"
+    "ArrowRdirVista" "ArrowRdirWin10"
+)
+
+set(files
+    "INFO2-empty" "INFO2-sample1" "INFO2-sample2"
+    "dir-sample1" "dir-win10-01"
+)
+
+set(encs
+    "" "" "CP1252" "" ""
+)
+
+foreach(id file enc IN ZIP_LISTS ids files encs)
+    if (IS_DIRECTORY ${sample_dir}/${file})
+        set(is_info2 0)
+    else()
+        set(is_info2 1)
+    endif()
+    set(args -f arrow)
+    if(enc)
+        list(APPEND args -l ${enc})
+    endif()
+    generate_simple_comparison_test(${id} ${is_info2}
+        ${file} ${file}.arrows "parse|arrow" ${args})
+
+    if(NOT Python3_Interpreter_FOUND OR WIN32)
+        continue()
+    endif()
+    if(is_info2)
+        set(prefix f_${id}Reader)
+        set(progname rifiuti)
+    else()
+        set(prefix d_${id}Reader)
+        set(progname rifiuti-vista)
+    endif()
+    list(JOIN args " " args)
+    add_test_using_shell(${prefix}
+        "$<TARGET_FILE:${progname}> ${args} ${file} | \
+        '${Python3_EXECUTABLE}' '${CMAKE_CURRENT_SOURCE_DIR}/arrow_check.py' \
+        ${file}.jsonl"
+        WORKING_DIRECTORY ${sample_dir})
+    set_tests_properties(${prefix}
+        PROPERTIES
+            LABELS "parse;arrow"
+            SKIP_RETURN_CODE 77)
+    add_bintype_label(${prefix})
+endforeach()
+
+endfunction()
+
+createArrowOutputTests()
@@ -0,0 +1,100 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Multiple inputs are written to separate files inside output
+# folder. They are concatenated in input order and compared with
+# concatenated reference output of each input.
+#
+
+if(WIN32)
+    return()
+endif()
+
+#
+# Parameters:
+# id (string): test ID fragment, see generate_simple_comparison_test()
+# is_info2 (bool): whether inputs are INFO2 files or recycle bin folders
+# use_list (bool): feed inputs via '--files-from -' instead of arguments
+# inputs (list): input files under sample folder, with references
+#   named after them
+#
+function(addBatchTest id is_info2 use_list)
+    if(is_info2)
+        set(prefix f_${id})
+        set(progname rifiuti)
+    else()
+        set(prefix d_${id})
+        set(progname rifiuti-vista)
+    endif()
+    set(outdir ${bindir}/${prefix}_dir)
+    set(out ${bindir}/${prefix}.output)
+    set(ref ${bindir}/${prefix}_ref.txt)
+
+    set(seq 0)
+    set(outputs)
+    set(refs)
+    set(list_str)
+    foreach(input ${ARGN})
+        math(EXPR seq "${seq} + 1")
+        string(LENGTH "000${seq}" len)
+        math(EXPR len "${len} - 4")
+        string(SUBSTRING "000${seq}" ${len} 4 num)
+        get_filename_component(base ${input} NAME)
+        string(APPEND outputs " '${outdir}/${num}-${base}.txt'")
+        string(APPEND refs " '${sample_dir}/${input}.txt'")
+        string(APPEND list_str "${input}\\0")
+    endforeach()
+
+    add_test(NAME ${prefix}_PrepPre
+        COMMAND ${CMAKE_COMMAND} -E rm -rf ${outdir})
+    if(use_list)
+        add_test_using_shell(${prefix}_Prep
+            "printf '${list_str}' | $<TARGET_FILE:${progname}> -o ${outdir} --files-from -"
+            WORKING_DIRECTORY ${sample_dir})
+    else()
+        add_test(NAME ${prefix}_Prep
+            COMMAND ${progname} -o ${outdir} ${ARGN}
+            WORKING_DIRECTORY ${sample_dir})
+    endif()
+    add_test_using_shell(${prefix}_PrepPost "cat ${outputs} > ${out}")
+    add_test_using_shell(${prefix}_PrepAlt "cat ${refs} > ${ref}")
+    add_test(NAME ${prefix}_CleanAlt
+        COMMAND ${CMAKE_COMMAND} -E rm -rf ${outdir})
+
+    generate_simple_comparison_test(${id} ${is_info2}
+        "" ${ref} "batch")
+endfunction()
+
+addBatchTest(Batch 1 0 INFO2-sample1 INFO2-empty INFO2-03-tw-uncpath)
+addBatchTest(Batch 0 0 dir-sample1 dir-empty dir-2019-uncpath)
+addBatchTest(BatchList 1 1 INFO2-empty INFO2-sample1)
+addBatchTest(BatchList 0 1 dir-win10-01 dir-sample1)
+
+#
+# Problem in one input doesn't stop processing of others
+#
+
+add_test(NAME f_BatchBadInput
+    COMMAND rifiuti -o ${bindir}/f_BatchBadInput_dir
+        INFO2-sample1 dUmMy INFO2-empty
+    WORKING_DIRECTORY ${sample_dir})
+add_test(NAME f_BatchBadInput_Check
+    COMMAND ${CMAKE_COMMAND} -E compare_files --ignore-eol
+        ${bindir}/f_BatchBadInput_dir/0003-INFO2-empty.txt
+        ${sample_dir}/INFO2-empty.txt)
+add_test(NAME f_BatchBadInput_Clean
+    COMMAND ${CMAKE_COMMAND} -E rm -rf ${bindir}/f_BatchBadInput_dir)
+set_tests_properties(f_BatchBadInput
+    PROPERTIES
+        LABELS "info2;batch;xfail"
+        FIXTURES_SETUP F_BATCHBADINPUT
+        PASS_REGULAR_EXPRESSION "dUmMy: 'dUmMy' does not exist")
+set_tests_properties(f_BatchBadInput_Check
+    PROPERTIES
+        LABELS "info2;batch"
+        FIXTURES_REQUIRED F_BATCHBADINPUT)
+set_tests_properties(f_BatchBadInput_Clean
+    PROPERTIES
+        FIXTURES_CLEANUP F_BATCHBADINPUT)
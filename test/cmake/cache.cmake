@@ -0,0 +1,72 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Recycle bin is parsed once with cache, then an index file is
+# modified in place while keeping its size and time stamp. Output
+# of second run must come from cache, thus identical to original.
+#
+
+if(WIN32)
+    return()
+endif()
+
+set(prefix d_Cache)
+set(tree ${bindir}/${prefix}_tree)
+set(cachedir ${bindir}/${prefix}_dir)
+set(out ${bindir}/${prefix}.output)
+set(ref ${bindir}/${prefix}_ref.txt)
+
+add_test_using_shell(${prefix}_PrepPre
+    "rm -rf '${tree}' '${cachedir}' '${out}' && mkdir '${tree}' && \
+    cp '${sample_dir}/dir-sample1/'* '${tree}/' && \
+    touch -t 202001010000 '${tree}/'* '${tree}' && \
+    $<TARGET_FILE:rifiuti-vista> --cache '${cachedir}' '${tree}' > /dev/null && \
+    printf X | dd of='${tree}/$I0JGHX7' bs=1 seek=30 conv=notrunc status=none && \
+    touch -t 202001010000 '${tree}/$I0JGHX7'")
+add_test(NAME ${prefix}_Prep
+    COMMAND rifiuti-vista -n --cache ${cachedir} ${tree} -o ${out})
+add_test_using_shell(${prefix}_PrepAlt
+    "sed '1,/^Index/d' '${sample_dir}/dir-sample1.txt' > '${ref}'")
+add_test(NAME ${prefix}_CleanAlt
+    COMMAND ${CMAKE_COMMAND} -E rm -rf ${tree} ${cachedir})
+
+generate_simple_comparison_test(Cache 0 "" ${ref} "cache")
+
+add_test(NAME d_CacheBadDir
+    COMMAND rifiuti-vista --cache ${sample_dir}/dir-empty.txt
+        ${sample_dir}/dir-sample1)
+set_tests_properties(d_CacheBadDir
+    PROPERTIES
+        LABELS "recycledir;cache;xfail"
+        PASS_REGULAR_EXPRESSION "Can not create cache folder")
+
+# Recycle bins gone since last run are dropped from cache, while
+# those merely not checked in this run are kept
+set(prefix d_CachePrune)
+set(tree ${bindir}/${prefix}_tree)
+set(cachedir ${bindir}/${prefix}_dir)
+
+add_test_using_shell(${prefix}_Prep
+    "rm -rf '${tree}'* '${cachedir}' && \
+    for t in gone kept checked; do mkdir '${tree}'_$t && \
+    cp '${sample_dir}/dir-sample1/'* '${tree}'_$t/ && \
+    touch -t 202001010000 '${tree}'_$t/* '${tree}'_$t && \
+    $<TARGET_FILE:rifiuti-vista> --cache '${cachedir}' '${tree}'_$t \
+        > /dev/null || exit 1; done && \
+    rm -rf '${tree}_gone' && \
+    $<TARGET_FILE:rifiuti-vista> --cache '${cachedir}' '${tree}_checked' \
+        > /dev/null")
+add_test_using_shell(${prefix}
+    "! grep -q '_gone' '${cachedir}/rifiuti2-index.cache' && \
+    grep -c '^D.*_kept$' '${cachedir}/rifiuti2-index.cache' && \
+    grep -c '^F.*_checked/' '${cachedir}/rifiuti2-index.cache'")
+add_test(NAME ${prefix}_Clean
+    COMMAND ${CMAKE_COMMAND} -E rm -rf
+        ${tree}_kept ${tree}_checked ${cachedir})
+set_fixture_with_dep(${prefix})
+set_tests_properties(${prefix}
+    PROPERTIES
+        LABELS "recycledir;cache"
+        PASS_REGULAR_EXPRESSION "^1\n15\n$")
@@ -0,0 +1,71 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Index files are scattered inside a fake disk image at cluster
+# boundaries, surrounded by empty and random data, then carved
+# out of the image. Output without heading is compared with
+# reference. For INFO2, header of some files are stripped.
+#
+
+if(WIN32)
+    return()
+endif()
+
+function(addCarveTest is_info2)
+    if(is_info2)
+        set(prefix f_Carve)
+        set(progname rifiuti)
+        set(inputs "'${sample_dir}/INFO2-sample1' \
+            '${sample_dir}/INFO2-2k-tw-uncpath'")
+        # First file only
+        set(filter "[ \"$f\" = '${sample_dir}/INFO2-sample1' ] && tail -c +21 || cat")
+        set(ref carve-info2.txt)
+    else()
+        set(prefix d_Carve)
+        set(progname rifiuti-vista)
+        set(inputs "'${sample_dir}/dir-mixed/'* \
+            '${sample_dir}/dir-2019-uncpath/$I4OZLXW.bmp' \
+            '${sample_dir}/dir-sample1/$IC6GEAW.exe'")
+        set(filter "cat")
+        set(ref carve-dir.txt)
+    endif()
+    set(image ${bindir}/${prefix}.img)
+    set(part ${bindir}/${prefix}.part)
+    set(out ${bindir}/${prefix}.output)
+
+    add_test_using_shell(${prefix}_PrepPre
+        "rm -f '${out}' && head -c 4096 /dev/zero > '${image}' && \
+        for f in ${inputs}; do \
+            { ${filter}; } < \"$f\" > '${part}' && \
+            dd if='${part}' bs=4096 conv=sync status=none >> '${image}'; \
+        done && head -c 5000 /dev/urandom >> '${image}'")
+    add_test(NAME ${prefix}_Prep
+        COMMAND ${progname} -n --carve ${image} -o ${out})
+    add_test(NAME ${prefix}_CleanAlt
+        COMMAND ${CMAKE_COMMAND} -E rm -f ${image} ${part})
+
+    generate_simple_comparison_test(Carve ${is_info2}
+        "" ${ref} "carve")
+endfunction()
+
+addCarveTest(1)
+addCarveTest(0)
+
+add_test(NAME d_CarveWithInput
+    COMMAND rifiuti-vista --carve ${sample_dir}/dir-empty.txt
+        ${sample_dir}/dir-empty)
+set_tests_properties(d_CarveWithInput
+    PROPERTIES
+        LABELS "recycledir;carve;xfail"
+        PASS_REGULAR_EXPRESSION "must not be used together with other inputs")
+
+# Size of devices is not known before mapping, so only regular
+# files are accepted
+add_test(NAME d_CarveNotFile
+    COMMAND rifiuti-vista --carve ${sample_dir}/dir-empty)
+set_tests_properties(d_CarveNotFile
+    PROPERTIES
+        LABELS "recycledir;carve;xfail"
+        PASS_REGULAR_EXPRESSION "is not a regular file")
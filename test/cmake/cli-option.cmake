@@ -122,6 +122,8 @@ addBadComboOptTest(2 -n -f xml)
 # explicit option conflict
 addBadComboOptTest(3 -f tsv -f json)
 addBadComboOptTest(4 -f xml -f text)
+addBadComboOptTest(5 -f json -f jsonl)
+addBadComboOptTest(6 -f arrow -n)
 
 
 function(addMultiInputTest name)
@@ -130,7 +132,7 @@ function(addMultiInputTest name)
     set_tests_properties(d_MultiInputTest${name} f_MultiInputTest${name}
         PROPERTIES
             LABELS "arg;xfail"
-            PASS_REGULAR_EXPRESSION "Must specify exactly one")
+            PASS_REGULAR_EXPRESSION "Multiple inputs require output folder")
     add_bintype_label(d_MultiInputTest${name} f_MultiInputTest${name})
 endfunction()
 
@@ -144,7 +146,7 @@ function(addMissingInputTest name)
     set_tests_properties(d_MissingInputTest${name} f_MissingInputTest${name}
         PROPERTIES
             LABELS "arg;xfail"
-            PASS_REGULAR_EXPRESSION "Must specify exactly one")
+            PASS_REGULAR_EXPRESSION "Must specify at least one")
     add_bintype_label(d_MissingInputTest${name} f_MissingInputTest${name})
 endfunction()
 
@@ -204,3 +206,21 @@ set_tests_properties(d_LiveProbeOpt
         SKIP_REGULAR_EXPRESSION "No such file or directory;Unknown option --live"
         PASS_REGULAR_EXPRESSION "\\(current system\\)")
 
+
+# Per record debug messages, which are dropped in release builds
+
+foreach(domain all rifiuti2)
+    add_test(NAME f_DebugMsg_${domain}
+        COMMAND rifiuti ${sample_dir}/INFO2-sample1)
+    set_tests_properties(f_DebugMsg_${domain}
+        PROPERTIES
+            LABELS "info2;arg"
+            ENVIRONMENT "G_MESSAGES_DEBUG=${domain}")
+    if(CMAKE_BUILD_TYPE MATCHES "^(Release|RelWithDebInfo|MinSizeRel)$")
+        set_tests_properties(f_DebugMsg_${domain}
+            PROPERTIES FAIL_REGULAR_EXPRESSION "index=")
+    else()
+        set_tests_properties(f_DebugMsg_${domain}
+            PROPERTIES PASS_REGULAR_EXPRESSION "index=71\n.*drive=2\n")
+    endif()
+endforeach()
@@ -0,0 +1,75 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Compressed output is decompressed with external program, and
+# compared with uncompressed reference output
+#
+
+#
+# Parameters:
+# id (string): test ID fragment, see generate_simple_comparison_test()
+# is_info2 (bool): whether input is INFO2 file or recycle bin folder
+# input (path): input file under sample folder
+# ref (path): reference file under sample folder
+# ext (str): compressed output file extension
+# decomp (list): command decompressing output to stdout
+#
+function(addCompressTest id is_info2 input ref ext decomp)
+    if(is_info2)
+        set(prefix f_${id})
+        set(progname rifiuti)
+    else()
+        set(prefix d_${id})
+        set(progname rifiuti-vista)
+    endif()
+    set(out ${bindir}/${prefix}.output)
+
+    add_test(NAME ${prefix}_Prep
+        COMMAND ${progname} -o ${out}${ext} ${ARGN} ${input}
+        WORKING_DIRECTORY ${sample_dir})
+    add_test_using_shell(${prefix}_PrepPost
+        "${decomp} '${out}${ext}' > '${out}'")
+    add_test(NAME ${prefix}_CleanAlt
+        COMMAND ${CMAKE_COMMAND} -E rm -f ${out}${ext})
+
+    generate_simple_comparison_test(${id} ${is_info2}
+        "" ${ref} "compress")
+endfunction()
+
+if(WIN32)
+    return()
+endif()
+
+if(ZLIB_FOUND AND GZIP_PROG)
+    addCompressTest(GzipText 1 INFO2-sample1
+        INFO2-sample1.txt ".gz" "${GZIP_PROG} -dc")
+    addCompressTest(GzipJson 0 dir-win10-01
+        dir-win10-01.json ".json.gz" "${GZIP_PROG} -dc" -f json)
+    addCompressTest(GzipExplicit 0 dir-sample1
+        dir-sample1.xml ".xml" "${GZIP_PROG} -dc" -f xml --compress gzip)
+endif()
+
+if(ZSTD_FOUND AND ZSTD_PROG)
+    addCompressTest(ZstdText 1 INFO2-sample1
+        INFO2-sample1.txt ".zst" "${ZSTD_PROG} -dcq")
+    addCompressTest(ZstdJsonl 0 dir-win10-01
+        dir-win10-01.jsonl ".jsonl.zst" "${ZSTD_PROG} -dcq" -f jsonl)
+endif()
+
+# Compression doesn't apply to database
+add_test(NAME f_CompressSqlite
+    COMMAND rifiuti -f sqlite -o ${bindir}/f_CompressSqlite.db.gz
+        ${sample_dir}/INFO2-sample1)
+set_tests_properties(f_CompressSqlite
+    PROPERTIES
+        LABELS "info2;arg;xfail"
+        PASS_REGULAR_EXPRESSION "can not be compressed|not supported")
+
+add_test(NAME f_CompressBadMethod
+    COMMAND rifiuti --compress lzma ${sample_dir}/INFO2-sample1)
+set_tests_properties(f_CompressBadMethod
+    PROPERTIES
+        LABELS "info2;arg;xfail"
+        PASS_REGULAR_EXPRESSION "Illegal compression method 'lzma'")
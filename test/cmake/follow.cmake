@@ -0,0 +1,85 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# INFO2 file is followed while remaining records are appended,
+# including a partial record, then recycle bin is emptied and
+# one record added. Every record shall be output exactly once.
+#
+
+if(WIN32)
+    return()
+endif()
+
+set(prefix f_Follow)
+set(info2 ${bindir}/${prefix}_INFO2)
+set(out ${bindir}/${prefix}.output)
+set(ref ${bindir}/${prefix}_ref.txt)
+set(sample ${sample_dir}/INFO2-sample1)
+
+# Wait until output reaches certain number of lines
+set(waitcmd "i=0; while [ $(wc -l < '${out}') -lt LINES ] && \
+    [ $i -lt 100 ]; do sleep 0.1; i=$((i+1)); done")
+string(REPLACE LINES 5 wait_initial "${waitcmd}")
+string(REPLACE LINES 16 wait_append "${waitcmd}")
+string(REPLACE LINES 17 wait_reset "${waitcmd}")
+
+# 5 records, then 1 record and a half, then the rest
+add_test_using_shell(${prefix}_Prep
+    "rm -f '${out}' && head -c 4020 '${sample}' > '${info2}' && \
+    : > '${out}' && \
+    { $<TARGET_FILE:rifiuti> -n --follow '${info2}' > '${out}' & \
+    pid=$!; } && ${wait_initial} && \
+    tail -c +4021 '${sample}' | head -c 1200 >> '${info2}' && \
+    sleep 1 && tail -c +5221 '${sample}' >> '${info2}' && \
+    ${wait_append} && head -c 820 '${sample}' > '${info2}' && \
+    ${wait_reset}; kill $pid")
+set_tests_properties(${prefix}_Prep PROPERTIES TIMEOUT 60)
+add_test_using_shell(${prefix}_PrepAlt
+    "sed '1,/^Index/d' '${sample}.txt' > '${ref}' && \
+    sed '1,/^Index/d' '${sample}.txt' | head -n 1 >> '${ref}'")
+add_test(NAME ${prefix}_CleanAlt
+    COMMAND ${CMAKE_COMMAND} -E rm -f ${info2})
+
+generate_simple_comparison_test(Follow 1 "" ${ref} "follow")
+
+add_test(NAME f_FollowMultiple
+    COMMAND rifiuti --follow ${sample_dir}/INFO2-sample1
+        ${sample_dir}/INFO2-sample2)
+set_tests_properties(f_FollowMultiple
+    PROPERTIES
+        LABELS "info2;follow;xfail"
+        PASS_REGULAR_EXPRESSION "only accepts single file")
+
+
+#
+# INFO2 file is replaced by a larger one before next check, so only
+# inode change tells it is not the same file. Whole new file shall
+# be output, and SIGINT shall end following gracefully.
+#
+
+set(prefix f_FollowReplace)
+set(info2 ${bindir}/${prefix}_INFO2)
+set(out ${bindir}/${prefix}.output)
+set(ref ${bindir}/${prefix}_ref.txt)
+
+string(REPLACE "${bindir}/f_Follow.output" "${out}" waitcmd "${waitcmd}")
+string(REPLACE LINES 5 wait_initial "${waitcmd}")
+string(REPLACE LINES 21 wait_replace "${waitcmd}")
+
+add_test_using_shell(${prefix}_Prep
+    "rm -f '${out}' && head -c 4020 '${sample}' > '${info2}' && \
+    : > '${out}' && \
+    { $<TARGET_FILE:rifiuti> -n --follow '${info2}' > '${out}' & \
+    pid=$!; } && ${wait_initial} && \
+    cp '${sample}' '${info2}.new' && mv '${info2}.new' '${info2}' && \
+    ${wait_replace}; kill -INT $pid && wait $pid")
+set_tests_properties(${prefix}_Prep PROPERTIES TIMEOUT 60)
+add_test_using_shell(${prefix}_PrepAlt
+    "sed '1,/^Index/d' '${sample}.txt' | head -n 5 > '${ref}' && \
+    sed '1,/^Index/d' '${sample}.txt' >> '${ref}'")
+add_test(NAME ${prefix}_CleanAlt
+    COMMAND ${CMAKE_COMMAND} -E rm -f ${info2})
+
+generate_simple_comparison_test(FollowReplace 1 "" ${ref} "follow")
@@ -0,0 +1,67 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Hostile recycle bins crafted to drive path conversion into its
+# slow paths: undecodable characters which are escaped one by one,
+# characters expanding most after conversion or escaping, and
+# absurd path length in index file header. Parsing time and memory
+# usage must grow no more than linearly with input size, whether
+# it is size of each record or number of records.
+#
+
+if(NOT TARGET test_scaling)
+    return()
+endif()
+
+
+#
+# Every char of path is broken, thus escaped individually
+#
+
+add_scaling_test(HostileBrokenPath win10
+    "-n|1|-p|broken" "-L|20000" "-L|160000" 8)
+
+add_scaling_test(HostileBrokenUnicode xp
+    "-p|broken" "-n|500" "-n|4000" 8)
+
+add_scaling_test(HostileBrokenLegacy win98
+    "-p|broken" "-n|500" "-n|4000" 8 -l CP932)
+
+add_scaling_test(HostileBrokenRecords win10
+    "-p|broken|-L|259" "-n|500" "-n|4000" 8)
+
+
+#
+# Non-printable chars expanding most when escaped in each format
+#
+
+add_scaling_test(HostileControlText win10
+    "-n|1|-p|control" "-L|20000" "-L|160000" 8)
+
+add_scaling_test(HostileControlJson win10
+    "-n|1|-p|control" "-L|20000" "-L|160000" 8 -f json)
+
+add_scaling_test(HostileControlXml win10
+    "-n|1|-p|control" "-L|20000" "-L|160000" 8 -f xml)
+
+
+#
+# CJK chars, whose UTF-8 form is 1.5 times as long as UTF-16
+#
+
+add_scaling_test(HostileCjkPath win10
+    "-n|1|-p|cjk" "-L|20000" "-L|160000" 8)
+
+add_scaling_test(HostileCjkLegacy win98
+    "-p|cjk" "-n|500" "-n|4000" 8 -l CP932)
+
+
+#
+# File name length field claims 4G chars, which must not cost
+# more than honest index files of same size
+#
+
+add_scaling_test(HostileHugeLength win10
+    "-n|200|-p|cjk|-L|1000" "" "-H" 1)
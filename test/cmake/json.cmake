@@ -39,3 +39,42 @@ endforeach()
 endfunction()
 
 createJsonOutputTests()
+
+
+#
+# Verify JSON Lines output, one record per line
+#
+
+function(createJsonlOutputTests)
+
+set(ids
+    "JsonlInfo2Empty" "JsonlInfo2WinXP" "JsonlInfo2Win98"
+    "JsonlRdirVista" "JsonlRdirWin10"
+)
+
+set(files
+    "INFO2-empty" "INFO2-sample1" "INFO2-sample2"
+    "dir-sample1" "dir-win10-01"
+)
+
+set(encs
+    "" "" "CP1252" "" ""
+)
+
+foreach(id file enc IN ZIP_LISTS ids files encs)
+    if (IS_DIRECTORY ${sample_dir}/${file})
+        set(is_info2 0)
+    else()
+        set(is_info2 1)
+    endif()
+    set(args -f jsonl)
+    if(enc)
+        list(APPEND args -l ${enc})
+    endif()
+    generate_simple_comparison_test(${id} ${is_info2}
+        ${file} ${file}.jsonl "parse|json" ${args})
+endforeach()
+
+endfunction()
+
+createJsonlOutputTests()
@@ -0,0 +1,54 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Recycle bins are parsed concurrently in same process through
+# library API. Records of $Recycle.bin are iterated in file name
+# order, instead of deletion time order.
+#
+
+if(WIN32)
+    return()
+endif()
+
+set(prefix d_Library)
+set(out ${bindir}/${prefix}.output)
+set(ref ${bindir}/${prefix}_ref.txt)
+
+add_test_using_shell(${prefix}_Prep
+    "$<TARGET_FILE:test_librifiuti> dir-sample1 INFO2-sample1 \
+    dir-win10-01 > '${out}'"
+    WORKING_DIRECTORY ${sample_dir})
+add_test_using_shell(${prefix}_PrepAlt
+    "for i in dir-sample1 INFO2-sample1 dir-win10-01; do \
+    sed '1,/^Index/d' \"$i.txt\" | \
+    { case $i in dir-*) LC_ALL=C sort ;; *) cat ;; esac; }; \
+    done > '${ref}'"
+    WORKING_DIRECTORY ${sample_dir})
+
+generate_simple_comparison_test(Library 0 "" ${ref} "library")
+
+#
+# Library and command line programs share the same record decoder,
+# so problems found in each record must be identical, apart from
+# offsets of broken characters which are only found during output.
+#
+
+set(prefix d_LibraryRecError)
+set(out ${bindir}/${prefix}.output)
+set(ref ${bindir}/${prefix}_ref.txt)
+
+add_test_using_shell(${prefix}_Prep
+    "$<TARGET_FILE:test_librifiuti> dir-bad-uni INFO2-trunc \
+    dir-badfiles 2> '${out}' > /dev/null"
+    WORKING_DIRECTORY ${sample_dir})
+add_test_using_shell(${prefix}_PrepAlt
+    "{ $<TARGET_FILE:rifiuti-vista> dir-bad-uni; \
+    $<TARGET_FILE:rifiuti> INFO2-trunc; \
+    $<TARGET_FILE:rifiuti-vista> dir-badfiles; } 2>&1 > /dev/null | \
+    sed -e '/^$/d' -e '/^Error occurred/d' \
+    -e 's/, at offset:.*//' -e 's/^ *//' > '${ref}'"
+    WORKING_DIRECTORY ${sample_dir})
+
+generate_simple_comparison_test(LibraryRecError 0 "" ${ref} "library")
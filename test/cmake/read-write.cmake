@@ -80,3 +80,30 @@ generate_simple_comparison_test("UnicodePathName" 1
     "./ごみ箱/INFO2-empty" "japanese-path-file.txt" "encoding")
 generate_simple_comparison_test("UnicodePathName" 0
     "./ごみ箱/dir-empty" "japanese-path-dir.txt" "encoding")
+
+#
+# Temp file is created beside destination, and no trace of it
+# is left there once output is written
+#
+
+if(NOT WIN32)
+foreach(input "dir-sample1" "INFO2-sample1")
+    if(IS_DIRECTORY ${sample_dir}/${input})
+        set(prog rifiuti-vista)
+        set(prefix d_TempFileBesideDest)
+    else()
+        set(prog rifiuti)
+        set(prefix f_TempFileBesideDest)
+    endif()
+    set(outdir ${bindir}/${prefix})
+
+    add_test_using_shell(${prefix}
+        "rm -rf ${outdir} && mkdir ${outdir} && $<TARGET_FILE:${prog}> -o ${outdir}/out.txt ${input} && ls -A ${outdir}; rm -rf ${outdir}"
+        WORKING_DIRECTORY ${sample_dir})
+    set_tests_properties(${prefix}
+        PROPERTIES
+            LABELS "write"
+            PASS_REGULAR_EXPRESSION "^out\\.txt\n$")
+    add_bintype_label(${prefix})
+endforeach()
+endif()
@@ -0,0 +1,69 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Recycle bins of both layouts are copied into a fake disk tree,
+# then searched recursively. Output without heading is compared
+# with records of reference output, in path order.
+#
+
+if(WIN32)
+    return()
+endif()
+
+function(addRecursiveTest is_info2)
+    if(is_info2)
+        set(prefix f_Recursive)
+        set(progname rifiuti)
+        set(refs INFO2-sample1.txt INFO2-empty.txt)
+        set(others "S-1-5-21-1\n.+S-1-5-21-4\n")
+    else()
+        set(prefix d_Recursive)
+        set(progname rifiuti-vista)
+        set(refs dir-sample1.txt dir-win10-01.txt)
+        set(others "RECYCLER.S-1-5-21-3.INFO2\n.+RECYCLED.INFO2\n")
+    endif()
+    set(tree ${bindir}/${prefix}_tree)
+    set(outdir ${bindir}/${prefix}_dir)
+    set(out ${bindir}/${prefix}.output)
+    set(ref ${bindir}/${prefix}_ref.txt)
+    list(JOIN refs " " refs)
+
+    add_test_using_shell(${prefix}_PrepPre
+        "rm -rf '${tree}' '${outdir}' && \
+        mkdir -p '${tree}/c/$Recycle.Bin/S-1-5-21-1' \
+            '${tree}/c/$Recycle.Bin/S-1-5-21-2' \
+            '${tree}/d/RECYCLER/S-1-5-21-3' '${tree}/e/RECYCLED' \
+            '${tree}/f/deep/$RECYCLE.BIN/S-1-5-21-4' && \
+        cp '${sample_dir}/dir-sample1/'* '${tree}/c/$Recycle.Bin/S-1-5-21-1/' && \
+        cp '${sample_dir}/dir-win10-01/'* '${tree}/f/deep/$RECYCLE.BIN/S-1-5-21-4/' && \
+        cp '${sample_dir}/INFO2-sample1' '${tree}/d/RECYCLER/S-1-5-21-3/INFO2' && \
+        cp '${sample_dir}/INFO2-empty' '${tree}/e/RECYCLED/INFO2'")
+    add_test(NAME ${prefix}_Prep
+        COMMAND ${progname} -n --recursive ${tree} -o ${outdir})
+    add_test_using_shell(${prefix}_PrepPost "cat '${outdir}/'* > '${out}'")
+    add_test_using_shell(${prefix}_PrepAlt
+        "cd '${sample_dir}' && for f in ${refs}; do sed '1,/^Index/d' $f; done > '${ref}'")
+    add_test(NAME ${prefix}_CleanAlt
+        COMMAND ${CMAKE_COMMAND} -E rm -rf ${tree} ${outdir})
+
+    generate_simple_comparison_test(Recursive ${is_info2}
+        "" ${ref} "batch")
+
+    # Bins of other layout are listed
+    set_tests_properties(${prefix}_Prep
+        PROPERTIES
+            PASS_REGULAR_EXPRESSION "2 recycle bin\\(s\\) of .+ format found.+${others}")
+endfunction()
+
+addRecursiveTest(1)
+addRecursiveTest(0)
+
+add_test(NAME d_RecursiveNotFound
+    COMMAND rifiuti-vista --recursive ${sample_dir}/dir-empty
+        -o ${bindir}/d_RecursiveNotFound_dir)
+set_tests_properties(d_RecursiveNotFound
+    PROPERTIES
+        LABELS "recycledir;batch;xfail"
+        PASS_REGULAR_EXPRESSION "No recycle bin is found")
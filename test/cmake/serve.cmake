@@ -0,0 +1,102 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Resident process serves requests from clients concurrently.
+# Output of each request must be identical to that of normal
+# program run, and exit code is passed back to client. Server runs
+# elsewhere, so relative paths must be resolved against client
+# working directory.
+#
+
+if(WIN32)
+    return()
+endif()
+
+foreach(is_info2 1 0)
+    if(is_info2)
+        set(prefix f_Serve)
+        set(prog $<TARGET_FILE:rifiuti>)
+        set(req1 "-f json INFO2-sample1")
+        set(req2 "INFO2-sample1")
+        set(refs "INFO2-sample1.json INFO2-sample1.txt")
+    else()
+        set(prefix d_Serve)
+        set(prog $<TARGET_FILE:rifiuti-vista>)
+        set(req1 "dir-sample1")
+        set(req2 "-f jsonl dir-win10-01")
+        set(refs "dir-sample1.txt dir-win10-01.jsonl")
+    endif()
+
+    set(sock ${bindir}/${prefix}.sock)
+    set(out ${bindir}/${prefix}.output)
+    set(ref ${bindir}/${prefix}_ref.txt)
+    set(client "$<TARGET_FILE:test_serve_client> '${sock}'")
+
+    add_test_using_shell(${prefix}_Prep
+        "rm -f '${sock}' && \
+        { (cd / && exec ${prog} --serve '${sock}') & pid=$!; } && \
+        { ${client} ${req1} > '${out}.1' & c1=$!; } && \
+        ${client} ${req2} > '${out}.2'; r2=$?; wait $c1; r1=$?; \
+        ${client} -o '${out}.3' ${req2} 2>&1 | grep -q 'back to client'; \
+        r3=$?; kill $pid; wait $pid; \
+        cat '${out}.1' '${out}.2' > '${out}' && rm -f '${out}'.? && \
+        [ $r1 -eq 0 ] && [ $r2 -eq 0 ] && [ $r3 -eq 0 ] && \
+        [ ! -e '${sock}' ]"
+        WORKING_DIRECTORY ${sample_dir})
+    set_tests_properties(${prefix}_Prep PROPERTIES TIMEOUT 60)
+    add_test_using_shell(${prefix}_PrepAlt
+        "cat ${refs} > '${ref}'"
+        WORKING_DIRECTORY ${sample_dir})
+
+    generate_simple_comparison_test(Serve ${is_info2} "" ${ref} "serve")
+endforeach()
+
+add_test(NAME d_ServeWithInput
+    COMMAND rifiuti-vista --serve ${bindir}/d_ServeWithInput.sock
+        ${sample_dir}/dir-sample1)
+set_tests_properties(d_ServeWithInput
+    PROPERTIES
+        LABELS "recycledir;serve;xfail"
+        PASS_REGULAR_EXPRESSION "only accepts inputs")
+
+# Cache file belongs to server, requests must not write it back
+set(cachedir ${bindir}/d_ServeCache_dir)
+set(sock ${bindir}/d_ServeCache.sock)
+add_test_using_shell(d_ServeCache
+    "rm -rf '${cachedir}' '${sock}' && \
+    $<TARGET_FILE:rifiuti-vista> --cache '${cachedir}' dir-sample1 \
+        > /dev/null && \
+    cp -R '${cachedir}' '${cachedir}.orig' && \
+    { $<TARGET_FILE:rifiuti-vista> --cache '${cachedir}' --serve '${sock}' & \
+        pid=$!; } && \
+    $<TARGET_FILE:test_serve_client> '${sock}' dir-win10-01 > /dev/null; \
+    r=$?; kill $pid; wait $pid; \
+    diff -r '${cachedir}.orig' '${cachedir}'; d=$?; \
+    rm -rf '${cachedir}' '${cachedir}.orig'; \
+    [ $r -eq 0 ] && [ $d -eq 0 ]"
+    WORKING_DIRECTORY ${sample_dir})
+set_tests_properties(d_ServeCache
+    PROPERTIES
+        LABELS "recycledir;serve;cache"
+        TIMEOUT 60)
+
+# Server state is inherited by requests, output options must come
+# from each request instead
+foreach(opt Delim Localtime Stats)
+    if(opt STREQUAL "Delim")
+        set(args -t ,)
+    elseif(opt STREQUAL "Localtime")
+        set(args -z)
+    else()
+        set(args --stats)
+    endif()
+    add_test(NAME d_ServeWith${opt}
+        COMMAND rifiuti-vista --serve ${bindir}/d_ServeWith${opt}.sock
+            ${args})
+    set_tests_properties(d_ServeWith${opt}
+        PROPERTIES
+            LABELS "recycledir;serve;xfail"
+            PASS_REGULAR_EXPRESSION "only accepts inputs")
+endforeach()
@@ -0,0 +1,83 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Verify SQLite output by querying resulting database
+#
+
+if(NOT SQLITE_FOUND)
+    return()
+endif()
+
+add_test(NAME f_SqliteNoOutput
+    COMMAND rifiuti -f sqlite ${sample_dir}/INFO2-sample1)
+add_test(NAME d_SqliteNoOutput
+    COMMAND rifiuti-vista -f sqlite ${sample_dir}/dir-sample1)
+set_tests_properties(f_SqliteNoOutput d_SqliteNoOutput
+    PROPERTIES
+        LABELS "arg;xfail;sqlite"
+        PASS_REGULAR_EXPRESSION "SQLite output requires output file")
+add_bintype_label(f_SqliteNoOutput d_SqliteNoOutput)
+
+if(NOT SQLITE3_PROG)
+    return()
+endif()
+
+#
+# Parameters:
+# id (string): test ID fragment, see generate_simple_comparison_test()
+# is_info2 (bool): whether input is INFO2 file or recycle bin folder
+# input (path): input file under sample folder
+# query (str): SQL statement(s) to run on generated database
+# expected (str): regular expression matching query result
+#
+function(addSqliteQueryTest id is_info2 input query expected)
+    if(is_info2)
+        set(prefix f_${id})
+        set(progname rifiuti)
+    else()
+        set(prefix d_${id})
+        set(progname rifiuti-vista)
+    endif()
+    set(db ${bindir}/${prefix}.db)
+
+    add_test(NAME ${prefix}_Prep
+        COMMAND ${progname} -f sqlite -o ${db} ${ARGN} ${input}
+        WORKING_DIRECTORY ${sample_dir})
+    add_test(NAME ${prefix}
+        COMMAND ${SQLITE3_PROG} ${db} ${query})
+    add_test(NAME ${prefix}_Clean
+        COMMAND ${CMAKE_COMMAND} -E rm -f ${db})
+    set_fixture_with_dep(${prefix})
+
+    set_tests_properties(${prefix} PROPERTIES
+        LABELS "sqlite"
+        PASS_REGULAR_EXPRESSION "${expected}")
+    add_bintype_label(${prefix})
+endfunction()
+
+addSqliteQueryTest(SqliteMeta 1 INFO2-sample1
+    "SELECT * FROM metadata"
+    "^file\\|5\\|\\|INFO2-sample1\r?\n$")
+addSqliteQueryTest(SqliteMeta 0 dir-win10-01
+    "SELECT * FROM metadata"
+    "^dir\\|2\\|\\|dir-win10-01\r?\n$")
+addSqliteQueryTest(SqliteRecords 1 INFO2-sample1
+    "SELECT count(*), sum(gone), sum(size) FROM records"
+    "^16\\|1\\|35332096\r?\n$")
+addSqliteQueryTest(SqliteRecords 0 dir-sample1
+    "SELECT \"index\", time, gone, size FROM records LIMIT 1"
+    "^\\$IUVFB0M\\.rtf\\|2007-09-21T06:32:46Z\\|0\\|155\r?\n$")
+addSqliteQueryTest(SqliteLegacyPath 1 INFO2-sample2
+    "SELECT path FROM records WHERE \"index\" = 1"
+    "^C:\\\\WINDOWS\\\\Desktop\\\\Online Services\r?\n$"
+    -l CP1252)
+
+# Broken index files are stored in errors table, while the
+# program still reports them and exits with error
+addSqliteQueryTest(SqliteErrors 0 dir-badfiles
+    "SELECT * FROM errors"
+    "^\\$IF47Q09\\|File is not a \\$Recycle\\.bin index\r?\n$")
+set_tests_properties(d_SqliteErrors_Prep
+    PROPERTIES PASS_REGULAR_EXPRESSION "Error occurred in following record")
@@ -0,0 +1,65 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Recycle bin is parsed once with state file, then parsed again
+# after new records appear. Only new records shall be output in
+# second run.
+#
+
+if(WIN32)
+    return()
+endif()
+
+function(addSinceStateTest is_info2)
+    if(is_info2)
+        set(prefix f_SinceState)
+        set(progname rifiuti)
+    else()
+        set(prefix d_SinceState)
+        set(progname rifiuti-vista)
+    endif()
+    set(tree ${bindir}/${prefix}_tree)
+    set(state ${bindir}/${prefix}.state)
+    set(out ${bindir}/${prefix}.output)
+    set(ref ${bindir}/${prefix}_ref.txt)
+
+    if(is_info2)
+        # No new record at all
+        set(input ${sample_dir}/INFO2-sample1)
+        set(prep ":")
+        set(refcmd ": > '${ref}'")
+    else()
+        # One index file added between runs
+        set(input ${tree})
+        set(prep "mkdir '${tree}' && \
+            cp '${sample_dir}/dir-sample1/'* '${tree}/' && \
+            mv '${tree}/$I0JGHX7' '${bindir}/${prefix}.tmp'")
+        set(refcmd "grep '^.I0JGHX7' '${sample_dir}/dir-sample1.txt' > '${ref}'")
+    endif()
+
+    add_test_using_shell(${prefix}_PrepPre
+        "rm -rf '${tree}' '${state}' '${out}' && ${prep} && \
+        $<TARGET_FILE:${progname}> --since-state '${state}' '${input}' > /dev/null && \
+        { [ ! -d '${tree}' ] || mv '${bindir}/${prefix}.tmp' '${tree}/$I0JGHX7'; }")
+    add_test(NAME ${prefix}_Prep
+        COMMAND ${progname} -n --since-state ${state} ${input} -o ${out})
+    add_test_using_shell(${prefix}_PrepAlt "${refcmd}")
+    add_test(NAME ${prefix}_CleanAlt
+        COMMAND ${CMAKE_COMMAND} -E rm -rf ${tree} ${state})
+
+    generate_simple_comparison_test(SinceState ${is_info2}
+        "" ${ref} "state")
+endfunction()
+
+addSinceStateTest(1)
+addSinceStateTest(0)
+
+add_test(NAME d_SinceStateBadFile
+    COMMAND rifiuti-vista --since-state ${sample_dir}/dir-empty.txt
+        ${sample_dir}/dir-sample1)
+set_tests_properties(d_SinceStateBadFile
+    PROPERTIES
+        LABELS "recycledir;state;xfail"
+        PASS_REGULAR_EXPRESSION "is not a state file")
@@ -0,0 +1,82 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Statistics printed upon exit, and trace written upon exit.
+# Timing varies between runs, so only counters and presence of
+# spans are checked.
+#
+
+add_test(NAME f_StatsText
+    COMMAND rifiuti --stats ${sample_dir}/INFO2-sample1)
+add_test(NAME d_StatsText
+    COMMAND rifiuti-vista --stats ${sample_dir}/dir-sample1)
+set_tests_properties(f_StatsText
+    PROPERTIES
+        LABELS "arg;stats"
+        PASS_REGULAR_EXPRESSION "Files opened: 1, bytes read: 12820\n  Records parsed: 16, emitted: 16, invalid: 0\n")
+set_tests_properties(d_StatsText
+    PROPERTIES
+        LABELS "arg;stats"
+        PASS_REGULAR_EXPRESSION "Files opened: 15, bytes read: [0-9]+\n  Records parsed: 15, emitted: 15, invalid: 0\n")
+
+add_test(NAME d_StatsJson
+    COMMAND rifiuti-vista --stats=json ${sample_dir}/dir-bad-uni)
+set_tests_properties(d_StatsJson
+    PROPERTIES
+        LABELS "arg;stats"
+        PASS_REGULAR_EXPRESSION [=["enumerate": {"wall_us": [0-9]+, "cpu_us": [0-9]+}.*"records": {"parsed": 4, "emitted": 4, "invalid": 0}, "conversion": {"paths": 4, "fallback_chars": 4}, "peak_rss_kib": [1-9][0-9]*}]=])
+
+add_test(NAME d_StatsBadFormat
+    COMMAND rifiuti-vista --stats=yaml ${sample_dir}/dir-sample1)
+set_tests_properties(d_StatsBadFormat
+    PROPERTIES
+        LABELS "arg;stats;xfail"
+        PASS_REGULAR_EXPRESSION "Illegal statistics format")
+
+add_bintype_label(f_StatsText d_StatsText d_StatsJson d_StatsBadFormat)
+
+
+# Spans of every index file, enclosed by phase spans
+set(trace ${bindir}/d_Trace.json)
+add_test(NAME d_Trace_Prep
+    COMMAND rifiuti-vista --trace ${trace} ${sample_dir}/dir-sample1)
+add_test_using_shell(d_Trace "cat '${trace}'")
+add_test(NAME d_Trace_Clean
+    COMMAND ${CMAKE_COMMAND} -E rm -f ${trace})
+set_fixture_with_dep(d_Trace)
+set_tests_properties(d_Trace
+    PROPERTIES
+        LABELS "arg;stats"
+        PASS_REGULAR_EXPRESSION [=[^{"traceEvents": \[
+{"name": "thread_name", "ph": "M", "pid": 1, "tid": 1, "args": {"name": "main"}},
+{"name": "scan folder", [^
+]+},
+{"name": "enumerate", [^
+]+},
+({"name": "parse file", "cat": "rifiuti", "ph": "X", "ts": [0-9]+, "dur": [0-9]+, "pid": 1, "tid": 1, "args": {"detail": "[^"]+\$I[^"]+"}},
+)+{"name": "parse", .+{"name": "output chunk", .+"dropped_events": "0"}}
+$]=])
+add_bintype_label(d_Trace)
+
+
+# Progress is only printed after running for a while, so only check
+# the option doesn't disturb normal output
+add_test(NAME f_Progress
+    COMMAND rifiuti --progress=always ${sample_dir}/INFO2-sample1)
+add_test(NAME d_Progress
+    COMMAND rifiuti-vista --progress ${sample_dir}/dir-sample1)
+set_tests_properties(f_Progress d_Progress
+    PROPERTIES
+        LABELS "arg;stats"
+        PASS_REGULAR_EXPRESSION "\nIndex\tDeleted Time\t")
+
+add_test(NAME d_ProgressBadOpt
+    COMMAND rifiuti-vista --progress=never ${sample_dir}/dir-sample1)
+set_tests_properties(d_ProgressBadOpt
+    PROPERTIES
+        LABELS "arg;stats;xfail"
+        PASS_REGULAR_EXPRESSION "Illegal progress option")
+
+add_bintype_label(f_Progress d_Progress d_ProgressBadOpt)
@@ -0,0 +1,56 @@
+# Copyright (C) 2024, Abel Cheung
+# rifiuti2 is released under Revised BSD License.
+# Please see LICENSE file for more info.
+
+#
+# Recycle bin is watched while an index file is added and a trash
+# file removed. Each change shall be output after initial records,
+# and watch ends when the folder is moved away.
+#
+
+if(NOT CMAKE_SYSTEM_NAME STREQUAL "Linux")
+    return()
+endif()
+
+set(prefix d_Watch)
+set(tree ${bindir}/${prefix}_tree)
+set(out ${bindir}/${prefix}.output)
+set(ref ${bindir}/${prefix}_ref.txt)
+
+# Wait until output reaches certain number of lines
+set(waitcmd "i=0; while [ $(wc -l < '${out}') -lt LINES ] && \
+    [ $i -lt 100 ]; do sleep 0.1; i=$((i+1)); done")
+string(REPLACE LINES 14 wait_initial "${waitcmd}")
+string(REPLACE LINES 16 wait_changes "${waitcmd}")
+
+add_test_using_shell(${prefix}_Prep
+    "rm -rf '${tree}' '${tree}.gone' '${out}' && mkdir '${tree}' && \
+    cp '${sample_dir}/dir-sample1/'* '${tree}/' && : > '${out}' && \
+    { $<TARGET_FILE:rifiuti-vista> -n --watch '${tree}' > '${out}' & \
+    pid=$!; } && ${wait_initial} && \
+    cp '${tree}/$I0JGHX7' '${tree}/$IABCDEF' && \
+    rm '${tree}/$R1IS2OK.txt' && ${wait_changes} && \
+    mv '${tree}' '${tree}.gone' && wait $pid")
+set_tests_properties(${prefix}_Prep PROPERTIES TIMEOUT 60)
+add_test_using_shell(${prefix}_PrepAlt
+    "sed '1,/^Index/d' '${sample_dir}/dir-sample1.txt' > '${ref}' && \
+    grep '^.I0JGHX7' '${sample_dir}/dir-sample1.txt' | \
+        sed 's/I0JGHX7/IABCDEF/' >> '${ref}' && \
+    grep '^.I1IS2OK' '${sample_dir}/dir-sample1.txt' | \
+        sed 's/FALSE/TRUE/' >> '${ref}'")
+add_test(NAME ${prefix}_CleanAlt
+    COMMAND ${CMAKE_COMMAND} -E rm -rf ${tree} ${tree}.gone)
+
+generate_simple_comparison_test(Watch 0 "" ${ref} "watch")
+
+add_test(NAME d_WatchNotFolder
+    COMMAND rifiuti-vista --watch ${sample_dir}/dir-sample1/$I0JGHX7)
+add_test(NAME d_WatchBadFormat
+    COMMAND rifiuti-vista --watch -f xml ${sample_dir}/dir-sample1)
+set_tests_properties(d_WatchNotFolder d_WatchBadFormat
+    PROPERTIES
+        LABELS "recycledir;watch;xfail")
+set_tests_properties(d_WatchNotFolder
+    PROPERTIES PASS_REGULAR_EXPRESSION "is not a folder")
+set_tests_properties(d_WatchBadFormat
+    PROPERTIES PASS_REGULAR_EXPRESSION "only supports")
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Count heap allocations made while dumping records, to ensure
+ * output routines don't allocate memory for every record.
+ *
+ * Usage: test_alloc_count (file|dir) [rifiuti options] FILE_OR_DIR
+ *
+ * Synthetic records are used instead of parsing real recycle bin,
+ * so that record count can be arbitrarily varied. Allocations are
+ * counted by overriding malloc() family, see alloc_counter.c.
+ */
+
+#include <glib/gstdio.h>
+
+#include "utils.h"
+#include "rifiuti.h"
+#include "alloc_counter.h"
+
+#define RECORDS_PER_ROUND  1000
+
+extern metarecord  *meta;
+
+
+static void
+add_records (guint n)
+{
+    // Mixing CJK and astral chars, which expand differently in UTF-8
+    const char *path = "C:\\Users\\\xe3\x83\x86\xe3\x82\xb9\xe3\x83\x88"
+                       "\\\xf0\x9f\x93\x81 folder\\file.txt";
+    const char *legacy_path = "C:\\Users\\test\\folder\\file.txt";
+    char        legacy_buf[WIN_PATH_MAX] = { 0 };
+    glong       wlen;
+    gunichar2  *wpath = g_utf8_to_utf16 (path, -1, NULL, &wlen, NULL);
+
+    memcpy (legacy_buf, legacy_path, strlen (legacy_path));
+
+    for (guint i = 0; i < n; i++)
+    {
+        rbin_struct *record = g_malloc0 (sizeof (rbin_struct));
+        guint        idx = meta->records->len;
+
+        record->index_n = idx + 1;
+        record->index_s = g_strdup_printf ("$I%06u.txt", idx);
+        record->winfiletime = 132000000000000000LL +
+            (int64_t) idx * 10000000LL;
+        record->deltime = win_filetime_to_gdatetime (record->winfiletime);
+        record->filesize = (idx % 7 == 0) ? G_MAXUINT64 : idx * 4096ULL;
+        record->gone = (trash_file_status) (idx % 3);
+        record->drive = 'C';
+
+        record->raw_uni_path = g_string_new_len (
+            (const char *) wpath, (wlen + 1) * sizeof (gunichar2));
+        record->raw_legacy_path = g_string_new_len (
+            legacy_buf, WIN_PATH_MAX);
+
+        g_ptr_array_add (meta->records, record);
+    }
+    g_free (wpath);
+}
+
+
+static size_t
+count_dump_alloc (void)
+{
+    GError *error = NULL;
+    bool    result;
+
+    alloc_count = 0;
+    alloc_counting = true;
+    result = dump_content (&error);
+    alloc_counting = false;
+
+    if (! result)
+    {
+        g_printerr ("Failed to dump content: %s\n", error->message);
+        exit (EXIT_ERR_WRITE_FILE);
+    }
+    return alloc_count;
+}
+
+
+int
+main (int    argc,
+      char **argv)
+{
+    GError     *error = NULL;
+    rbin_type   type;
+    size_t      base, total, extra;
+    char       *output = NULL;
+
+    if (argc < 3)
+    {
+        g_printerr ("Usage: %s (file|dir) [options] FILE_OR_DIR\n", argv[0]);
+        return EXIT_ERR_ARG;
+    }
+
+    type = (g_strcmp0 (argv[1], "file") == 0) ?
+        RECYCLE_BIN_TYPE_FILE : RECYCLE_BIN_TYPE_DIR;
+
+    for (int i = 2; i < argc - 1; i++)
+        if (g_strcmp0 (argv[i], "-o") == 0)
+            output = argv[i + 1];
+
+    // Drop the bin type argument, rest is handled like main program
+    argv[1] = argv[0];
+    argv++;
+
+    if (! rifiuti_init (type, "", "", &argv, &error))
+        return rifiuti_cleanup (&error);
+
+    meta->version = (type == RECYCLE_BIN_TYPE_FILE) ?
+        VERSION_ME_03 : VERSION_WIN10;
+    meta->recordsize = UNICODE_RECORD_SIZE;
+
+    // First round warms up buffers, converters and so on, which
+    // are allocated only once during program lifetime
+    add_records (RECORDS_PER_ROUND);
+    count_dump_alloc ();
+
+    base = count_dump_alloc ();
+    add_records (RECORDS_PER_ROUND);
+    total = count_dump_alloc ();
+    extra = (total > base) ? total - base : 0;
+
+    g_print ("Allocations: %zu for %u records, %zu for %u extra records\n",
+        base, RECORDS_PER_ROUND, extra, RECORDS_PER_ROUND);
+
+    if (output)
+        g_remove (output);
+
+    rifiuti_cleanup (&error);
+    return (extra == 0) ? EXIT_OK : EXIT_ERR_UNHANDLED;
+}
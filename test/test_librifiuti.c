@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Parses all recycle bins given as arguments concurrently through
+ * librifiuti, one thread per recycle bin sharing the same context,
+ * then prints records in TSV format like rifiuti -n. Problems of
+ * each record are printed to stderr afterwards, one line per record
+ * like the error list of rifiuti.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include "librifiuti.h"
+
+typedef struct
+{
+    r2_context  *ctx;
+    const char  *path;
+    GString     *out;
+    GString     *err;
+    bool         ok;
+} job;
+
+
+static gpointer
+_parse_bin (gpointer data)
+{
+    job             *j = data;
+    r2_iter         *it;
+    const r2_record *rec;
+    GError          *error = NULL;
+
+    if (NULL == (it = r2_iter_new (j->ctx, j->path, &error)))
+    {
+        g_printerr ("%s: %s\n", j->path, error->message);
+        g_error_free (error);
+        return NULL;
+    }
+
+    while ((rec = r2_iter_next (it, &error)) || error)
+    {
+        GDateTime *dt;
+        char      *s;
+
+        if (error)
+        {
+            g_string_append_printf (j->err, "%s\n", error->message);
+            g_clear_error (&error);
+            continue;
+        }
+
+        if (r2_record_get_error (rec))
+        {
+            if (rec->index_name)
+                g_string_append (j->err, rec->index_name);
+            else
+                g_string_append_printf (j->err, "%u", rec->index);
+            g_string_append_printf (j->err, ": %s\n",
+                r2_record_get_error (rec)->message);
+        }
+
+        if (rec->index_name)
+            g_string_append (j->out, rec->index_name);
+        else
+            g_string_append_printf (j->out, "%u", rec->index);
+
+        dt = r2_record_get_deltime (rec);
+        s = g_date_time_format (dt, "%Y-%m-%d %H:%M:%S");
+        g_string_append_printf (j->out, "\t%s\t%s\t", s,
+            (r2_record_get_status (rec) == R2_STATUS_GONE) ?
+            "TRUE" : "FALSE");
+        g_free (s);
+        g_date_time_unref (dt);
+
+        if (rec->size == G_MAXUINT64)
+            g_string_append (j->out, "???");
+        else
+            g_string_append_printf (j->out, "%" PRIu64, rec->size);
+
+        s = r2_record_get_path (rec, NULL);
+        g_string_append_printf (j->out, "\t%s\n", s ? s : "???");
+        g_free (s);
+    }
+
+    r2_iter_free (it);
+    j->ok = true;
+    return NULL;
+}
+
+
+int main (int argc, char **argv)
+{
+    r2_context  *ctx = r2_context_new ();
+    job         *jobs = g_new0 (job, argc);
+    GThread    **threads = g_new0 (GThread *, argc);
+    int          ret = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        jobs[i].ctx = ctx;
+        jobs[i].path = argv[i];
+        jobs[i].out = g_string_new (NULL);
+        jobs[i].err = g_string_new (NULL);
+        threads[i] = g_thread_new ("parse", _parse_bin, &jobs[i]);
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        g_thread_join (threads[i]);
+        // Not g_print(), which converts to locale charset
+        fputs (jobs[i].out->str, stdout);
+        fputs (jobs[i].err->str, stderr);
+        g_string_free (jobs[i].out, TRUE);
+        g_string_free (jobs[i].err, TRUE);
+        if (! jobs[i].ok)
+            ret = 1;
+    }
+
+    g_free (threads);
+    g_free (jobs);
+    r2_context_free (ctx);
+    return ret;
+}
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Checks that time and memory needed by program grow at most
+ * linearly with input size. Program is run over a small and a
+ * large input (appended to its arguments) repeatedly, and fails
+ * if growth of fastest run time or peak memory usage exceeds
+ * size factor of the inputs by more than allowed slack.
+ *
+ * Usage: test_scaling -f FACTOR [OPTIONS] SMALL LARGE -- PROGRAM [ARG...]
+ *
+ * Exit code of program is ignored as long as it exits normally,
+ * since hostile input is expected to produce record errors.
+ *
+ * With --alloc-budget, heap allocations are counted instead (by
+ * preloading alloc_counter library), and program fails if extra
+ * allocations per extra record of large input exceed the budget.
+ * Time and memory usage are not checked in this mode.
+ *
+ * With --output, program writes to given file (removed before and
+ * after each run) instead of stdout, for formats which can't be
+ * written to stdout.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+/* Path of library counting allocations, see alloc_counter.c */
+#ifndef ALLOC_COUNTER_LIB
+#define ALLOC_COUNTER_LIB ""
+#endif
+
+static double     factor      = 0;
+static double     slack       = 3;
+static gint       repeat      = 3;
+static gint       max_kib     = 0;
+static gint       records     = 0;
+static double     budget      = -1;
+static char      *output      = NULL;
+static char     **fileargs    = NULL;
+
+static const GOptionEntry options[] = {
+    { "factor", 'f', 0, G_OPTION_ARG_DOUBLE, &factor,
+      "How many times large input is bigger than small one", "N" },
+    { "slack", 's', 0, G_OPTION_ARG_DOUBLE, &slack,
+      "Tolerated extra growth over size factor [3]", "N" },
+    { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+      "Number of runs for each input [3]", "N" },
+    { "max-memory", 'm', 0, G_OPTION_ARG_INT, &max_kib,
+      "Fail if peak memory usage on large input exceeds this", "KIB" },
+    { "records", 'n', 0, G_OPTION_ARG_INT, &records,
+      "Number of records in small input", "N" },
+    { "alloc-budget", 'a', 0, G_OPTION_ARG_DOUBLE, &budget,
+      "Count heap allocations, and fail if allocations per record "
+      "exceed this", "N" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+      "Let program write to this file instead of stdout", "FILE" },
+    { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &fileargs,
+      NULL, NULL },
+    { 0 }
+};
+
+
+/**
+ * @brief Run program over input once with all output discarded
+ * @param elapsed Location to store wall clock time in microseconds
+ * @param maxrss Location to store peak resident memory in KiB
+ * @param allocs Location to store number of heap allocations,
+ * or `NULL` if they are not counted
+ * @return `true` if program exits normally, `false` otherwise
+ */
+static bool
+_run_once   (char    **command,
+             gint64   *elapsed,
+             long     *maxrss,
+             gsize    *allocs)
+{
+    struct rusage  ru;
+    gint64         start;
+    int            status;
+    int            pipefd[2] = { -1, -1 };
+    pid_t          pid;
+
+    if (allocs && pipe (pipefd) < 0)
+        return false;
+
+    start = g_get_monotonic_time ();
+    if (0 > (pid = fork ()))
+        return false;
+
+    if (pid == 0)
+    {
+        int fd = open ("/dev/null", O_WRONLY);
+        dup2 (fd, STDOUT_FILENO);
+        dup2 (fd, STDERR_FILENO);
+        close (fd);
+        if (allocs)
+        {
+            char *fd_str = g_strdup_printf ("%d", pipefd[1]);
+            close (pipefd[0]);
+            setenv ("ALLOC_COUNT_FD", fd_str, 1);
+            setenv ("LD_PRELOAD", ALLOC_COUNTER_LIB, 1);
+        }
+        execvp (command[0], command);
+        _exit (127);
+    }
+
+    if (allocs)
+        close (pipefd[1]);
+
+    while (wait4 (pid, &status, 0, &ru) < 0)
+        if (errno != EINTR)
+            return false;
+
+    if (allocs)
+    {
+        char     buf[32] = { 0 };
+        ssize_t  n = read (pipefd[0], buf, sizeof (buf) - 1);
+
+        close (pipefd[0]);
+        if (n <= 0)
+            return false;
+        *allocs = (gsize) g_ascii_strtoull (buf, NULL, 10);
+    }
+
+    *elapsed = g_get_monotonic_time () - start;
+#ifdef __APPLE__
+    *maxrss = ru.ru_maxrss / 1024;  // bytes on macOS
+#else
+    *maxrss = ru.ru_maxrss;
+#endif
+    return WIFEXITED (status) && WEXITSTATUS (status) != 127;
+}
+
+
+/**
+ * @brief Run program over input repeatedly
+ * @param best Location to store fastest run time
+ * @param peak Location to store peak memory usage of all runs
+ * @param allocs Location to store fewest heap allocations of all
+ * runs, or `NULL` if they are not counted
+ */
+static bool
+_measure   (char        **command,
+            gsize         len,
+            const char   *input,
+            gint64       *best,
+            long         *peak,
+            gsize        *allocs)
+{
+    *best = G_MAXINT64;
+    *peak = 0;
+    if (allocs)
+        *allocs = G_MAXSIZE;
+    command[len] = (char *) input;
+
+    for (int i = 0; i < repeat; i++)
+    {
+        gint64 elapsed;
+        long   rss;
+        gsize  count;
+        bool   ok;
+
+        // Program refuses to overwrite existing output
+        if (output)
+            g_remove (output);
+        ok = _run_once (command, &elapsed, &rss, allocs ? &count : NULL);
+        if (output)
+            g_remove (output);
+
+        if (! ok)
+        {
+            g_printerr ("%s failed on '%s'\n", command[0], input);
+            return false;
+        }
+        *best = MIN (*best, elapsed);
+        *peak = MAX (*peak, rss);
+        if (allocs)
+            *allocs = MIN (*allocs, count);
+    }
+
+    if (allocs)
+        g_print ("%-40s %10zu allocations\n", input, *allocs);
+    else
+        g_print ("%-40s %10.3f s %10ld KiB\n", input,
+            (double) *best / G_USEC_PER_SEC, *peak);
+    return true;
+}
+
+
+/**
+ * @brief Compare heap allocations needed for each extra record
+ * @return `true` if within budget, `false` otherwise
+ */
+static bool
+_check_allocs   (char  **command,
+                 gsize   len)
+{
+    gint64  elapsed;
+    long    rss;
+    gsize   a_small, a_large;
+    double  per_record;
+
+    if (! _measure (command, len, fileargs[0], &elapsed, &rss, &a_small) ||
+        ! _measure (command, len, fileargs[1], &elapsed, &rss, &a_large))
+        return false;
+
+    per_record = ((double) a_large - (double) a_small) /
+        (records * (factor - 1));
+    g_print ("Allocations per record: %.2f, budget %.2f\n",
+        per_record, budget);
+
+    if (per_record > budget)
+    {
+        g_printerr ("Too many allocations per record\n");
+        return false;
+    }
+    return true;
+}
+
+
+int main (int argc, char **argv)
+{
+    GOptionContext *context;
+    GError         *error = NULL;
+    char          **args = g_strdupv (argv);
+    char          **command;
+    gsize           len;
+    gint64          t_small, t_large;
+    long            m_small, m_large;
+    double          t_ratio, m_ratio;
+    bool            ret;
+
+    (void) argc;
+
+    context = g_option_context_new ("SMALL LARGE -- PROGRAM [ARG…]");
+    g_option_context_set_summary (context,
+        "Check that program scales linearly with input size.");
+    g_option_context_add_main_entries (context, options, NULL);
+    ret = g_option_context_parse_strv (context, &args, &error);
+    g_option_context_free (context);
+    g_strfreev (args);
+
+    if (! ret || fileargs == NULL || g_strv_length (fileargs) < 3 ||
+        factor <= 0 || slack < 1 || repeat < 1 ||
+        (budget >= 0 && (records < 1 || factor <= 1)))
+    {
+        g_printerr ("%s\n", error ? error->message :
+            "Need size factor, 2 inputs and command to run");
+        g_clear_error (&error);
+        return 1;
+    }
+
+    if (budget >= 0 && ALLOC_COUNTER_LIB[0] == '\0')
+    {
+        g_printerr ("Counting allocations is not supported\n");
+        return 1;
+    }
+
+    // Command line with room for output option and input
+    len = g_strv_length (fileargs + 2);
+    command = g_new0 (char *, len + 4);
+    memcpy (command, fileargs + 2, len * sizeof (char *));
+    if (output)
+    {
+        command[len++] = "-o";
+        command[len++] = output;
+    }
+
+    if (budget >= 0)
+    {
+        ret = _check_allocs (command, len);
+        goto done;
+    }
+
+    ret = _measure (command, len, fileargs[0], &t_small, &m_small, NULL) &&
+        _measure (command, len, fileargs[1], &t_large, &m_large, NULL);
+
+    if (ret)
+    {
+        t_ratio = (double) t_large / MAX (t_small, 1);
+        m_ratio = (double) m_large / MAX (m_small, 1);
+        g_print ("Growth: time %.2fx, memory %.2fx, limit %.2fx\n",
+            t_ratio, m_ratio, factor * slack);
+
+        if (t_ratio > factor * slack)
+        {
+            g_printerr ("Run time grows superlinearly\n");
+            ret = false;
+        }
+        if (m_ratio > factor * slack)
+        {
+            g_printerr ("Memory usage grows superlinearly\n");
+            ret = false;
+        }
+        if (max_kib > 0 && m_large > max_kib)
+        {
+            g_printerr ("Memory usage exceeds %d KiB\n", max_kib);
+            ret = false;
+        }
+    }
+
+done:
+    g_free (command);
+    g_free (output);
+    g_strfreev (fileargs);
+    return ret ? 0 : 1;
+}
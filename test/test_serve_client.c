@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2024, Abel Cheung
+ * rifiuti2 is released under Revised BSD License.
+ * Please see LICENSE file for more info.
+ */
+
+/*
+ * Minimal client of '--serve' mode. Sends current directory and
+ * remaining arguments as request to server listening on SOCKET, writes output and error
+ * messages to standard output and error respectively, then exits
+ * with exit code of request. Connection is retried for a while,
+ * since server may be just starting.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "utils-serve.h"
+
+#define CONNECT_RETRY   100
+
+
+static int
+_read_all   (int      fd,
+             void    *buf,
+             size_t   len)
+{
+    char *p = buf;
+
+    while (len > 0)
+    {
+        ssize_t n = read (fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= n;
+    }
+    return 1;
+}
+
+
+int main (int argc, char **argv)
+{
+    struct sockaddr_un  addr = { .sun_family = AF_UNIX };
+    char                cwd[PATH_MAX];
+    int                 fd, i;
+
+    if (argc < 2 || strlen (argv[1]) >= sizeof (addr.sun_path))
+    {
+        fprintf (stderr, "Usage: %s SOCKET [ARG...]\n", argv[0]);
+        return 64;
+    }
+    strcpy (addr.sun_path, argv[1]);
+
+    for (i = 0; i < CONNECT_RETRY; i++)
+    {
+        if (0 > (fd = socket (AF_UNIX, SOCK_STREAM, 0)))
+            break;
+        if (0 == connect (fd, (struct sockaddr *) &addr, sizeof (addr)))
+            break;
+        close (fd);
+        fd = -1;
+        usleep (100000);
+    }
+    if (fd < 0)
+    {
+        perror ("connect");
+        return 64;
+    }
+
+    if (! getcwd (cwd, sizeof (cwd)) ||
+        write (fd, cwd, strlen (cwd) + 1) < 0)
+    {
+        perror ("getcwd");
+        return 64;
+    }
+
+    for (i = 2; i <= argc; i++)
+    {
+        // Empty argument marks end of request
+        const char *arg = (i < argc) ? argv[i] : "";
+        if (write (fd, arg, strlen (arg) + 1) < 0)
+        {
+            perror ("write");
+            return 64;
+        }
+    }
+
+    while (1)
+    {
+        unsigned char  header[SERVE_FRAME_HEADER_SIZE];
+        uint32_t       len;
+        char          *payload;
+
+        if (! _read_all (fd, header, sizeof (header)))
+            break;
+
+        len = header[1] | header[2] << 8 | header[3] << 16 |
+            (uint32_t) header[4] << 24;
+        payload = malloc (len ? len : 1);
+        if (! _read_all (fd, payload, len))
+            break;
+
+        switch (header[0])
+        {
+            case SERVE_FRAME_OUTPUT:
+                fwrite (payload, 1, len, stdout);
+                break;
+            case SERVE_FRAME_ERROR:
+                fwrite (payload, 1, len, stderr);
+                break;
+            case SERVE_FRAME_EXIT:
+                return len ? (unsigned char) payload[0] : 64;
+        }
+        free (payload);
+    }
+
+    fprintf (stderr, "Connection closed without exit code\n");
+    return 64;
+}